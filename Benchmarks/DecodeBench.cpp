@@ -0,0 +1,280 @@
+/**
+ Replays a trace corpus (see SwipeTrace.h - recorded on a device, or made by trace_generator)
+ through the decoder the way the touch handlers drive it, and reports as JSON:
+	- latency percentiles (p50/p95/p99) of the whole decode and of finish() alone - what the user
+	  waits for on lift - overall and bucketed by gesture length (points) and word length (letters)
+	- heap allocations (and bytes) per decode, counted by replacing operator new, and the blocks the
+	  decoder's arena (see SwipeArena) took from malloc - both should be 0 once it's warmed up
+	- peak RSS
+	- top-1 accuracy against the recorded words
+	- how many gestures the result cache answered (see SwipeResultCache) - -cache 0 turns it off
+
+	decode_bench traces.qtr [-data Data] [-warmup 100] [-repeat 1] [-nolayout] [-deadline ms] [-cache n] [-o out.json] [-log]
+
+ The decoder's debug logging goes to /dev/null unless -log is given, so that stdout is just the JSON.
+ */
+#include "TCommon.h"
+#include "SwipeDecoder.h"
+#include "SwipeTrace.h"
+#include "TDateTime.h"
+#include "TFile.h"
+#include "TTimer.h"
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+#pragma mark - allocation counting
+
+static atomic<long> numAllocs(0);
+static atomic<long> allocBytes(0);
+
+void* operator new(size_t size) {
+	numAllocs++;
+	allocBytes += (long)size;
+	void* p = malloc(size ? size : 1);
+	if (!p)
+		abort();
+	return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	numAllocs++;
+	allocBytes += (long)size;
+	return malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t& nt) noexcept { return operator new(size, nt); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+#pragma mark - results
+
+static inline int64_t usSince(const TDateTime& start) {
+	timeval tv = (TDateTime::now() - start).asTV();
+	return (int64_t)tv.tv_sec*1000000 + tv.tv_usec;
+}
+
+struct Sample {
+	int points;
+	int letters;
+	int64_t decodeUs;
+	int64_t finishUs;
+	long allocs;
+	long bytes;
+	int64_t arenaMallocs;
+	bool correct;
+	bool cached;
+};
+
+/// a group of samples' latencies, as a JSON object
+static void writeLatency(FILE* out, const char* name, vector<int64_t>& us) {
+	sort(us.begin(), us.end());
+	double sum = 0;
+	for (int64_t u: us)
+		sum += u;
+	// nearest rank
+	auto percentile = [&us](double p) { return us.empty() ? 0 : us[TMin((size_t)(p * us.size()), us.size()-1)]; };
+	fprintf(out, "\"%s\": {\"p50\": %lld, \"p95\": %lld, \"p99\": %lld, \"mean\": %.1f, \"max\": %lld}", name,
+			(long long)percentile(0.50), (long long)percentile(0.95), (long long)percentile(0.99),
+			us.empty() ? 0.0 : sum / us.size(), (long long)(us.empty() ? 0 : us.back()));
+}
+
+static void writeGroup(FILE* out, const vector<Sample>& samples, const char* key, const char* label,
+					   bool (*belongs)(const Sample&, int, int), int lo, int hi) {
+	vector<int64_t> decode, finish;
+	int correct = 0;
+	long allocs = 0;
+	for (auto& s: samples) {
+		if (!belongs(s, lo, hi))
+			continue;
+		decode.push_back(s.decodeUs);
+		finish.push_back(s.finishUs);
+		correct += s.correct;
+		allocs += s.allocs;
+	}
+	fprintf(out, "{\"%s\": \"%s\", \"count\": %d, \"top1\": %.4f, \"allocsPerDecode\": %.1f, ", key, label, (int)decode.size(),
+			decode.empty() ? 0.0 : correct / (double)decode.size(), decode.empty() ? 0.0 : allocs / (double)decode.size());
+	writeLatency(out, "decodeUs", decode);
+	fprintf(out, ", ");
+	writeLatency(out, "finishUs", finish);
+	fprintf(out, "}");
+}
+
+static bool pointsIn(const Sample& s, int lo, int hi) { return s.points >= lo && s.points <= hi; }
+static bool lettersIn(const Sample& s, int lo, int hi) { return s.letters >= lo && s.letters <= hi; }
+
+/// buckets of gesture length, in points - roughly doubling
+static const int kPointBuckets[][2] = { {0, 31}, {32, 63}, {64, 127}, {128, 255}, {256, 1 << 30} };
+static const int kLetterBuckets[][2] = { {1, 2}, {3, 4}, {5, 6}, {7, 8}, {9, 10}, {11, 1 << 30} };
+
+/// a JSON array with a group per bucket
+static void writeBuckets(FILE* out, const vector<Sample>& samples, const char* name, const char* key, const int (*buckets)[2],
+						 int numBuckets, bool (*belongs)(const Sample&, int, int)) {
+	fprintf(out, "  \"%s\": [\n", name);
+	for (int b=0; b<numBuckets; b++) {
+		char label[32];
+		if (buckets[b][1] >= (1 << 30))
+			snprintf(label, sizeof(label), "%d+", buckets[b][0]);
+		else
+			snprintf(label, sizeof(label), "%d-%d", buckets[b][0], buckets[b][1]);
+		fprintf(out, "    ");
+		writeGroup(out, samples, key, label, belongs, buckets[b][0], buckets[b][1]);
+		fprintf(out, (b+1 < numBuckets) ? ",\n" : "\n");
+	}
+	fprintf(out, "  ]");
+}
+
+static long peakRssKB() {
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024; // bytes there
+#else
+	return usage.ru_maxrss;
+#endif
+}
+
+static int usage(const char* name) {
+	fprintf(stderr, "usage: %s <traces.qtr> [-data dir] [-warmup n] [-repeat n] [-nolayout] [-deadline ms] [-cache n] [-o out.json] [-log]\n", name);
+	return 1;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2)
+		return usage(argv[0]);
+	string dataDir = "Data";
+	int warmup = 100, repeat = 1, deadlineMs = 0, cacheSize = SwipeDecoder::kDefaultResultCacheSize;
+	bool useLayout = true, log = false;
+	const char* outPath = nullptr;
+	for (int i=2; i<argc; i++) {
+		if (!strcmp(argv[i], "-nolayout"))
+			useLayout = false;
+		else if (!strcmp(argv[i], "-log"))
+			log = true;
+		else if (i+1 >= argc)
+			return usage(argv[0]);
+		else if (!strcmp(argv[i], "-data"))
+			dataDir = argv[++i];
+		else if (!strcmp(argv[i], "-warmup"))
+			warmup = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-repeat")) {
+			repeat = atoi(argv[++i]);
+			repeat = TMax(repeat, 1);
+		}
+		else if (!strcmp(argv[i], "-deadline"))
+			deadlineMs = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-cache"))
+			cacheSize = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-o"))
+			outPath = argv[++i];
+		else
+			return usage(argv[0]);
+	}
+
+	// the JSON goes to the real stdout (or the file), the logging nowhere
+	FILE* out = outPath ? fopen(outPath, "w") : fdopen(dup(fileno(stdout)), "w");
+	if (!out) {
+		fprintf(stderr, "can't write '%s'\n", outPath);
+		return 1;
+	}
+	if (!log)
+		freopen("/dev/null", "w", stdout);
+
+	SwipeDecoder decoder;
+	SwipeTraceReader corpus;
+	if (!decoder.loadCharLM(dataDir + "/count_2l.txt", dataDir + "/count_3l.txt") || !decoder.loadLexicon(dataDir + "/count_big.lex")) {
+		fprintf(stderr, "failed to load the models from '%s'\n", dataDir.c_str());
+		return 1;
+	}
+	decoder.loadEdits(dataDir + "/count_1edit.txt");
+	if (TFileReader::fileExists(dataDir + "/count_2w.big"))
+		decoder.loadBigrams(dataDir + "/count_2w.big");
+	decoder.setResultCacheSize(cacheSize);
+	if (!corpus.open(argv[1])) {
+		fprintf(stderr, "failed to read '%s'\n", argv[1]);
+		return 1;
+	}
+
+	SwipeResult buffer[5];
+	SwipeResults results(buffer, 5);
+	SwipeTrace trace;
+	vector<Sample> samples;
+	for (int pass=0; pass<repeat; pass++) {
+		corpus.rewind();
+		for (int n=0; corpus.next(trace); n++) {
+			if (trace.points.empty())
+				continue;
+			if (useLayout && trace.layout)
+				decoder.setKeyLayout(*trace.layout);
+
+			Sample s;
+			const long allocsBefore = numAllocs, bytesBefore = allocBytes;
+			const int64_t arenaBefore = decoder.getArena().getNumMallocs();
+			TDateTime start = TDateTime::now();
+			decoder.begin();
+			for (auto& point: trace.points)
+				decoder.addPoint(point);
+			TDateTime lift = TDateTime::now();
+			CountdownTimer deadline(deadlineMs);
+			decoder.finish(results, deadlineMs > 0 ? &deadline : nullptr);
+			s.finishUs = usSince(lift);
+			s.decodeUs = usSince(start);
+			s.allocs = numAllocs - allocsBefore;
+			s.bytes = allocBytes - bytesBefore;
+			s.arenaMallocs = decoder.getArena().getNumMallocs() - arenaBefore;
+			s.points = (int)trace.points.size();
+			s.letters = (int)trace.word.size();
+			s.correct = results.count > 0 && trace.word == results.results[0].word;
+			s.cached = results.cached;
+			// the first few fill the decoder's scratch space
+			if (pass > 0 || n >= warmup)
+				samples.push_back(s);
+		}
+	}
+	if (samples.empty()) {
+		fprintf(stderr, "no gestures in '%s' after the warm-up\n", argv[1]);
+		return 1;
+	}
+
+	vector<int64_t> decode, finish;
+	long allocs = 0, bytes = 0, maxAllocs = 0;
+	int64_t arenaMallocs = 0;
+	int correct = 0, zeroAllocs = 0, cached = 0;
+	for (auto& s: samples) {
+		decode.push_back(s.decodeUs);
+		finish.push_back(s.finishUs);
+		allocs += s.allocs;
+		bytes += s.bytes;
+		arenaMallocs += s.arenaMallocs;
+		maxAllocs = TMax(maxAllocs, s.allocs);
+		zeroAllocs += (s.allocs == 0);
+		correct += s.correct;
+		cached += s.cached;
+	}
+	fprintf(out, "{\n  \"corpus\": \"%s\",\n  \"gestures\": %d,\n  \"layout\": %s,\n  \"deadlineMs\": %d,\n", argv[1],
+			(int)samples.size(), useLayout ? "true" : "false", deadlineMs);
+	fprintf(out, "  \"top1\": %.4f,\n  \"cacheSize\": %d,\n  \"cacheHitRate\": %.4f,\n  ", correct / (double)samples.size(), cacheSize,
+			cached / (double)samples.size());
+	writeLatency(out, "decodeUs", decode);
+	fprintf(out, ",\n  ");
+	writeLatency(out, "finishUs", finish);
+	fprintf(out, ",\n  \"allocsPerDecode\": %.2f,\n  \"allocBytesPerDecode\": %.1f,\n  \"maxAllocsPerDecode\": %ld,\n"
+			"  \"zeroAllocDecodes\": %d,\n  \"arenaMallocs\": %lld,\n  \"arenaPeakKB\": %ld,\n  \"peakRssKB\": %ld,\n",
+			allocs / (double)samples.size(), bytes / (double)samples.size(), maxAllocs, zeroAllocs, (long long)arenaMallocs,
+			(long)(decoder.getArena().getPeak() / 1024), peakRssKB());
+	writeBuckets(out, samples, "byGestureLength", "points", kPointBuckets, (int)(sizeof(kPointBuckets)/sizeof(kPointBuckets[0])), pointsIn);
+	fprintf(out, ",\n");
+	writeBuckets(out, samples, "byWordLength", "letters", kLetterBuckets, (int)(sizeof(kLetterBuckets)/sizeof(kLetterBuckets[0])), lettersIn);
+	fprintf(out, "\n}\n");
+	fclose(out);
+	return 0;
+}
@@ -0,0 +1,169 @@
+/**
+ Microbenchmark for the shape matcher's distance kernel (GestureDistance.h): checks the vector
+ kernel against the scalar reference, then reports templates scored per second for both - once
+ scoring every point, and once with early abandonment against a realistic k-th best.
+
+ Given the Data directory it also times ShapeMatcher::match() over the real lexicon, where the
+ pruning and abandonment work against the actual word priors.
+
+	shape_kernel_bench [numTemplates] [iterations] [dataDir]
+ */
+#include "TCommon.h"
+#include "GestureDistance.h"
+#include "GestureTemplates.h"
+#include "KeyLayout.h"
+#include "Lexicon.h"
+#include "SwipeResampler.h"
+#include "TDateTime.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+static const int kNumPoints = 32;
+
+typedef int (*Kernel)(const float*, const float*, const float*, const float*, int, const float*, float*);
+
+static double secondsSince(const TDateTime& start) {
+	timeval tv = (TDateTime::now() - start).asTV();
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static float randomCoord(float range) {
+	return range * (rand() / (float)RAND_MAX);
+}
+
+/// a word-like gesture: through 2-8 random keys of the layout, resampled
+static void randomGesture(const KeyLayout& layout, float* xs, float* ys) {
+	float cx[8], cy[8];
+	int n = 2 + rand() % 7;
+	for (int i=0; i<n; i++) {
+		const SwipeKey& key = layout[rand() % layout.size()];
+		cx[i] = key.centreX();
+		cy[i] = key.centreY();
+	}
+	SwipeResampler::resample(cx, cy, nullptr, n, kNumPoints, xs, ys);
+}
+
+/// scores all blocks 'iterations' times, returning templates per second
+static double run(Kernel kernel, const vector<float>& bx, const vector<float>& by, const float* tx, const float* ty,
+				  const vector<float>& limits, int iterations, float& checksum, double& pointsScored) {
+	int numBlocks = (int)(bx.size() / (kNumPoints * kGestureLanes));
+	float sums[kGestureLanes];
+	checksum = 0;
+	pointsScored = 0;
+	TDateTime start = TDateTime::now();
+	for (int it=0; it<iterations; it++) {
+		for (int b=0; b<numBlocks; b++) {
+			pointsScored += kernel(&bx[b*kNumPoints*kGestureLanes], &by[b*kNumPoints*kGestureLanes], tx, ty, kNumPoints, &limits[b*kGestureLanes], sums);
+			checksum += sums[b % kGestureLanes];
+		}
+	}
+	double secs = secondsSince(start);
+	pointsScored /= (double)numBlocks * iterations;
+	return (double)numBlocks * kGestureLanes * iterations / TMax(secs, 1e-9);
+}
+
+/// times the whole matcher over gestures for random words from the lexicon
+static void benchMatcher(const char* dataDir, int iterations) {
+	Lexicon lexicon;
+	if (!lexicon.load(std::string(dataDir) + "/count_big.txt"))
+		return;
+	KeyLayout layout;
+	layout.setQwerty(320, 216);
+	GestureTemplates templates;
+	templates.build(lexicon, layout);
+	ShapeMatcher matcher(templates, lexicon);
+
+	int numTraces = 200;
+	vector<float> traces(numTraces * 2 * kNumPoints);
+	for (int n=0; n<numTraces; n++) {
+		int t = rand() % templates.size();
+		for (int i=0; i<kNumPoints; i++) {
+			traces[(2*n)*kNumPoints + i] = templates.x(t, i) + randomCoord(16) - 8;
+			traces[(2*n+1)*kNumPoints + i] = templates.y(t, i) + randomCoord(16) - 8;
+		}
+	}
+
+	vector<ShapeMatch> matches;
+	TDateTime start = TDateTime::now();
+	for (int it=0; it<iterations; it++) {
+		for (int n=0; n<numTraces; n++) {
+			matches.clear();
+			matcher.setTrace(&traces[(2*n)*kNumPoints], &traces[(2*n+1)*kNumPoints], kNumPoints);
+			matcher.match(matches);
+		}
+	}
+	double perMatch = secondsSince(start) / ((double)numTraces * iterations);
+	printf("matcher: %d templates, %.1fus per match (%.1fM lexicon templates/s effective)\n",
+		   templates.size(), perMatch * 1e6, templates.size() / perMatch / 1e6);
+}
+
+int main(int argc, char** argv) {
+	int numTemplates = (argc > 1) ? atoi(argv[1]) : 32768;
+	int iterations = (argc > 2) ? atoi(argv[2]) : 50;
+	int numBlocks = (numTemplates + kGestureLanes-1) / kGestureLanes;
+	numTemplates = numBlocks * kGestureLanes;
+
+	// random word-like templates on a phone-sized keyboard, interleaved into blocks
+	srand(42);
+	KeyLayout layout;
+	layout.setQwerty(320, 216);
+	vector<float> bx(numBlocks * kNumPoints * kGestureLanes), by(bx.size());
+	for (int t=0; t<numTemplates; t++) {
+		float xs[kNumPoints], ys[kNumPoints];
+		randomGesture(layout, xs, ys);
+		for (int i=0; i<kNumPoints; i++) {
+			bx[((t/kGestureLanes)*kNumPoints + i)*kGestureLanes + t%kGestureLanes] = xs[i];
+			by[((t/kGestureLanes)*kNumPoints + i)*kGestureLanes + t%kGestureLanes] = ys[i];
+		}
+	}
+	// ... and a trace that is one of them, with some jitter
+	float tx[kNumPoints], ty[kNumPoints];
+	for (int i=0; i<kNumPoints; i++) {
+		tx[i] = bx[i*kGestureLanes] + randomCoord(10) - 5;
+		ty[i] = by[i*kGestureLanes] + randomCoord(10) - 5;
+	}
+
+	// validate against the scalar reference, and collect the full distances
+	vector<float> noLimit(numBlocks * kGestureLanes, INFINITY);
+	vector<float> full(numTemplates);
+	float maxError = 0;
+	for (int b=0; b<numBlocks; b++) {
+		float ref[kGestureLanes], vec[kGestureLanes];
+		gestureDistanceScalar(&bx[b*kNumPoints*kGestureLanes], &by[b*kNumPoints*kGestureLanes], tx, ty, kNumPoints, &noLimit[0], ref);
+		gestureDistance(&bx[b*kNumPoints*kGestureLanes], &by[b*kNumPoints*kGestureLanes], tx, ty, kNumPoints, &noLimit[0], vec);
+		for (int lane=0; lane<kGestureLanes; lane++) {
+			maxError = TMax(maxError, fabsf(ref[lane] - vec[lane]) / TMax(ref[lane], 1.0f));
+			full[b*kGestureLanes + lane] = ref[lane];
+		}
+	}
+	bool ok = maxError < 1e-3f;
+	printf("kernel: %s, %d templates x %d points, max relative error vs scalar: %g %s\n",
+		   gestureDistanceKernel(), numTemplates, kNumPoints, maxError, ok ? "OK" : "FAILED");
+
+	// a limit that about 1% of the templates get under, like a full top-k heap would give
+	vector<float> sorted(full);
+	nth_element(sorted.begin(), sorted.begin() + numTemplates/100, sorted.end());
+	vector<float> limits(numBlocks * kGestureLanes, sorted[numTemplates/100]);
+
+	float c1, c2;
+	double p1, p2;
+	double scalarFull = run(gestureDistanceScalar, bx, by, tx, ty, noLimit, iterations, c1, p1);
+	double vectorFull = run(gestureDistance, bx, by, tx, ty, noLimit, iterations, c2, p2);
+	printf("full:    scalar %.1fM templates/s, %s %.1fM templates/s (x%.1f)\n",
+		   scalarFull / 1e6, gestureDistanceKernel(), vectorFull / 1e6, vectorFull / scalarFull);
+
+	double scalarAbandon = run(gestureDistanceScalar, bx, by, tx, ty, limits, iterations, c1, p1);
+	double vectorAbandon = run(gestureDistance, bx, by, tx, ty, limits, iterations, c2, p2);
+	printf("abandon: scalar %.1fM templates/s, %s %.1fM templates/s (x%.1f), %.1f of %d points scored per block\n",
+		   scalarAbandon / 1e6, gestureDistanceKernel(), vectorAbandon / 1e6, vectorAbandon / scalarAbandon, p2, kNumPoints);
+
+	if (argc > 3)
+		benchMatcher(argv[3], iterations);
+
+	return ok ? 0 : 1;
+}
@@ -7,6 +7,7 @@
 //
 
 #import "PMCustomKeyboard.h"
+#include "KeyLayout.h"
 #include <string>
 using namespace std;
 
@@ -23,7 +24,10 @@ enum {
 
 @end
 
-@implementation PMCustomKeyboard
+@implementation PMCustomKeyboard {
+	KeyLayout hitLayout;	// the characterKeys' frames, keyed by their index - for hit-testing touches
+	UIButton *popupButton;	// the key currently showing its popup
+}
 @synthesize textView = _textView;
 PaintingView *pView;
 
@@ -101,6 +105,40 @@ PaintingView *pView;
 		[b.titleLabel setFont:[UIFont boldSystemFontOfSize:22]];
 		i++;
 	}
+	[self updateKeyLayouts];
+}
+
+- (void)layoutSubviews {
+	[super layoutSubviews];
+	[self updateKeyLayouts];
+}
+
+- (void)updateKeyLayouts {
+	hitLayout.clear();
+	int i = 0;
+	for (UIButton *b in self.characterKeys) {
+		CGRect frame = b.frame;
+		hitLayout.addKey(i++, frame.origin.x, frame.origin.y, frame.size.width, frame.size.height);
+	}
+	hitLayout.build();
+	[pView setKeyLayoutFromButtons:self.characterKeys];
+}
+
+// the character key under the touch, or nil - a table lookup rather than a scan of the buttons
+- (UIButton *)keyAtLocation:(CGPoint)location {
+	const SwipeKey *key = hitLayout.keyAt(location.x, location.y);
+	return key ? [self.characterKeys objectAtIndex:key->key] : nil;
+}
+
+// moves the popup to 'b' (nil for none) - only touching the views when the key changes
+- (void)showPopupOnButton:(UIButton *)b {
+	if (b == popupButton)
+		return;
+	if (popupButton && [popupButton subviews].count > 1)
+		[[[popupButton subviews] objectAtIndex:1] removeFromSuperview];
+	if (b)
+		[self addPopupToButton:b];
+	popupButton = b;
 }
 
 - (BOOL) enableInputClicksWhenVisible {
@@ -111,6 +149,7 @@ PaintingView *pView;
 
 - (IBAction)returnPressed:(id)sender {
     [[UIDevice currentDevice] playInputClick];
+	[pView commitSwypedWord];
 	[self.textView insertText:@"\n"];
 	if ([self.textView isKindOfClass:[UITextView class]])
 		[[NSNotificationCenter defaultCenter] postNotificationName:UITextViewTextDidChangeNotification object:self.textView];
@@ -140,6 +179,7 @@ PaintingView *pView;
 
 - (IBAction)spacePressed:(id)sender {
     [[UIDevice currentDevice] playInputClick];
+	[pView commitSwypedWord];
 		
 	[self.textView insertText:@" "];
     
@@ -170,6 +210,8 @@ PaintingView *pView;
 
 - (IBAction)deletePressed:(id)sender {
     [[UIDevice currentDevice] playInputClick];
+	// editing what was just swiped - it wasn't the word
+	[pView discardSwypedWord];
 	[self.textView deleteBackward];
 	[[NSNotificationCenter defaultCenter] postNotificationName:UITextViewTextDidChangeNotification object:self.textView];
 	if ([self.textView isKindOfClass:[UITextView class]])
@@ -232,37 +274,18 @@ PaintingView *pView;
 	
 	CGPoint location = [[touches anyObject] locationInView:self];
 	
-	pView.nKeyLast = -1;
-	for (UIButton *b in self.characterKeys) {
-		if ([b subviews].count > 1) {
-			[[[b subviews] objectAtIndex:1] removeFromSuperview];
-		}
-		if(CGRectContainsPoint(b.frame, location))
-		{
-			//[self characterPressed:b];
-			[self addPopupToButton:b];
-            pView.nKeyLast = [b.titleLabel.text characterAtIndex:0];
-
-		}
-	}
+	UIButton *b = [self keyAtLocation:location];
+	[self showPopupOnButton:b];
+	pView.nKeyLast = b ? [b.titleLabel.text characterAtIndex:0] : -1;
 	[super touchesBegan:touches withEvent:event];
 }
 
 -(void)touchesMoved: (NSSet *)touches withEvent: (UIEvent *)event {
 	CGPoint location = [[touches anyObject] locationInView:self];
 	
-    pView.nKeyLast = -1;
-	for (UIButton *b in self.characterKeys) {
-		if ([b subviews].count > 1) {
-			[[[b subviews] objectAtIndex:1] removeFromSuperview];
-		}
-		if(CGRectContainsPoint(b.frame, location))
-		{
-            pView.nKeyLast = [b.titleLabel.text characterAtIndex:0];
-			[self addPopupToButton:b];
-			//[self characterPressed:b];
-		}
-	}
+	UIButton *b = [self keyAtLocation:location];
+	[self showPopupOnButton:b];
+	pView.nKeyLast = b ? [b.titleLabel.text characterAtIndex:0] : -1;
 	
 	[super touchesMoved:touches withEvent:event];
 }
@@ -272,20 +295,17 @@ PaintingView *pView;
 	CGPoint location = [[touches anyObject] locationInView:self];
 	
 	//((PaintingView*)self).nKeyLast = -1;
-	for (UIButton *b in self.characterKeys) {
-		if ([b subviews].count > 1) {
-			[[[b subviews] objectAtIndex:1] removeFromSuperview];
-		}
-		if(CGRectContainsPoint(b.frame, location))
-		{
-            pView.nKeyLast = [b.titleLabel.text characterAtIndex:0];
-			//[self characterPressed:b];
-		}
-	}
+	UIButton *b = [self keyAtLocation:location];
+	[self showPopupOnButton:nil];
+	if (b)
+		pView.nKeyLast = [b.titleLabel.text characterAtIndex:0];
 	[super touchesEnded:touches withEvent:event];
 	
     NSString *temp = [pView getSwypedWord];
 
+	// nothing recognised (or a tap) - don't type a stray space
+	if (temp.length == 0)
+		return;
     [self.textView insertText:temp];
     [self.textView insertText:@" "];
 
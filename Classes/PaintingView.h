@@ -12,8 +12,7 @@
 #import <OpenGLES/EAGL.h>
 #import <OpenGLES/ES2/gl.h>
 #import <OpenGLES/ES2/glext.h>
-#import "TDateTime.h"
-#include "Math.h"
+#include "SwipePoint.h"
 #include <vector>
 
 
@@ -37,6 +36,11 @@
 #define kPaletteSize			17
 #define kMinEraseInterval		0.5
 
+// words kept from each gesture - the best, plus alternatives for a suggestion bar
+#define kNumSwypedWords			5
+// how long getSwypedWord may spend decoding on lift (it's on the UI thread) - past this it returns its best so far
+#define kSwypeDeadlineMs		30
+
 /*
 class ProximityMap {
 }
@@ -47,48 +51,6 @@ class ProximityKey {
 	int nKeyWest;
 }
  */
-#define PI 3.14159265
-// TODO: probably there is a better representation for the letters/characters than int
-class SwipePoint {
-public:
-	SwipePoint() {
-		//pTime.setToNow();
-		nMs = 0;
-		pPoint.x = 0;
-		pPoint.y = 0;
-		key = -1;
-		nCnt = 0;
-		fVelocity = 0.0F;
-		nAngle = 0;
-	}
-	~SwipePoint() {};
-	CGPoint pPoint;
-	TDateTime pTime;
-	int nMs;
-	int nCnt;
-	int key;
-	float fVelocity;
-	float fDist;
-	int nAngle;
-	
-	void ComparePointVsLast(SwipePoint prev, float& nVelocity, int& nDist, int& nTime)
-	{
-		//nTime = pTime.asMs() - prev.pTime.asMs();
-	
-		int nDistX = pPoint.x - prev.pPoint.x;
-		int nDistY = pPoint.y - prev.pPoint.y;
-		if (nTime<=0) nTime = 1;
-		
-		fDist = sqrt(nDistX*nDistX + nDistY*nDistY);
-		fVelocity = fDist/(float)nTime;
-		nAngle = atan2(nDistY, nDistX) * 180.0 / PI;
-		
-		nVelocity = fVelocity;
-		nDist = fDist;
-	}
-};
-
-
 @interface PaintingView : UIView <UIInputViewAudioFeedback>
 
 @property(nonatomic, readwrite) SwipePoint sLoc;
@@ -100,6 +62,15 @@ public:
 - (void)setBrushColor:(CGFloat)red green:(CGFloat)green blue:(CGFloat)blue;
 - (void)setBrushColorWithIndex:(NSInteger)nIndex;
 - (NSString*)getSwypedWord;
+- (NSArray*)getSwypedAlternatives; // the runners-up to the last getSwypedWord, without decoding again
+- (NSArray*)getNextWordPredictions; // the likeliest words to follow the last getSwypedWord (or chooseSwypedWord)
+- (void)chooseSwypedWord:(NSString*)word; // the user picked one of the alternatives - the gesture commits as that instead
+- (void)commitSwypedWord; // the last gesture's word is final (e.g. on space) - learns it; the next gesture does this too
+- (void)discardSwypedWord; // the user deleted the last gesture's word - it's not learned
+- (void)learnWord:(NSString*)word; // e.g. one typed key by key
+- (BOOL)recordTracesTo:(NSString*)path; // appends every committed gesture, with its final word, to a trace corpus (see SwipeTrace.h) - nil stops
+- (NSArray*)getLiveSuggestions:(int)maxCount;
+- (void)setKeyLayoutFromButtons:(NSArray*)buttons;
 
 - (void)touchesBegan:(NSSet *)touches withEvent:(UIEvent *)event;
 - (void)touchesMoved:(NSSet *)touches withEvent:(UIEvent *)event;
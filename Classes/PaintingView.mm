@@ -15,11 +15,11 @@
 #import "shaderUtil.h"
 #import "debug.h"
 
-#include <map>
 #include <vector>
-#include "TFile.h"
 #include "TUtils.h"
 #include "TLogging.h"
+#include "SwipeDecoder.h"
+#include "SwipeTrace.h"
 
 using namespace std;
 
@@ -96,8 +96,16 @@ typedef struct {
 	GLuint vboId;
 	
 	std::vector<SwipePoint> arrSwipePoints;
-	std::map<std::string, Vocab> r3l;
-	std::map<std::string, Vocab> r2l;
+	SwipeDecoder swipeDecoder;
+	// the last gesture's words, best first - getSwypedWord returns the first, the rest are alternatives
+	SwipeResult swipeResultBuffer[kNumSwypedWords];
+	SwipeResults swipeResults;
+	// what the last gesture typed, until it's final (see commitSwypedWord) - empty if nothing is pending
+	std::string pendingWord;
+	// every gesture and the word it was committed as, if recording (see recordTracesTo:) - the last
+	// gesture's points wait in pendingPoints until then
+	SwipeTraceWriter traceRecorder;
+	std::vector<SwipePoint> pendingPoints;
 	
 	BOOL initialized;
 
@@ -121,20 +129,16 @@ typedef struct {
 // The GL view is stored in the nib file. When it's unarchived it's sent -initWithCoder:
 - (id)initWithCoder:(NSCoder*)coder {
 	
-	//fix
-	//676 entries, none with > .0023
-	TFileReader fr2l(TUtils::pathForResource("count_2l.txt"));
-	r2l = fr2l.readVocab();
-	
-	//Test r2l
-	//std::map<std::string, Vocab>::iterator iter;
-	//for (iter = r2l.begin(); iter != r2l.end(); ++iter) {
-	//	Vocab* pData = (Vocab*)&iter->second;
-	//	ZLogDebug("str:%s prob:%f pint:%d",pData->d.c_str(), pData->p, pData->pint);
-	//}
-	
-	TFileReader fr3l(TUtils::pathForResource("count_3l.txt"));
-	r3l = fr3l.readVocab();
+	swipeDecoder.loadCharLM(TUtils::pathForResource("count_2l.txt"), TUtils::pathForResource("count_3l.txt"));
+	swipeDecoder.loadLexicon(TUtils::pathForResource("count_big.lex"));
+	swipeDecoder.loadEdits(TUtils::pathForResource("count_1edit.txt"));
+	// next-word prediction, if the bundle has bigrams for this lexicon (see Tools/BigramCompiler.cpp)
+	std::string bigramPath = TUtils::getResourceFilePath("count_2w", "big");
+	if (!bigramPath.empty())
+		swipeDecoder.loadBigrams(bigramPath);
+	// the words the user typed, kept across launches
+	if (TUtils::ensureStateFileSubdirExists("UserDictionary"))
+		swipeDecoder.openUserDictionary(TUtils::getStateFilenameWithPath("UserDictionary"));
 	
     if ((self = [super initWithCoder:coder])) {
 		 CAEAGLLayer *eaglLayer = (CAEAGLLayer *)self.layer;
@@ -499,158 +503,129 @@ typedef struct {
 
 -(NSString*)getSwypedWord
 {
-    std::vector<SwipePoint> arrText;
-    
-	if (arrSwipePoints.size()==0)
+	if (arrSwipePoints.size() < 2)
 		return nullptr;
 	
-	if (arrSwipePoints.size() == 1) {
-		if (arrSwipePoints[0].key>=0)
-			arrText.push_back(arrSwipePoints[0]);
+	// the recognition itself lives in SwipeDecoder so it can be run+profiled off-device - the
+	// points were already fed in as they arrived, so this only has to deal with the last key
+	swipeResults = SwipeResults(swipeResultBuffer, kNumSwypedWords);
+	CountdownTimer deadline(kSwypeDeadlineMs);
+	if (!swipeDecoder.finish(swipeResults, &deadline))
+		return @"";
+	TLogDebug("Decoded '%s' (%d points, %d visits): %lldus while swiping + %lldus on lift%s", swipeResults.results[0].word,
+			  swipeResults.numPoints, swipeResults.numVisits, (long long)swipeResults.searchUs, (long long)swipeResults.finishUs,
+			  swipeResults.converged ? "" : " - hit the deadline");
+	
+	// TODO: lambda analyze FINAL
+	// for now we instead just clear the history
+	//arrSwipePoints.clear();
+	
+	// the keyboard types the best guess straight away, and it's the context for the next gesture -
+	// but it's only learned once it's final, as the user may still pick one of the alternatives
+	swipeDecoder.commitWord(swipeResults.results[0].wordId);
+	pendingWord = swipeResults.results[0].word;
+	if (traceRecorder.isOpen())
+		pendingPoints.assign(arrSwipePoints.begin(), arrSwipePoints.end());
+	return [NSString stringWithUTF8String:swipeResults.results[0].word];
+}
 
-		return nullptr;
+-(NSArray*)getSwypedAlternatives
+{
+	NSMutableArray* alternatives = [NSMutableArray arrayWithCapacity:kNumSwypedWords];
+	for (int i=1; i<swipeResults.count; i++)
+		[alternatives addObject:[NSString stringWithUTF8String:swipeResults.results[i].word]];
+	return alternatives;
+}
+
+-(NSArray*)getNextWordPredictions
+{
+	const std::vector<WordPrediction>& predictions = swipeDecoder.getPredictions();
+	NSMutableArray* words = [NSMutableArray arrayWithCapacity:predictions.size()];
+	for (auto& p: predictions)
+		[words addObject:[NSString stringWithUTF8String:swipeDecoder.getLexicon().word(p.wordId).c_str()]];
+	return words;
+}
+
+-(void)chooseSwypedWord:(NSString*)word
+{
+	const char* utf8 = [word UTF8String];
+	int wordId = -1;
+	for (int i=0; i<swipeResults.count; i++) {
+		if (!strcmp(swipeResults.results[i].word, utf8))
+			wordId = swipeResults.results[i].wordId;
 	}
-	
-TLogDebug("CAPTURE LETTERS");
-	
-	vector<SwipePoint> arrTemp;
-	
-	int i;
-	// setup the first key info, based on what we know
-	int nKey = arrSwipePoints[0].key;
-	int nTLast = arrSwipePoints[0].pTime.asMs();
-	int nMs = 17;
-	int nCnt = 1;
-	int nFirstKey = -1;
-	
-	int nAngleMin, nAngleMax;
-	int nAngleMinLast, nAngleMaxLast;
-	float nVelMin, nVelMax;
-	float nVelMinLast, nVelMaxLast;
-	float fDist = 0;
-	nAngleMin = nAngleMax = -1000;
-	nAngleMinLast = nAngleMaxLast = 0;
-	nVelMin = nVelMax = arrSwipePoints[0].fVelocity;
-	nVelMinLast = nVelMaxLast = 0;
-	int nSize = arrSwipePoints.size();
-	// not so smart algorithm
-	for (i=1; i<nSize; i++) {
-		if (nKey>=0)
-		{
-		// if we have the same key, then measure how long we have stayed hovering over it
-			if (arrSwipePoints[i].key == nKey) {
-				nMs += (arrSwipePoints[i].pTime.asMs() - nTLast);
-				if (arrSwipePoints[i].fVelocity<nVelMin)
-					nVelMin = arrSwipePoints[i].fVelocity;
-				if (arrSwipePoints[i].fVelocity>nVelMax)
-					nVelMax = arrSwipePoints[i].fVelocity;
-				if (abs(arrSwipePoints[i].nAngle)<abs(nAngleMin))
-					nAngleMin = arrSwipePoints[i].nAngle;
-				if (abs(arrSwipePoints[i].nAngle)>abs(nAngleMax))
-					nAngleMax = arrSwipePoints[i].nAngle;
-				fDist += arrSwipePoints[i].fDist;
-				nCnt++;
-			}
-			else {
-				
-				// this algorithm is wrong for predicting what should
-				// be, but it shows us the p of what we captured
-				
-
-				std::string _bi;
-				std::string _tri;
-				float bi = 1;
-				float tri = bi;
-				if (i>1)
-				{
-					char c1 = static_cast<char>(arrSwipePoints[i-2].key);
-					char c2 = static_cast<char>(arrSwipePoints[i-1].key);
-					char c3 = static_cast<char>(arrSwipePoints[i].key);
-				
-					_bi += c1;
-					_bi += c2;
-					_tri = _bi;
-					_tri += c3;
-					tri = r3l[_tri].p;
-					bi = r2l[_bi].p;
-				}
-				
-				int nAbsAngleMinDiff = abs(nAngleMin - nAngleMinLast);
-				int nAbsAngleMaxDiff = abs(nAngleMax - nAngleMaxLast);
-				if (
-					 (nFirstKey==-1) ||
-					 ((tri>0.000017) && (nCnt>1)) ||
-					 (nMs>100) ||
-					 ((tri>0.000017) && (nMs>37) && ((nAbsAngleMaxDiff>45) && (nAbsAngleMaxDiff<360)))
-					 )
-				{
-					nFirstKey = nKey;
-					// OK so we are grabbing this swipe minus 1
-					SwipePoint pt = arrSwipePoints[i-1];
-					pt.fVelocity = nVelMaxLast;
-					// angle was originally determined as the angle of the line from last to current
-					// there is probably a lot more we could do with this analysis of angle to make
-					// this metric more useful - right now we are looking for angle least not angle max
-					// for example
-					pt.nAngle = nAbsAngleMaxDiff;
-					pt.nCnt = nCnt;
-					pt.nMs = nMs;
-					pt.key = nKey;
-					pt.fDist = fDist;
-					arrTemp.push_back(pt);
-					
-TLogDebug("char:%c #:%d ms:%d >:%d bi:%f:%s tri:%f:%s ", static_cast<char>(pt.key), pt.nCnt, pt.nMs, pt.nAngle, bi, _bi.c_str(), tri, _tri.c_str());
-TLogDebug("vel:%d dist:%d", (int)pt.fVelocity, (int)pt.fDist);
-				}
-				nAngleMaxLast = nAngleMax;
-				nVelMaxLast = nVelMax;
-				nAngleMinLast = nAngleMin;
-				nVelMinLast = nVelMin;
-				nAngleMin = nAngleMax = arrSwipePoints[i].nAngle;
-				nVelMin = nVelMax = arrSwipePoints[i].fVelocity;
-				nMs = 0;
-				nCnt = 0;
-				fDist = 0;
-			}
-		}
-		nKey = arrSwipePoints[i].key;
-		nTLast = arrSwipePoints[i].pTime.asMs();
- 	}
-	// get last key
-	if (nCnt && nMs)
-	{
-		SwipePoint pt = arrSwipePoints[i];
-		pt.fVelocity = nVelMin;
-		pt.nAngle = nAngleMin;
-		pt.nCnt = nCnt;
-		pt.nMs = nMs;
-		pt.key = nKey;
-		arrTemp.push_back(pt);
+	swipeDecoder.commitWord(wordId);
+	pendingWord = utf8;
+}
+
+-(void)commitSwypedWord
+{
+	if (pendingWord.empty())
+		return;
+	swipeDecoder.learnWord(pendingWord.c_str(), (int)pendingWord.size());
+	// labelled with the word the user kept, not the decoder's guess - so that the corpus measures accuracy
+	if (traceRecorder.isOpen() && !pendingPoints.empty())
+		traceRecorder.write(&pendingPoints[0], (int)pendingPoints.size(), pendingWord.c_str());
+	pendingWord.clear();
+	pendingPoints.clear();
+}
+
+-(void)discardSwypedWord
+{
+	if (pendingWord.empty())
+		return;
+	swipeDecoder.commitWord(-1);
+	pendingWord.clear();
+	pendingPoints.clear();
+}
+
+-(void)learnWord:(NSString*)word
+{
+	const char* utf8 = [word UTF8String];
+	swipeDecoder.learnWord(utf8, (int)strlen(utf8));
+}
+
+-(BOOL)recordTracesTo:(NSString*)path
+{
+	if (path == nil) {
+		traceRecorder.close();
+		return YES;
 	}
+	if (!traceRecorder.open([path UTF8String]))
+		return NO;
+	traceRecorder.setKeyLayout(swipeDecoder.getKeyLayout());
+	return YES;
+}
 
-	
-	
-TLogDebug("--NEW WORD--")
-	for(auto pt: arrTemp) {
-TLogDebug("c:%c #:%d ms:%d >:%d vel:%f dist:%f", static_cast<char>(pt.key), pt.nCnt, pt.nMs, pt.nAngle, pt.fVelocity, pt.fDist);
-		arrText.push_back(pt);
+-(void)setKeyLayoutFromButtons:(NSArray*)buttons
+{
+	// same coordinates as the touches - relative to this view, flipped for OpenGL
+	CGRect bounds = [self bounds];
+	KeyLayout layout;
+	for (UIButton* b in buttons) {
+		if (b.titleLabel.text.length == 0)
+			continue;
+		CGRect frame = [b convertRect:b.bounds toView:self];
+		layout.addKey([b.titleLabel.text characterAtIndex:0], frame.origin.x,
+					  bounds.size.height - frame.origin.y - frame.size.height, frame.size.width, frame.size.height);
 	}
-    
-    NSMutableString *outstring = [[NSMutableString alloc] init];
-    
-    if (arrText.size()) {
-        for (int i=0; i<arrText.size(); i++)
-        {
-            NSString * temp = [NSString stringWithFormat:@"%c", arrText[i].key];
-            [outstring appendString: temp];
-        }
-    }
+	layout.build();
+	// only rebuilds the templates (or records a new layout) if something moved - the pending gesture
+	// is committed first, so that it's recorded with the layout it was swiped on
+	[self commitSwypedWord];
+	swipeDecoder.setKeyLayout(layout);
+	traceRecorder.setKeyLayout(layout);
+}
+
+-(NSArray*)getLiveSuggestions:(int)maxCount
+{
+	std::vector<SwipeCandidate> candidates;
+	swipeDecoder.liveCandidates(candidates, maxCount);
 	
-	// TODO: lambda analyze FINAL
-	// for now we instead just clear the history
-	//arrSwipePoints.clear();
-    
-    return outstring;
+	NSMutableArray* suggestions = [NSMutableArray arrayWithCapacity:candidates.size()];
+	for (auto& candidate: candidates)
+		[suggestions addObject:[NSString stringWithUTF8String:candidate.word.c_str()]];
+	return suggestions;
 }
 
 
@@ -676,8 +651,13 @@ TLogDebug("c:%c #:%d ms:%d >:%d vel:%f dist:%f", static_cast<char>(pt.key), pt.n
 	// more verbose
 	//ZLogInfo("BEGAN: %fx%f %fx%f",sLocPrev.pPoint.x, sLocPrev.pPoint.y,sLoc.pPoint.x, sLoc.pPoint.y);
 	
+	// a new gesture means the last one's word stayed - before begin(), as learning it can change the search
+	[self commitSwypedWord];
+	
 	// we store the swipe for analysis here
 	arrSwipePoints.push_back(sLoc);
+	swipeDecoder.begin();
+	swipeDecoder.addPoint(sLoc);
 }
 
 // bounds contains the size of the screen palette
@@ -715,8 +695,9 @@ TLogDebug("c:%c #:%d ms:%d >:%d vel:%f dist:%f", static_cast<char>(pt.key), pt.n
 
 	[self setBrushColorWithIndex:nBrush];
 
-	// we store the swipe for analysis here
+	// we store the swipe for analysis here, and decode as we go
 	arrSwipePoints.push_back(sLoc);
+	swipeDecoder.addPoint(sLoc);
 
 	// Render the stroke
 	[self renderLineFromPoint:sLocPrev.pPoint toPoint:sLoc.pPoint];
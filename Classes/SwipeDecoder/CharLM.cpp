@@ -0,0 +1,106 @@
+#include "CharLM.h"
+#include "TFile.h"
+#include "TLogging.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+
+using namespace std;
+
+#define MAX_LINE 100
+
+CharLM::CharLM() {
+	for (int c=0; c<256; c++)
+		symbolOf[c] = kMaxSymbols; // fixed up by load() once the alphabet is known
+	for (unsigned char c='a'; c<='z'; c++)
+		addSymbol(c);
+}
+
+bool CharLM::addSymbol(unsigned char c) {
+	if (loaded || nSymbols >= kMaxSymbols) {
+		TLogError("Can't add '%c' to the alphabet (loaded:%d symbols:%d)", c, loaded, nSymbols);
+		return false;
+	}
+	if (symbolOf[c] != kMaxSymbols)
+		return true;
+	symbolOf[c] = nSymbols;
+	if (isalpha(c))
+		symbolOf[toupper(c)] = nSymbols;
+	nSymbols++;
+	return true;
+}
+
+bool CharLM::mapChar(unsigned char c, unsigned char as) {
+	if (symbolOf[as] >= nSymbols) {
+		TLogError("Can't map '%c' to '%c' which isn't in the alphabet", c, as);
+		return false;
+	}
+	symbolOf[c] = symbolOf[as];
+	return true;
+}
+
+bool CharLM::load(const std::string& path2l, const std::string& path3l) {
+	// everything outside of the alphabet now goes to the 'unknown' symbol at the end
+	stride = nSymbols + 1;
+	for (int c=0; c<256; c++) {
+		if (symbolOf[c] == kMaxSymbols)
+			symbolOf[c] = nSymbols;
+	}
+	loaded = true;
+
+	if (!loadTable(path2l, 2, log2l) || !loadTable(path3l, 3, log3l)) {
+		TLogError("Failed to load letter frequencies from '%s' / '%s'", path2l.c_str(), path3l.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool CharLM::loadTable(const std::string& path, int order, std::vector<LogProb>& table) {
+	TFileReader fr(path);
+	if (!fr.isOpen())
+		return false;
+
+	int size = (order == 2) ? stride*stride : stride*stride*stride;
+	// the counts in these files don't fit in an int (which is why this doesn't use readVocab())
+	vector<double> counts(size, 0.0);
+	double total = 0;
+	char line[MAX_LINE];
+	while (fr.readLine(line, MAX_LINE)) {
+		char* end = nullptr;
+		char* ptr = line;
+		while (isspace(*ptr))
+			++ptr;
+
+		int index = 0;
+		int n = 0;
+		for (; n<order && ptr[n] && !isspace(ptr[n]); n++)
+			index = index*stride + symbolOf[(unsigned char)ptr[n]];
+		if (n != order || !isspace(ptr[n]))
+			continue; // blank line, or an n-gram of the wrong length
+
+		long long cnt = strtoll(ptr+n, &end, 10);
+		if (end == ptr+n || cnt < 0)
+			continue;
+		counts[index] += (double)cnt;
+		total += (double)cnt;
+	}
+	if (total <= 0)
+		return false;
+
+	table.assign(size, 0);
+	for (int i=0; i<size; i++)
+		table[i] = toLogProb(log(TMax(counts[i], 0.5) / total));
+
+	// n-grams involving the unknown symbol always get the floor, even if the file had entries
+	// that folded onto it
+	LogProb floor = toLogProb(log(0.5 / total));
+	for (int i=0; i<size; i++) {
+		for (int k=i, j=0; j<order; j++, k/=stride) {
+			if (k % stride == nSymbols) {
+				table[i] = floor;
+				break;
+			}
+		}
+	}
+	return true;
+}
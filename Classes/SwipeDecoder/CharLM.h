@@ -0,0 +1,71 @@
+#ifndef _CharLM_h
+#define _CharLM_h
+
+#include "TCommon.h"
+#include "LogProb.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ Character bigram/trigram model loaded from count_2l.txt / count_3l.txt, stored as flat
+ (N+1)x(N+1) and (N+1)^3 tables of log-probabilities (as LogProb, 2 bytes an entry).
+
+ Characters are mapped to a dense symbol index through a 256 entry table, so a lookup is just
+ a couple of loads - no strings, no map, no allocation. Every byte that isn't part of the
+ alphabet maps to an extra 'unknown' symbol whose entries hold the floor probability (that of a
+ count of 0.5, same as any unseen n-gram), so lookups don't need to branch on bad input either.
+
+ The alphabet is 'a'-'z' (with 'A'-'Z' folded onto it). It can be extended before loading, e.g.
+	lm.addSymbol('\'');            // apostrophes get their own row/column
+	lm.mapChar(0xe9, 'e');         // ISO-8859-1 e-acute is scored as an 'e'
+ */
+class CharLM {
+public:
+	static const int kMaxSymbols = 40;
+
+	CharLM();
+
+	/// adds 'c' as a new symbol (and its uppercase form, for letters); only valid before load()
+	bool addSymbol(unsigned char c);
+
+	/// scores 'c' as if it were 'as' (which must already be in the alphabet)
+	bool mapChar(unsigned char c, unsigned char as);
+
+	/// returns false if either file couldn't be read
+	bool load(const std::string& path2l, const std::string& path3l);
+
+	bool isLoaded() const { return loaded; }
+	int numSymbols() const { return nSymbols; }
+
+	/// the dense index of 'c', numSymbols() for anything outside of the alphabet
+	inline int symbol(unsigned char c) const { return symbolOf[c]; }
+
+	/// natural log of P(c1 c2) amongst all the bigrams
+	inline LogProb logProb2(unsigned char c1, unsigned char c2) const {
+		return log2l[symbolOf[c1]*stride + symbolOf[c2]];
+	}
+
+	/// natural log of P(c1 c2 c3) amongst all the trigrams
+	inline LogProb logProb3(unsigned char c1, unsigned char c2, unsigned char c3) const {
+		return log3l[(symbolOf[c1]*stride + symbolOf[c2])*stride + symbolOf[c3]];
+	}
+
+	/// same as the above, for symbol indices that have already been looked up
+	inline LogProb logProb2Sym(int s1, int s2) const { return log2l[s1*stride + s2]; }
+	inline LogProb logProb3Sym(int s1, int s2, int s3) const { return log3l[(s1*stride + s2)*stride + s3]; }
+
+private:
+	uint8_t symbolOf[256];
+	int nSymbols = 0;
+	int stride = 0; //< nSymbols + the unknown symbol
+	bool loaded = false;
+	std::vector<LogProb> log2l;
+	std::vector<LogProb> log3l;
+
+	bool loadTable(const std::string& path, int order, std::vector<LogProb>& table);
+
+	DISALLOW_COPY_AND_ASSIGN(CharLM);
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include "GestureDistance.h"
+#include <math.h>
+
+#if defined(__AVX__)
+#	include <immintrin.h>
+#elif defined(__SSE2__)
+#	include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#	include <arm_neon.h>
+#	define GESTURE_NEON 1
+#endif
+
+int gestureDistanceScalar(const float* bx, const float* by, const float* tx, const float* ty, int numPoints, const float* limit, float* sums) {
+	for (int lane=0; lane<kGestureLanes; lane++)
+		sums[lane] = 0;
+
+	int i = 0;
+	while (i < numPoints) {
+		int stop = (i + kGestureAbandonStep < numPoints) ? i + kGestureAbandonStep : numPoints;
+		for (; i<stop; i++) {
+			const float* px = bx + i*kGestureLanes;
+			const float* py = by + i*kGestureLanes;
+			for (int lane=0; lane<kGestureLanes; lane++) {
+				float dx = px[lane] - tx[i];
+				float dy = py[lane] - ty[i];
+				sums[lane] += sqrtf(dx*dx + dy*dy);
+			}
+		}
+		if (i < numPoints) {
+			bool all = true;
+			for (int lane=0; lane<kGestureLanes; lane++)
+				all = all && (sums[lane] > limit[lane]);
+			if (all)
+				break;
+		}
+	}
+	return i;
+}
+
+#if defined(__AVX__)
+
+const char* gestureDistanceKernel() { return "avx"; }
+
+int gestureDistance(const float* bx, const float* by, const float* tx, const float* ty, int numPoints, const float* limit, float* sums) {
+	__m256 sum = _mm256_setzero_ps();
+	const __m256 lim = _mm256_loadu_ps(limit);
+	int i = 0;
+	while (i < numPoints) {
+		int stop = (i + kGestureAbandonStep < numPoints) ? i + kGestureAbandonStep : numPoints;
+		for (; i<stop; i++) {
+			__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(bx + i*kGestureLanes), _mm256_set1_ps(tx[i]));
+			__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(by + i*kGestureLanes), _mm256_set1_ps(ty[i]));
+			sum = _mm256_add_ps(sum, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy))));
+		}
+		if (i < numPoints && _mm256_movemask_ps(_mm256_cmp_ps(sum, lim, _CMP_GT_OQ)) == 0xff)
+			break;
+	}
+	_mm256_storeu_ps(sums, sum);
+	return i;
+}
+
+#elif defined(__SSE2__)
+
+const char* gestureDistanceKernel() { return "sse2"; }
+
+int gestureDistance(const float* bx, const float* by, const float* tx, const float* ty, int numPoints, const float* limit, float* sums) {
+	// two halves of 4 lanes
+	__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+	const __m128 lim0 = _mm_loadu_ps(limit), lim1 = _mm_loadu_ps(limit + 4);
+	int i = 0;
+	while (i < numPoints) {
+		int stop = (i + kGestureAbandonStep < numPoints) ? i + kGestureAbandonStep : numPoints;
+		for (; i<stop; i++) {
+			const __m128 x = _mm_set1_ps(tx[i]);
+			const __m128 y = _mm_set1_ps(ty[i]);
+			__m128 dx0 = _mm_sub_ps(_mm_loadu_ps(bx + i*kGestureLanes), x);
+			__m128 dy0 = _mm_sub_ps(_mm_loadu_ps(by + i*kGestureLanes), y);
+			__m128 dx1 = _mm_sub_ps(_mm_loadu_ps(bx + i*kGestureLanes + 4), x);
+			__m128 dy1 = _mm_sub_ps(_mm_loadu_ps(by + i*kGestureLanes + 4), y);
+			sum0 = _mm_add_ps(sum0, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx0, dx0), _mm_mul_ps(dy0, dy0))));
+			sum1 = _mm_add_ps(sum1, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx1, dx1), _mm_mul_ps(dy1, dy1))));
+		}
+		if (i < numPoints && (_mm_movemask_ps(_mm_cmpgt_ps(sum0, lim0)) & _mm_movemask_ps(_mm_cmpgt_ps(sum1, lim1))) == 0xf)
+			break;
+	}
+	_mm_storeu_ps(sums, sum0);
+	_mm_storeu_ps(sums + 4, sum1);
+	return i;
+}
+
+#elif GESTURE_NEON
+
+const char* gestureDistanceKernel() { return "neon"; }
+
+static inline float32x4_t gestureSqrt(float32x4_t v) {
+#if defined(__aarch64__)
+	return vsqrtq_f32(v);
+#else
+	// armv7 has no vector sqrt: v * 1/sqrt(v), with one Newton step (and 0 staying 0)
+	float32x4_t r = vrsqrteq_f32(vmaxq_f32(v, vdupq_n_f32(1e-20f)));
+	r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(v, r), r));
+	return vmulq_f32(v, r);
+#endif
+}
+
+static inline bool allSet(uint32x4_t a, uint32x4_t b) {
+	uint32x4_t both = vandq_u32(a, b);
+	uint32x2_t m = vand_u32(vget_low_u32(both), vget_high_u32(both));
+	return (vget_lane_u32(m, 0) & vget_lane_u32(m, 1)) != 0;
+}
+
+int gestureDistance(const float* bx, const float* by, const float* tx, const float* ty, int numPoints, const float* limit, float* sums) {
+	float32x4_t sum0 = vdupq_n_f32(0), sum1 = vdupq_n_f32(0);
+	const float32x4_t lim0 = vld1q_f32(limit), lim1 = vld1q_f32(limit + 4);
+	int i = 0;
+	while (i < numPoints) {
+		int stop = (i + kGestureAbandonStep < numPoints) ? i + kGestureAbandonStep : numPoints;
+		for (; i<stop; i++) {
+			const float32x4_t x = vdupq_n_f32(tx[i]);
+			const float32x4_t y = vdupq_n_f32(ty[i]);
+			float32x4_t dx0 = vsubq_f32(vld1q_f32(bx + i*kGestureLanes), x);
+			float32x4_t dy0 = vsubq_f32(vld1q_f32(by + i*kGestureLanes), y);
+			float32x4_t dx1 = vsubq_f32(vld1q_f32(bx + i*kGestureLanes + 4), x);
+			float32x4_t dy1 = vsubq_f32(vld1q_f32(by + i*kGestureLanes + 4), y);
+			sum0 = vaddq_f32(sum0, gestureSqrt(vmlaq_f32(vmulq_f32(dx0, dx0), dy0, dy0)));
+			sum1 = vaddq_f32(sum1, gestureSqrt(vmlaq_f32(vmulq_f32(dx1, dx1), dy1, dy1)));
+		}
+		if (i < numPoints && allSet(vcgtq_f32(sum0, lim0), vcgtq_f32(sum1, lim1)))
+			break;
+	}
+	vst1q_f32(sums, sum0);
+	vst1q_f32(sums + 4, sum1);
+	return i;
+}
+
+#else
+
+const char* gestureDistanceKernel() { return "scalar"; }
+
+int gestureDistance(const float* bx, const float* by, const float* tx, const float* ty, int numPoints, const float* limit, float* sums) {
+	return gestureDistanceScalar(bx, by, tx, ty, numPoints, limit, sums);
+}
+
+#endif
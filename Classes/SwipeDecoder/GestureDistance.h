@@ -0,0 +1,29 @@
+#ifndef _GestureDistance_h
+#define _GestureDistance_h
+
+/**
+ The inner loop of the shape matcher: the summed point-to-point distance between the (resampled)
+ trace and a block of kGestureLanes templates at once.
+
+ A block stores its templates interleaved, point by point, so that one vector load picks up the
+ same point of every template in the block:
+	bx[i*kGestureLanes + lane] = x of point i of template 'lane'
+ (by[] the same for y).
+
+ Each lane has a limit - once the partial sums of all the lanes are over their limits the rest of
+ the points are skipped (checked every kGestureAbandonStep points). The sums of abandoned lanes are
+ only known to be > limit. Pass INFINITY to always finish a lane, or a negative limit to ignore it.
+
+ Returns the number of points that were summed (numPoints unless abandoned).
+
+ gestureDistance() is the fastest kernel this was compiled for (AVX, SSE2, NEON or the scalar
+ reference) - see gestureDistanceKernel() for which.
+ */
+static const int kGestureLanes = 8;
+static const int kGestureAbandonStep = 8;
+
+int gestureDistanceScalar(const float* bx, const float* by, const float* tx, const float* ty, int numPoints, const float* limit, float* sums);
+int gestureDistance(const float* bx, const float* by, const float* tx, const float* ty, int numPoints, const float* limit, float* sums);
+const char* gestureDistanceKernel();
+
+#endif
@@ -0,0 +1,300 @@
+#include "GestureTemplates.h"
+#include "TLogging.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+using namespace std;
+
+#pragma mark - GestureTemplates
+
+void GestureTemplates::clear() {
+	pointsX.clear();
+	pointsY.clear();
+	lengths.clear();
+	wordIds.clear();
+	buckets.clear();
+	templateOfWord.clear();
+}
+
+bool GestureTemplates::build(const Lexicon& lexicon, const KeyLayout& keyLayout) {
+	clear();
+	layout = keyLayout;
+	if (layout.empty() || !lexicon.isLoaded())
+		return false;
+
+	// lay out every word, remembering which bucket it goes in
+	vector<float> wordX, wordY, wordLength;
+	vector<uint32_t> wordIdList;
+	vector<int> wordBucket;
+	vector<int> counts(kNumLetters*kNumLetters, 0);
+	wordX.reserve(lexicon.wordCount() * kNumPoints);
+	wordY.reserve(lexicon.wordCount() * kNumPoints);
+
+	lexicon.forEachWord([&](uint32_t wordId, const char* word, int len) {
+		float cx[Lexicon::kMaxWordLen], cy[Lexicon::kMaxWordLen];
+		int n = 0;
+		if (len == 0)
+			return;
+		for (int i=0; i<len; i++) {
+			const SwipeKey* key = layout.findKey((unsigned char)word[i]);
+			if (!key)
+				return;
+			if (i > 0 && word[i] == word[i-1])
+				continue;
+			cx[n] = key->centreX();
+			cy[n] = key->centreY();
+			n++;
+		}
+		size_t at = wordX.size();
+		wordX.resize(at + kNumPoints);
+		wordY.resize(at + kNumPoints);
+		wordLength.push_back(SwipeResampler::resample(cx, cy, nullptr, n, kNumPoints, &wordX[at], &wordY[at]));
+		wordIdList.push_back(wordId);
+		int bucket = (word[0]-'a')*kNumLetters + (word[len-1]-'a');
+		wordBucket.push_back(bucket);
+		counts[bucket]++;
+	});
+	if (wordIdList.empty()) {
+		TLogError("None of the %d words fit the layout", lexicon.wordCount());
+		return false;
+	}
+
+	// ... then copy them into place, bucket by bucket - most frequent words first within a bucket, so
+	// that a match() cut short by its deadline has seen the likeliest ones
+	int numTemplates = (int)wordIdList.size();
+	buckets.resize(kNumLetters*kNumLetters + 1);
+	buckets[0] = 0;
+	for (int b=0; b<kNumLetters*kNumLetters; b++)
+		buckets[b+1] = buckets[b] + counts[b];
+	vector<int> order(numTemplates);
+	for (int w=0; w<numTemplates; w++)
+		order[w] = w;
+	sort(order.begin(), order.end(), [&](int a, int b) {
+		if (wordBucket[a] != wordBucket[b])
+			return wordBucket[a] < wordBucket[b];
+		LogProb pa = lexicon.logPrior(wordIdList[a]), pb = lexicon.logPrior(wordIdList[b]);
+		return (pa != pb) ? pa > pb : wordIdList[a] < wordIdList[b];
+	});
+
+	// (the unused lanes of the last block are left as zeros)
+	pointsX.assign(((numTemplates + kGestureLanes-1) / kGestureLanes) * kGestureLanes * kNumPoints, 0.0f);
+	pointsY.assign(pointsX.size(), 0.0f);
+	lengths.resize(numTemplates);
+	wordIds.resize(numTemplates);
+	templateOfWord.assign(lexicon.wordCount(), -1);
+	for (int t=0; t<numTemplates; t++) {
+		const int w = order[t];
+		float* bx = &pointsX[(t/kGestureLanes) * kNumPoints * kGestureLanes + t%kGestureLanes];
+		float* by = &pointsY[(t/kGestureLanes) * kNumPoints * kGestureLanes + t%kGestureLanes];
+		for (int i=0; i<kNumPoints; i++) {
+			bx[i*kGestureLanes] = wordX[w*kNumPoints + i];
+			by[i*kGestureLanes] = wordY[w*kNumPoints + i];
+		}
+		lengths[t] = wordLength[w];
+		wordIds[t] = wordIdList[w];
+		templateOfWord[wordIdList[w]] = t;
+	}
+
+	TLogDebug("Built %d gesture templates (%d words)", numTemplates, lexicon.wordCount());
+	return true;
+}
+
+#pragma mark - ShapeMatcher
+
+bool ShapeMatcher::setTrace(const SwipeResampler& trace) {
+	if (trace.empty())
+		return false;
+	traceLength = trace.resample(GestureTemplates::kNumPoints, traceX, traceY);
+	selectBuckets();
+	return true;
+}
+
+bool ShapeMatcher::setTrace(const float* xs, const float* ys, int n) {
+	if (n <= 0)
+		return false;
+	traceLength = SwipeResampler::resample(xs, ys, nullptr, n, GestureTemplates::kNumPoints, traceX, traceY);
+	selectBuckets();
+	return true;
+}
+
+void ShapeMatcher::copyTrace(const ShapeMatcher& other) {
+	config = other.config;
+	memcpy(traceX, other.traceX, sizeof(traceX));
+	memcpy(traceY, other.traceY, sizeof(traceY));
+	traceLength = other.traceLength;
+	numBuckets = other.numBuckets;
+	numCandidates = other.numCandidates;
+	memcpy(bucketBegin, other.bucketBegin, numBuckets * sizeof(bucketBegin[0]));
+	memcpy(bucketEnd, other.bucketEnd, numBuckets * sizeof(bucketEnd[0]));
+}
+
+/// picks the (start, end) buckets the trace could belong to, closest to the trace's ends first
+void ShapeMatcher::selectBuckets() {
+	const KeyLayout& layout = templates.getLayout();
+	const float kw = layout.getKeyWidth();
+	const int N = GestureTemplates::kNumPoints;
+	const int L = GestureTemplates::kNumLetters;
+	numBuckets = 0;
+	numCandidates = 0;
+	if (templates.empty() || kw <= 0)
+		return;
+
+	// the letters the trace could start/end on - within endRadius, or at least the nearest one
+	int starts[L], ends[L];
+	float startDist[L], endDist[L];
+	int numStarts = 0, numEnds = 0;
+	int nearestStart = -1, nearestEnd = -1;
+	float bestStart = INFINITY, bestEnd = INFINITY;
+	for (int l=0; l<L; l++) {
+		const SwipeKey* key = layout.findKey('a' + l);
+		if (!key)
+			continue;
+		float ds = hypotf(key->centreX() - traceX[0], key->centreY() - traceY[0]) / kw;
+		float de = hypotf(key->centreX() - traceX[N-1], key->centreY() - traceY[N-1]) / kw;
+		if (ds <= config.endRadius) {
+			startDist[numStarts] = ds;
+			starts[numStarts++] = l;
+		}
+		if (de <= config.endRadius) {
+			endDist[numEnds] = de;
+			ends[numEnds++] = l;
+		}
+		if (ds < bestStart) { bestStart = ds; nearestStart = l; }
+		if (de < bestEnd) { bestEnd = de; nearestEnd = l; }
+	}
+	if (numStarts == 0 && nearestStart >= 0) {
+		startDist[numStarts] = bestStart;
+		starts[numStarts++] = nearestStart;
+	}
+	if (numEnds == 0 && nearestEnd >= 0) {
+		endDist[numEnds] = bestEnd;
+		ends[numEnds++] = nearestEnd;
+	}
+
+	// nearest first - that's the order they get scored in, so if the deadline cuts the search short
+	// it's the least likely ones that are left
+	int pairs[L*L];
+	int numPairs = 0;
+	for (int s=0; s<numStarts; s++)
+		for (int e=0; e<numEnds; e++)
+			pairs[numPairs++] = s*L + e;
+	sort(pairs, pairs + numPairs, [&](int a, int b) {
+		return startDist[a/L] + endDist[a%L] < startDist[b/L] + endDist[b%L];
+	});
+	for (int p=0; p<numPairs; p++) {
+		int begin = templates.bucketBegin(starts[pairs[p]/L], ends[pairs[p]%L]);
+		int end = templates.bucketEnd(starts[pairs[p]/L], ends[pairs[p]%L]);
+		if (begin == end)
+			continue;
+		bucketBegin[numBuckets] = begin;
+		bucketEnd[numBuckets] = end;
+		numBuckets++;
+		numCandidates += end - begin;
+	}
+}
+
+/// sum of the distances between corresponding points of the trace and template 't'
+float ShapeMatcher::distance(int t) const {
+	float sum = 0;
+	for (int i=0; i<GestureTemplates::kNumPoints; i++)
+		sum += hypotf(templates.x(t, i) - traceX[i], templates.y(t, i) - traceY[i]);
+	return sum;
+}
+
+float ShapeMatcher::logLikelihood(uint32_t wordId) const {
+	int t = templates.templateOf(wordId);
+	if (t < 0)
+		return -INFINITY;
+	float d = distance(t) / (GestureTemplates::kNumPoints * templates.getLayout().getKeyWidth());
+	return -0.5f * (d/config.sigma) * (d/config.sigma);
+}
+
+static bool worseMatch(const ShapeMatch& a, const ShapeMatch& b) {
+	return a.score > b.score;
+}
+
+/// keeps the best maxCandidates matches in 'heap', the worst at the front
+void ShapeMatcher::offer(const ShapeMatch& m) {
+	if ((int)heap.size() < config.maxCandidates) {
+		heap.push_back(m);
+		push_heap(heap.begin(), heap.end(), worseMatch);
+	}
+	else if (m.score > heap.front().score) {
+		pop_heap(heap.begin(), heap.end(), worseMatch);
+		heap.back() = m;
+		push_heap(heap.begin(), heap.end(), worseMatch);
+	}
+}
+
+int ShapeMatcher::match(std::vector<ShapeMatch>& out, const CountdownTimer* deadline, int shard, int numShards) {
+	const float kw = templates.getLayout().getKeyWidth();
+	const int N = GestureTemplates::kNumPoints;
+	converged = true;
+	heap.clear();
+	if (numBuckets == 0)
+		return 0;
+
+	const float minRatio = 1.0f / config.maxLengthRatio;
+	const float twoSigma2 = 2 * config.sigma * config.sigma;
+	const float sumPerKeyWidth = N * kw; // a summed distance of this is a mean of 1 key width
+	int blockNum = 0, blocksDone = 0;
+	for (int b=0; b<numBuckets && converged; b++) {
+		const int begin = bucketBegin[b];
+		const int end = bucketEnd[b];
+		for (int block=begin/kGestureLanes; block<=(end-1)/kGestureLanes; block++) {
+			// the shards take turns, block by block, so each gets its share of the likeliest buckets
+			if (numShards > 1 && (blockNum++ % numShards) != shard)
+				continue;
+			if (deadline && (blocksDone++ % kDeadlineCheckBlocks) == 0 && deadline->isFinished()) {
+				converged = false;
+				break;
+			}
+
+			// work out which lanes are worth scoring, and how far
+			float limit[kGestureLanes];
+			float prior[kGestureLanes];
+			bool any = false;
+			const bool full = ((int)heap.size() >= config.maxCandidates);
+			for (int lane=0; lane<kGestureLanes; lane++) {
+				int t = block*kGestureLanes + lane;
+				limit[lane] = -1;
+				if (t < begin || t >= end)
+					continue;
+				float ratio = (templates.length(t) + kw) / (traceLength + kw);
+				if (ratio < minRatio || ratio > config.maxLengthRatio)
+					continue;
+				prior[lane] = config.priorWeight * logScoreToFloat(lexicon.logPrior(templates.wordId(t)));
+				if (full) {
+					float slack = prior[lane] - heap.front().score;
+					if (slack <= 0)
+						continue; // even a perfect match couldn't make it
+					limit[lane] = sqrtf(slack * twoSigma2) * sumPerKeyWidth;
+				}
+				else {
+					limit[lane] = INFINITY;
+				}
+				any = true;
+			}
+			if (!any)
+				continue;
+
+			float sums[kGestureLanes];
+			if (gestureDistance(templates.blockXs(block), templates.blockYs(block), traceX, traceY, N, limit, sums) < N)
+				continue; // all abandoned
+
+			for (int lane=0; lane<kGestureLanes; lane++) {
+				if (limit[lane] < 0 || sums[lane] > limit[lane])
+					continue;
+				int t = block*kGestureLanes + lane;
+				float d = sums[lane] / sumPerKeyWidth;
+				ShapeMatch m = { templates.wordId(t), d, prior[lane] - d*d/twoSigma2 };
+				offer(m);
+			}
+		}
+	}
+
+	sort_heap(heap.begin(), heap.end(), worseMatch);
+	out.insert(out.end(), heap.begin(), heap.end());
+	return (int)heap.size();
+}
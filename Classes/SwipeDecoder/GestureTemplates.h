@@ -0,0 +1,150 @@
+#ifndef _GestureTemplates_h
+#define _GestureTemplates_h
+
+#include "TCommon.h"
+#include "GestureDistance.h"
+#include "KeyLayout.h"
+#include "Lexicon.h"
+#include "SwipeResampler.h"
+#include "TTimer.h"
+#include <stdint.h>
+#include <vector>
+
+/**
+ The ideal gesture for every word of the lexicon on one key layout: the polyline through the
+ centres of its keys (repeated letters only count once), resampled to kNumPoints points.
+
+ The points are stored as two flat arrays (all x's, all y's), and the templates are sorted by
+ (first letter, last letter) so that all of the candidates for a given start and end key are one
+ contiguous run of memory, most frequent word first. Within that, every kGestureLanes consecutive templates form a block whose
+ points are interleaved (see GestureDistance.h), so that the distance kernel can score a whole block
+ with one vector op per point. Rebuild whenever the layout or lexicon changes.
+ */
+class GestureTemplates {
+public:
+	static const int kNumPoints = 32;
+	static const int kNumLetters = 26;
+
+	GestureTemplates() {}
+
+	/// returns false if none of the words could be laid out
+	bool build(const Lexicon& lexicon, const KeyLayout& layout);
+	void clear();
+
+	bool empty() const { return wordIds.empty(); }
+	int size() const { return (int)wordIds.size(); }
+	const KeyLayout& getLayout() const { return layout; }
+
+	/// templates [bucketBegin(first, last), bucketEnd(first, last)) start/end on those letters (0..25)
+	int bucketBegin(int first, int last) const { return buckets[first*kNumLetters + last]; }
+	int bucketEnd(int first, int last) const { return buckets[first*kNumLetters + last + 1]; }
+
+	int numBlocks() const { return (size() + kGestureLanes-1) / kGestureLanes; }
+	const float* blockXs(int block) const { return &pointsX[block*kNumPoints*kGestureLanes]; }
+	const float* blockYs(int block) const { return &pointsY[block*kNumPoints*kGestureLanes]; }
+
+	/// point i of template t
+	float x(int t, int i) const { return pointsX[((t/kGestureLanes)*kNumPoints + i)*kGestureLanes + t%kGestureLanes]; }
+	float y(int t, int i) const { return pointsY[((t/kGestureLanes)*kNumPoints + i)*kGestureLanes + t%kGestureLanes]; }
+	float length(int t) const { return lengths[t]; }
+	uint32_t wordId(int t) const { return wordIds[t]; }
+
+	/// the template for a word id, -1 if the word couldn't be laid out
+	int templateOf(uint32_t wordId) const { return wordId < templateOfWord.size() ? templateOfWord[wordId] : -1; }
+
+private:
+	KeyLayout layout;
+	std::vector<float> pointsX; //< interleaved in blocks of kGestureLanes templates
+	std::vector<float> pointsY;
+	std::vector<float> lengths;
+	std::vector<uint32_t> wordIds;
+	std::vector<int> buckets;        //< kNumLetters^2 + 1 offsets into the above
+	std::vector<int> templateOfWord;
+
+	DISALLOW_COPY_AND_ASSIGN(GestureTemplates);
+};
+
+struct ShapeMatchConfig {
+	int maxCandidates = 10;
+	float sigma = 0.5f;            //< std-dev of the point-to-point distance, in key widths
+	float endRadius = 1.0f;        //< start/end keys are those within this many key widths
+	float maxLengthRatio = 1.8f;   //< trace vs template length, either way round
+	float priorWeight = 1.0f;
+	int minParallelCandidates = 2048; //< fewer than this and ShapeMatchPool doesn't bother with its threads
+};
+
+struct ShapeMatch {
+	uint32_t wordId;
+	float distance;  //< mean distance between corresponding points, in key widths
+	float score;     //< log-likelihood of the distance + weighted prior
+};
+
+/**
+ Compares a swipe trace against the templates: the trace is resampled the same way, the candidates
+ are narrowed down to the templates that start and end near the trace's end points and have a
+ similar length, and those are scored by the mean distance between corresponding points.
+
+ Scoring goes a block of templates at a time through gestureDistance(). Once the heap of best
+ matches is full, each template gets a distance limit (the distance at which even its prior couldn't
+ get it into the heap any more), so most blocks are abandoned after the first few points.
+
+ Holds its own scratch space - use one per thread, sharing the (read-only) templates.
+ */
+class ShapeMatcher {
+	const GestureTemplates& templates;
+	const Lexicon& lexicon;
+	ShapeMatchConfig config;
+
+	float traceX[GestureTemplates::kNumPoints];
+	float traceY[GestureTemplates::kNumPoints];
+	float traceLength = 0;
+	// the template ranges the trace could match, most likely first (see selectBuckets())
+	int bucketBegin[GestureTemplates::kNumLetters * GestureTemplates::kNumLetters];
+	int bucketEnd[GestureTemplates::kNumLetters * GestureTemplates::kNumLetters];
+	int numBuckets = 0;
+	int numCandidates = 0;
+	std::vector<ShapeMatch> heap;
+	bool converged = true;
+
+	/// how often match() looks at its deadline
+	static const int kDeadlineCheckBlocks = 16;
+
+public:
+	ShapeMatcher(const GestureTemplates& t, const Lexicon& l) : templates(t), lexicon(l) {}
+
+	ShapeMatchConfig& getConfig() { return config; }
+
+	/// resamples and stores the trace for match()/logLikelihood() - false if it is empty
+	bool setTrace(const SwipeResampler& trace);
+	bool setTrace(const float* xs, const float* ys, int n);
+	/// the same trace (and config) as another matcher - e.g. for worker threads
+	void copyTrace(const ShapeMatcher& other);
+
+	/// how many templates match() will look at for this trace, before the length check
+	int getNumCandidates() const { return numCandidates; }
+
+	/**
+	 Appends the best matches, best first. Returns the number added.
+
+	 With a deadline, gives up when it expires and returns the best found so far - the buckets are
+	 scored nearest first and the templates within them most frequent first, so what is left out is
+	 the least likely. hasConverged() says whether it got through everything.
+
+	 With numShards > 1, only scores every numShards'th block starting at 'shard' - see ShapeMatchPool.
+	 */
+	int match(std::vector<ShapeMatch>& out, const CountdownTimer* deadline = nullptr, int shard = 0, int numShards = 1);
+	bool hasConverged() const { return converged; }
+	const ShapeMatchConfig& getConfig() const { return config; }
+
+	/// log-likelihood of the trace for one word (no prior), or -INFINITY if there's no template
+	float logLikelihood(uint32_t wordId) const;
+
+private:
+	void selectBuckets();
+	float distance(int t) const;
+	void offer(const ShapeMatch& m);
+
+	DISALLOW_COPY_AND_ASSIGN(ShapeMatcher);
+};
+
+#endif
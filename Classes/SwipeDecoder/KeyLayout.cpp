@@ -0,0 +1,170 @@
+#include "KeyLayout.h"
+#include <ctype.h>
+#include <math.h>
+#include <string.h>
+
+/// the most cells the grid index is allowed - the cells get bigger for huge layouts
+static const int kMaxGridCells = 4096;
+
+/// squared distance from the point to the nearest part of the key (0 inside it)
+static inline float distance2(const SwipeKey& k, float px, float py) {
+	float dx = TMax(TMax(k.x - px, px - (k.x + k.w)), 0.0f);
+	float dy = TMax(TMax(k.y - py, py - (k.y + k.h)), 0.0f);
+	return dx*dx + dy*dy;
+}
+
+void KeyLayout::clear() {
+	keys.clear();
+	for (int i=0; i<256; i++)
+		indexOf[i] = -1;
+	keyWidth = 0;
+	gridCols = gridRows = 0;
+	cellStart.clear();
+	cellKeys.clear();
+}
+
+void KeyLayout::addKey(int key, float x, float y, float w, float h) {
+	if (key < 0 || key >= 256)
+		return;
+	SwipeKey k = { key, x, y, w, h };
+	indexOf[key] = (int16_t)keys.size();
+	// the decoder works in lowercase, the buttons can be either
+	if (isalpha(key))
+		indexOf[tolower(key)] = indexOf[toupper(key)] = indexOf[key];
+	keys.push_back(k);
+	// the index is out of date until build()
+	gridCols = gridRows = 0;
+}
+
+void KeyLayout::build() {
+	keyWidth = 0;
+	gridCols = gridRows = 0;
+	if (keys.empty())
+		return;
+	for (auto& k: keys)
+		keyWidth += k.w;
+	keyWidth /= keys.size();
+	buildIndex();
+}
+
+void KeyLayout::buildIndex() {
+	// cells of half the smallest key, so a cell is never spread over many keys
+	float x0 = keys[0].x, y0 = keys[0].y, x1 = x0 + keys[0].w, y1 = y0 + keys[0].h;
+	float minW = keys[0].w, minH = keys[0].h;
+	for (auto& k: keys) {
+		x0 = TMin(x0, k.x);
+		y0 = TMin(y0, k.y);
+		x1 = TMax(x1, k.x + k.w);
+		y1 = TMax(y1, k.y + k.h);
+		minW = TMin(minW, k.w);
+		minH = TMin(minH, k.h);
+	}
+	gridX = x0;
+	gridY = y0;
+	cellW = TMax(minW * 0.5f, 1.0f);
+	cellH = TMax(minH * 0.5f, 1.0f);
+	while (ceilf((x1-x0)/cellW) * ceilf((y1-y0)/cellH) > kMaxGridCells) {
+		cellW *= 2;
+		cellH *= 2;
+	}
+	gridCols = TMax((int)ceilf((x1-x0)/cellW), 1);
+	gridRows = TMax((int)ceilf((y1-y0)/cellH), 1);
+
+	// a key can only be the nearest to some point of the cell if its distance to the cell is no more
+	// than the best any key can guarantee for the whole cell (the distance to its furthest corner)
+	cellStart.resize(gridCols*gridRows + 1);
+	cellKeys.clear();
+	for (int r=0; r<gridRows; r++) {
+		for (int c=0; c<gridCols; c++) {
+			SwipeKey cell = { 0, gridX + c*cellW, gridY + r*cellH, cellW, cellH };
+			float bound = INFINITY;
+			for (auto& k: keys) {
+				float corner = TMax(TMax(distance2(k, cell.x, cell.y), distance2(k, cell.x + cell.w, cell.y)),
+									TMax(distance2(k, cell.x, cell.y + cell.h), distance2(k, cell.x + cell.w, cell.y + cell.h)));
+				bound = TMin(bound, corner);
+			}
+			cellStart[r*gridCols + c] = (uint32_t)cellKeys.size();
+			for (size_t i=0; i<keys.size(); i++) {
+				const SwipeKey& k = keys[i];
+				float dx = TMax(TMax(k.x - (cell.x + cell.w), cell.x - (k.x + k.w)), 0.0f);
+				float dy = TMax(TMax(k.y - (cell.y + cell.h), cell.y - (k.y + k.h)), 0.0f);
+				if (dx*dx + dy*dy <= bound)
+					cellKeys.push_back((int16_t)i);
+			}
+		}
+	}
+	cellStart[gridCols*gridRows] = (uint32_t)cellKeys.size();
+}
+
+const SwipeKey* KeyLayout::keyAt(float px, float py) const {
+	if (gridCols == 0)
+		return nullptr;
+	int c = (int)floorf((px - gridX) / cellW);
+	int r = (int)floorf((py - gridY) / cellH);
+	if (c < 0 || c >= gridCols || r < 0 || r >= gridRows)
+		return nullptr;
+	const int cell = r*gridCols + c;
+	for (uint32_t i=cellStart[cell]; i<cellStart[cell+1]; i++) {
+		const SwipeKey& k = keys[cellKeys[i]];
+		if (k.contains(px, py))
+			return &k;
+	}
+	return nullptr;
+}
+
+const SwipeKey* KeyLayout::nearestOf(const int16_t* candidates, int count, float px, float py, float* distance) const {
+	const SwipeKey* best = nullptr;
+	float bestD2 = INFINITY;
+	for (int i=0; i<count; i++) {
+		const SwipeKey& k = keys[candidates ? candidates[i] : i];
+		float d2 = distance2(k, px, py);
+		if (d2 < bestD2) {
+			bestD2 = d2;
+			best = &k;
+		}
+	}
+	if (distance)
+		*distance = best ? sqrtf(bestD2) : INFINITY;
+	return best;
+}
+
+const SwipeKey* KeyLayout::nearestKey(float px, float py, float* distance) const {
+	if (gridCols == 0) {
+		if (distance)
+			*distance = INFINITY;
+		return nullptr;
+	}
+	int c = (int)floorf((px - gridX) / cellW);
+	int r = (int)floorf((py - gridY) / cellH);
+	if (c < 0 || c >= gridCols || r < 0 || r >= gridRows)
+		return nearestOf(nullptr, (int)keys.size(), px, py, distance);
+	const int cell = r*gridCols + c;
+	return nearestOf(&cellKeys[cellStart[cell]], (int)(cellStart[cell+1] - cellStart[cell]), px, py, distance);
+}
+
+void KeyLayout::setQwerty(float width, float height) {
+	static const char* rows[] = { "qwertyuiop", "asdfghjkl", "zxcvbnm" };
+	clear();
+	float w = width / 10;
+	float h = height / 4; // the 4th row is space etc.
+	for (int r=0; r<3; r++) {
+		int n = (int)strlen(rows[r]);
+		float x = (width - n*w) * 0.5f;
+		float y = height - (r+1)*h;
+		for (int i=0; i<n; i++)
+			addKey(rows[r][i], x + i*w, y, w, h);
+	}
+	build();
+}
+
+bool KeyLayout::operator==(const KeyLayout& other) const {
+	if (keys.size() != other.keys.size())
+		return false;
+	for (size_t i=0; i<keys.size(); i++) {
+		const SwipeKey& a = keys[i];
+		const SwipeKey& b = other.keys[i];
+		if (a.key != b.key || a.x != b.x || a.y != b.y || a.w != b.w || a.h != b.h)
+			return false;
+	}
+	return true;
+}
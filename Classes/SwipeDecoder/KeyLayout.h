@@ -0,0 +1,90 @@
+#ifndef _KeyLayout_h
+#define _KeyLayout_h
+
+#include "TCommon.h"
+#include <stdint.h>
+#include <vector>
+
+struct SwipeKey {
+	int key;        //< the character, same as SwipePoint::key (or any id < 256 for hit-testing)
+	float x, y;     //< bottom-left corner, in the same coordinates as SwipePoint::pPoint
+	float w, h;
+
+	float centreX() const { return x + w*0.5f; }
+	float centreY() const { return y + h*0.5f; }
+	bool contains(float px, float py) const { return px >= x && px < x+w && py >= y && py < y+h; }
+};
+
+/**
+ The geometry of the keys the user is swiping over. The keyboard fills this in from its buttons
+ (see -[PaintingView setKeyLayoutFromButtons:]); headless code can use setQwerty().
+
+ Keys are looked up by character through a 256 entry table, so only 8-bit keys are supported.
+
+ Points are looked up through a grid index, so keyAt() and nearestKey() take constant time whatever
+ the number of keys. It's built (along with the key width) by build(), once all of the keys are
+ added - until then the lookups find nothing. The layout doesn't care which way y goes, as long as
+ the keys and the points agree.
+
+	KeyLayout layout;
+	for (auto& b: buttons)
+		layout.addKey(b.key, b.x, b.y, b.w, b.h);
+	layout.build();
+ */
+class KeyLayout {
+	std::vector<SwipeKey> keys;
+	int16_t indexOf[256];
+	float keyWidth = 0;
+	// uniform grid over the keys' bounding box - each cell lists every key that could contain or be
+	// the nearest to a point in it (usually 1-4), in cellKeys[cellStart[c] .. cellStart[c+1])
+	float gridX = 0, gridY = 0;
+	float cellW = 1, cellH = 1;
+	int gridCols = 0, gridRows = 0;
+	std::vector<uint32_t> cellStart;
+	std::vector<int16_t> cellKeys;
+
+public:
+	KeyLayout() { clear(); }
+
+	void clear();
+	void addKey(int key, float x, float y, float w, float h);
+	/// works out the key width and the grid index - after the last addKey(), before looking anything up
+	void build();
+
+	/**
+	 A plain QWERTY layout (3 rows of letters, iPhone proportions) filling width x height, with
+	 y going up from the bottom the same way PaintingView flips its touches.
+	 */
+	void setQwerty(float width, float height);
+
+	bool empty() const { return keys.empty(); }
+	int size() const { return (int)keys.size(); }
+	const SwipeKey& operator[](int i) const { return keys[i]; }
+
+	/// nullptr if the key isn't on this layout
+	const SwipeKey* findKey(int key) const {
+		return (key >= 0 && key < 256 && indexOf[key] >= 0) ? &keys[indexOf[key]] : nullptr;
+	}
+
+	/// the key containing the point, or nullptr if it's between/outside the keys
+	const SwipeKey* keyAt(float px, float py) const;
+
+	/**
+	 The key closest to the point, with the distance to its edge in 'distance' (0 if the point is on
+	 it). nullptr if the layout is empty. Points outside all the keys' bounding box fall back to
+	 checking every key.
+	 */
+	const SwipeKey* nearestKey(float px, float py, float* distance = nullptr) const;
+
+	/// the average key width (as of build()) - distances are usually measured in these
+	float getKeyWidth() const { return keyWidth; }
+
+	bool operator==(const KeyLayout& other) const;
+	bool operator!=(const KeyLayout& other) const { return !(*this == other); }
+
+private:
+	void buildIndex();
+	const SwipeKey* nearestOf(const int16_t* candidates, int count, float px, float py, float* distance) const;
+};
+
+#endif
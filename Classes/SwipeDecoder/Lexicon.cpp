@@ -0,0 +1,318 @@
+#include "Lexicon.h"
+#include "TFile.h"
+#include "TLogging.h"
+#include <algorithm>
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+#define MAX_LINE 100
+
+Lexicon::Lexicon() {
+	for (int c=0; c<256; c++)
+		letterOf[c] = kMaxLetters;
+	for (int c='a'; c<='z'; c++) {
+		letterOf[c] = c - 'a';
+		letterOf[toupper(c)] = c - 'a';
+	}
+}
+
+/// the compiled format - this header, then the node, edge and prior arrays exactly as they are in memory, then the word hash
+struct LexFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t byteOrder;  //< kLexByteOrder as written - the arrays are in the writer's byte order
+	uint32_t numNodes;
+	uint32_t numEdges;
+	uint32_t numWords;
+	uint32_t rootNode;
+	uint32_t nodesOffset; //< from the start of the file
+	uint32_t edgesOffset;
+	uint32_t priorLevelsOffset;
+	uint32_t priorCodesOffset;
+	uint32_t hashOffset;   //< 8-byte aligned
+	uint32_t hashSize;
+	uint32_t fileSize;
+};
+
+static const char kLexMagic[4] = { 'Q', 'L', 'E', 'X' };
+static const uint32_t kLexVersion = 4;
+static const uint32_t kLexByteOrder = 0x01020304;
+
+static_assert(sizeof(LexNode) == 16 && sizeof(LexEdge) == 8, "the compiled lexicon format depends on these");
+
+void Lexicon::clear() {
+	nodes = nullptr;
+	edges = nullptr;
+	priorCodes = nullptr;
+	priorLevels = nullptr;
+	numNodes = numEdges = numWords = rootNode = 0;
+	builtNodes.clear();
+	builtEdges.clear();
+	builtPriorCodes.clear();
+	priorCodebook.clear();
+	hash.clear();
+	mapped.close();
+}
+
+bool Lexicon::load(const std::string& path) {
+	clear();
+	if (!mapped.open(path))
+		return false;
+	if (mapped.size() >= sizeof(LexFileHeader) && memcmp(mapped.data(), kLexMagic, sizeof(kLexMagic)) == 0) {
+		if (loadCompiled()) {
+			TLogDebug("Mapped %d words, %d nodes from '%s'", wordCount(), nodeCount(), path.c_str());
+			return true;
+		}
+		TLogError("Bad compiled lexicon '%s'", path.c_str());
+		clear();
+		return false;
+	}
+	mapped.close();
+	return loadWordList(path);
+}
+
+/// points the arrays into the mapped file - checks the header, but trusts the contents
+bool Lexicon::loadCompiled() {
+	const uint8_t* base = (const uint8_t*)mapped.data();
+	const LexFileHeader& h = *(const LexFileHeader*)base;
+	if (h.version != kLexVersion || h.byteOrder != kLexByteOrder || h.fileSize != mapped.size())
+		return false;
+	if (h.numNodes == 0 || h.rootNode >= h.numNodes || h.numWords == 0)
+		return false;
+	if ((h.nodesOffset | h.edgesOffset | h.priorLevelsOffset) & 3)
+		return false;
+	if (h.nodesOffset + (uint64_t)h.numNodes*sizeof(LexNode) > h.fileSize ||
+		h.edgesOffset + (uint64_t)h.numEdges*sizeof(LexEdge) > h.fileSize ||
+		h.priorLevelsOffset + (uint64_t)LogProbCodebook::kNumLevels*sizeof(LogProb) > h.fileSize ||
+		h.priorCodesOffset + (uint64_t)h.numWords > h.fileSize ||
+		h.hashOffset + (uint64_t)h.hashSize > h.fileSize)
+		return false;
+	if (!hash.map(base + h.hashOffset, h.hashSize) || hash.size() != (int)h.numWords)
+		return false;
+
+	nodes = (const LexNode*)(base + h.nodesOffset);
+	edges = (const LexEdge*)(base + h.edgesOffset);
+	priorLevels = (const LogProb*)(base + h.priorLevelsOffset);
+	priorCodes = base + h.priorCodesOffset;
+	numNodes = h.numNodes;
+	numEdges = h.numEdges;
+	numWords = h.numWords;
+	rootNode = h.rootNode;
+	return true;
+}
+
+bool Lexicon::save(const std::string& path) const {
+	if (!isLoaded())
+		return false;
+	LexFileHeader h = {};
+	memcpy(h.magic, kLexMagic, sizeof(kLexMagic));
+	h.version = kLexVersion;
+	h.byteOrder = kLexByteOrder;
+	h.numNodes = numNodes;
+	h.numEdges = numEdges;
+	h.numWords = numWords;
+	h.rootNode = rootNode;
+	h.nodesOffset = sizeof(LexFileHeader);
+	h.edgesOffset = h.nodesOffset + numNodes*sizeof(LexNode);
+	h.priorLevelsOffset = h.edgesOffset + numEdges*sizeof(LexEdge);
+	h.priorCodesOffset = h.priorLevelsOffset + LogProbCodebook::kNumLevels*sizeof(LogProb);
+	h.hashOffset = (h.priorCodesOffset + numWords + 7) & ~7u;
+	h.hashSize = (uint32_t)hash.serialisedSize();
+	h.fileSize = h.hashOffset + h.hashSize;
+
+	TFileWriter fw(path);
+	if (!fw.isOpen())
+		return false;
+	size_t written = fw.write(&h, sizeof(h));
+	written += fw.write(nodes, numNodes*sizeof(LexNode));
+	written += fw.write(edges, numEdges*sizeof(LexEdge));
+	written += fw.write(priorLevels, LogProbCodebook::kNumLevels*sizeof(LogProb));
+	written += fw.write(priorCodes, numWords);
+	static const uint8_t zeros[8] = {};
+	written += fw.write(zeros, (int)(h.hashOffset - written));
+	written += hash.write(fw);
+	if (written != h.fileSize) {
+		TLogError("Failed to write lexicon '%s'", path.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool Lexicon::loadWordList(const std::string& path) {
+	TFileReader fr(path);
+	if (!fr.isOpen()) {
+		TLogError("Failed to open lexicon '%s'", path.c_str());
+		return false;
+	}
+
+	vector<pair<string, int64_t> > words;
+	int skipped = 0;
+	char line[MAX_LINE];
+	while (fr.readLine(line, MAX_LINE)) {
+		char* ptr = line;
+		while (isspace(*ptr))
+			++ptr;
+		char* end = ptr;
+		while (*end && !isspace(*end))
+			++end;
+		if (end == ptr)
+			continue;
+
+		string word(ptr, end);
+		bool ok = word.size() <= kMaxWordLen;
+		for (size_t i=0; ok && i<word.size(); i++) {
+			ok = (letterOf[(unsigned char)word[i]] != kMaxLetters);
+			word[i] = tolower(word[i]);
+		}
+		long long cnt = strtoll(end, nullptr, 10);
+		if (!ok || cnt < 1) {
+			skipped++;
+			continue;
+		}
+		words.push_back(make_pair(word, (int64_t)cnt));
+	}
+	if (words.empty()) {
+		TLogError("No words in lexicon '%s'", path.c_str());
+		return false;
+	}
+
+	// ids are positions in the sorted list - merge any duplicates (e.g. different case)
+	sort(words.begin(), words.end());
+	size_t n = 0;
+	for (size_t i=1; i<words.size(); i++) {
+		if (words[i].first == words[n].first)
+			words[n].second += words[i].second;
+		else
+			words[++n] = words[i];
+	}
+	words.resize(n+1);
+
+	double total = 0;
+	for (auto& w: words)
+		total += (double)w.second;
+	vector<LogProb> priors(words.size());
+	vector<uint64_t> keys(words.size());
+	for (size_t i=0; i<words.size(); i++) {
+		priors[i] = toLogProb(log((double)words[i].second / total));
+		keys[i] = WordHash::hashWord(words[i].first.c_str(), (int)words[i].first.size());
+	}
+	priorCodebook.build(priors);
+	builtPriorCodes.resize(words.size());
+	for (size_t i=0; i<words.size(); i++)
+		builtPriorCodes[i] = priorCodebook.encode(priors[i]);
+	priorCodes = &builtPriorCodes[0];
+	priorLevels = priorCodebook.getLevels();
+	if (!hash.build(keys)) {
+		clear();
+		return false;
+	}
+
+	unordered_map<string, uint32_t> unique;
+	rootNode = build(words, 0, words.size(), 0, unique);
+	nodes = &builtNodes[0];
+	edges = builtEdges.empty() ? nullptr : &builtEdges[0];
+	numNodes = (uint32_t)builtNodes.size();
+	numEdges = (uint32_t)builtEdges.size();
+	numWords = (uint32_t)builtPriorCodes.size();
+
+	TLogDebug("Loaded %d words (%d skipped), %d nodes from '%s'", wordCount(), skipped, nodeCount(), path.c_str());
+	return true;
+}
+
+/**
+ Builds the subtree for words [lo, hi), which share their first 'depth' letters, and returns its
+ node. Children come first, so that a node is complete (and its children already shared) by the
+ time it's looked up in 'unique' - if an identical node exists that is returned instead.
+ */
+uint32_t Lexicon::build(const std::vector<std::pair<std::string, int64_t> >& words, size_t lo, size_t hi, size_t depth,
+						std::unordered_map<std::string, uint32_t>& unique) {
+	LexNode n = {};
+	n.wordsBelow = (uint32_t)(hi - lo);
+	n.maxLogPrior = kMinLogProb;
+
+	size_t first = lo;
+	if (words[lo].first.size() == depth) {
+		n.isWord = 1;
+		n.maxLogPrior = logPrior((uint32_t)lo);
+		first++;
+	}
+
+	// one edge per distinct letter at this depth - the words are sorted, so these are runs
+	LexEdge children[kMaxLetters];
+	int numChildren = 0;
+	for (size_t clo=first; clo<hi; ) {
+		size_t chi = clo + 1;
+		while (chi < hi && words[chi].first[depth] == words[clo].first[depth])
+			chi++;
+		n.childMask |= 1u << letterOf[(unsigned char)words[clo].first[depth]];
+
+		LexEdge& e = children[numChildren++];
+		e.child = build(words, clo, chi, depth+1, unique);
+		e.idOffset = (uint32_t)(clo - lo);
+		n.maxLogPrior = TMax(n.maxLogPrior, builtNodes[e.child].maxLogPrior);
+		clo = chi;
+	}
+
+	// everything else about the node (wordsBelow, the id offsets) follows from these
+	string key((const char*)&n.isWord, 1);
+	key.append((const char*)&n.maxLogPrior, sizeof(n.maxLogPrior));
+	key.append((const char*)&n.childMask, sizeof(n.childMask));
+	for (int k=0; k<numChildren; k++)
+		key.append((const char*)&children[k].child, sizeof(children[k].child));
+	auto found = unique.find(key);
+	if (found != unique.end())
+		return found->second;
+
+	n.firstEdge = (uint32_t)builtEdges.size();
+	builtEdges.insert(builtEdges.end(), children, children + numChildren);
+	uint32_t index = (uint32_t)builtNodes.size();
+	builtNodes.push_back(n);
+	unique[key] = index;
+	return index;
+}
+
+std::string Lexicon::word(uint32_t wordId) const {
+	char buf[kMaxWordLen+1];
+	int len = word(wordId, buf);
+	return string(buf, len);
+}
+
+int Lexicon::word(uint32_t wordId, char* out) const {
+	int len = 0;
+	out[0] = 0;
+	if (wordId >= (uint32_t)wordCount())
+		return 0;
+
+	LexCursor at = root();
+	while (!(nodes[at.node].isWord && at.wordId == wordId)) {
+		const LexNode& n = nodes[at.node];
+		uint32_t mask = n.childMask;
+		for (uint32_t e=n.firstEdge; mask; e++, mask &= mask-1) {
+			const LexEdge& edge = edges[e];
+			uint32_t first = at.wordId + edge.idOffset;
+			if (wordId < first + nodes[edge.child].wordsBelow) {
+				out[len++] = (char)('a' + __builtin_ctz(mask));
+				at.node = edge.child;
+				at.wordId = first;
+				break;
+			}
+		}
+	}
+	out[len] = 0;
+	return len;
+}
+
+int Lexicon::find(const std::string& word) const {
+	if (!isLoaded())
+		return -1;
+	LexCursor at = root();
+	for (size_t i=0; i<word.size(); i++) {
+		if (!child(at, word[i]))
+			return -1;
+	}
+	return nodes[at.node].isWord ? (int)at.wordId : -1;
+}
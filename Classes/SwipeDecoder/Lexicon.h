@@ -0,0 +1,164 @@
+#ifndef _Lexicon_h
+#define _Lexicon_h
+
+#include "TCommon.h"
+#include "LogProb.h"
+#include "TMappedFile.h"
+#include "WordHash.h"
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ Word list with frequency priors (count_big.txt), stored as a minimised trie (a DAWG) in two flat
+ arrays.
+
+ Each node keeps a bitmask of the letters it has children for - the children are stored in letter
+ order starting at firstEdge, so finding the child for a letter is a mask test + popcount rather
+ than a search.
+
+ Words are numbered 0..wordCount()-1 in lexicographic order. The id isn't stored in the nodes;
+ instead every edge carries the number of words that are skipped over by taking it, so a search can
+ accumulate the id as it descends (see LexCursor) and look the prior up in a plain array at the end.
+ The priors are LogProbs, stored as one byte per word through a LogProbCodebook.
+ That keeps the node layout independent of how many parents a node has.
+
+ Every node also knows the best prior in its subtree, which is what the beam search uses to rank
+ partial words against each other. Identical subtrees are stored once - identical meaning the same
+ letters and words below, and the same best prior at every node, so that sharing never changes a
+ ranking (the words' own priors are looked up by id, so they don't have to match).
+
+ Words can also be looked up in constant time through a minimal perfect hash (see WordHash) - for
+ anything that wants to go from a string to the id, e.g. to index a flat per-word table.
+
+ save() writes the arrays (and the hash) out as they are, and load() maps such a file straight back in - no
+ parsing and no heap, and the pages can be dropped by the OS. See Tools/LexiconCompiler.cpp.
+ */
+struct LexNode {
+	uint32_t firstEdge;
+	uint32_t childMask;   //< bit n set if there is a child for letter n (see Lexicon::letterIndex())
+	uint32_t wordsBelow;  //< number of words ending in this subtree, including at this node
+	LogProb maxLogPrior;  //< best word prior in this subtree
+	uint8_t isWord;
+	uint8_t pad;
+};
+
+struct LexEdge {
+	uint32_t child;
+	uint32_t idOffset;    //< added to the word-id when following this edge
+};
+
+/// a position in the trie: the node plus the id of the first word below it
+struct LexCursor {
+	uint32_t node;
+	uint32_t wordId;
+};
+
+class Lexicon {
+public:
+	static const int kMaxWordLen = 24;
+	static const int kMaxLetters = 31;
+	static const uint32_t kNoNode = 0xffffffff;
+
+	Lexicon();
+
+	/**
+	 Loads either a compiled lexicon (see save()), which is mapped rather than read, or a
+	 "word<whitespace>count" file. In the latter words are lowercased, and words with characters
+	 outside of a-z, or longer than kMaxWordLen, are skipped. Returns false if nothing could be loaded.
+	 */
+	bool load(const std::string& path);
+	/// writes the lexicon in the compiled format - returns false if there is nothing to write, or it failed
+	bool save(const std::string& path) const;
+
+	bool isLoaded() const { return numNodes > 0; }
+	bool isMapped() const { return mapped.isOpen(); }
+	int wordCount() const { return (int)numWords; }
+	int nodeCount() const { return (int)numNodes; }
+
+	LexCursor root() const { LexCursor c = { rootNode, 0 }; return c; }
+	const LexNode& node(uint32_t n) const { return nodes[n]; }
+
+	/// dense index of the letter (0..25 for a-z), kMaxLetters for anything the lexicon can't hold
+	inline int letterIndex(unsigned char c) const { return letterOf[c]; }
+
+	/// moves 'at' to its child for 'c', returns false (leaving it alone) if there isn't one
+	inline bool child(LexCursor& at, unsigned char c) const {
+		const LexNode& n = nodes[at.node];
+		uint32_t bit = 1u << letterOf[c];
+		if (!(n.childMask & bit))
+			return false;
+		const LexEdge& e = edges[n.firstEdge + __builtin_popcount(n.childMask & (bit-1))];
+		at.node = e.child;
+		at.wordId += e.idOffset;
+		return true;
+	}
+
+	/// natural log of the relative frequency of the word the cursor is at (which must be a word)
+	inline LogProb logPrior(const LexCursor& at) const { return priorLevels[priorCodes[at.wordId]]; }
+	inline LogProb logPrior(uint32_t wordId) const { return priorLevels[priorCodes[wordId]]; }
+
+	/// reconstructs a word from its id
+	std::string word(uint32_t wordId) const;
+	/// ... into 'out' (kMaxWordLen+1 chars, nul-terminated), returning its length - 0 if there's no such word
+	int word(uint32_t wordId, char* out) const;
+
+	/// returns the id of 'word', or -1 if it isn't in the lexicon
+	int find(const std::string& word) const;
+	/// the same through the word hash, case folded - no trie walk, but 1 in 4 billion unknown words comes back with an id
+	int lookup(const char* word, int len) const { return hash.find(word, len); }
+	const WordHash& getWordHash() const { return hash; }
+
+	/// calls fn(wordId, word, len) for every word, in id order
+	template<typename F>
+	void forEachWord(F fn) const {
+		if (isLoaded()) {
+			char word[kMaxWordLen+1];
+			visit(root(), word, 0, fn);
+		}
+	}
+
+private:
+	uint8_t letterOf[256];
+	// either into the vectors below (built from a word list) or into the mapped file
+	const LexNode* nodes = nullptr;
+	const LexEdge* edges = nullptr;
+	const uint8_t* priorCodes = nullptr;
+	const LogProb* priorLevels = nullptr; //< LogProbCodebook::kNumLevels of them
+	uint32_t numNodes = 0;
+	uint32_t numEdges = 0;
+	uint32_t numWords = 0;
+	uint32_t rootNode = 0;
+	std::vector<LexNode> builtNodes;
+	std::vector<LexEdge> builtEdges;
+	std::vector<uint8_t> builtPriorCodes;
+	LogProbCodebook priorCodebook;
+	WordHash hash;
+	TMappedFile mapped;
+
+	template<typename F>
+	void visit(LexCursor at, char* word, int len, F& fn) const {
+		const LexNode& n = nodes[at.node];
+		if (n.isWord) {
+			word[len] = 0;
+			fn(at.wordId, (const char*)word, len);
+		}
+		uint32_t mask = n.childMask;
+		for (uint32_t e=n.firstEdge; mask; e++, mask &= mask-1) {
+			LexCursor child = { edges[e].child, at.wordId + edges[e].idOffset };
+			word[len] = (char)('a' + __builtin_ctz(mask));
+			visit(child, word, len+1, fn);
+		}
+	}
+
+	void clear();
+	bool loadCompiled();
+	bool loadWordList(const std::string& path);
+	uint32_t build(const std::vector<std::pair<std::string, int64_t> >& words, size_t lo, size_t hi, size_t depth,
+				   std::unordered_map<std::string, uint32_t>& unique);
+
+	DISALLOW_COPY_AND_ASSIGN(Lexicon);
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include "LogProb.h"
+#include <algorithm>
+
+using namespace std;
+
+/// k-means rounds - the levels stop moving well before this
+static const int kCodebookIterations = 32;
+
+void LogProbCodebook::clear() {
+	for (int i=0; i<kNumLevels; i++)
+		levels[i] = kMinLogProb;
+}
+
+bool LogProbCodebook::build(const std::vector<LogProb>& values) {
+	clear();
+	if (values.empty())
+		return false;
+
+	// distinct values with their counts - k-means over those is the same as over all of them
+	vector<LogProb> sorted(values);
+	sort(sorted.begin(), sorted.end());
+	vector<LogProb> distinct;
+	vector<int> counts;
+	for (size_t i=0; i<sorted.size(); i++) {
+		if (i == 0 || sorted[i] != sorted[i-1]) {
+			distinct.push_back(sorted[i]);
+			counts.push_back(0);
+		}
+		counts.back()++;
+	}
+	const int n = (int)distinct.size();
+	if (n <= kNumLevels) {
+		for (int i=0; i<kNumLevels; i++)
+			levels[i] = distinct[TMin(i, n-1)];
+		return true;
+	}
+
+	// start from the quantiles, then Lloyd iterations: each value goes to its nearest level
+	// (levels are sorted, so that's a split between neighbours), each level moves to its mean
+	double centre[kNumLevels];
+	for (int l=0; l<kNumLevels; l++)
+		centre[l] = sorted[(size_t)((l + 0.5) * sorted.size() / kNumLevels)];
+	for (int it=0; it<kCodebookIterations; it++) {
+		double sum[kNumLevels] = {}, weight[kNumLevels] = {};
+		int l = 0;
+		for (int i=0; i<n; i++) {
+			while (l+1 < kNumLevels && fabs(distinct[i] - centre[l+1]) <= fabs(distinct[i] - centre[l]))
+				l++;
+			sum[l] += (double)distinct[i] * counts[i];
+			weight[l] += counts[i];
+		}
+		for (int k=0; k<kNumLevels; k++) {
+			if (weight[k] > 0)
+				centre[k] = sum[k] / weight[k];
+		}
+		sort(centre, centre + kNumLevels);
+	}
+	for (int l=0; l<kNumLevels; l++)
+		levels[l] = (LogProb)floor(centre[l] + 0.5);
+	return true;
+}
+
+uint8_t LogProbCodebook::encode(LogProb lp) const {
+	const LogProb* upper = lower_bound(levels, levels + kNumLevels, lp);
+	if (upper == levels)
+		return 0;
+	if (upper == levels + kNumLevels)
+		return kNumLevels - 1;
+	return (uint8_t)((lp - upper[-1] <= *upper - lp) ? (upper - 1 - levels) : (upper - levels));
+}
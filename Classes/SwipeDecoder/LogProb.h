@@ -0,0 +1,52 @@
+#ifndef _LogProb_h
+#define _LogProb_h
+
+#include "TCommon.h"
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ Natural-log probabilities in fixed point, kLogProbScale units per nat. The tables store them as
+ int16 (anything below -128 nats saturates), and the beam search adds them up in an int32 - no
+ floats, and nothing to underflow however long the word.
+ */
+typedef int16_t LogProb;
+
+static const int kLogProbScale = 256;
+static const LogProb kMinLogProb = -32768;
+
+inline LogProb toLogProb(double logProb) {
+	double v = floor(logProb * kLogProbScale + 0.5);
+	return (LogProb)TRange(v, (double)kMinLogProb, 32767.0);
+}
+
+/// a cost or weight (in nats) on the same scale, for adding to LogProb sums
+inline int32_t toLogScore(float nats) { return (int32_t)lroundf(nats * kLogProbScale); }
+inline float logScoreToFloat(int32_t score) { return score / (float)kLogProbScale; }
+
+/**
+ 256 LogProb levels, for tables where 8 bits an entry is enough - e.g. word priors, where most of
+ the words share a handful of low counts anyway. The levels are placed by 1-D k-means over the
+ values, so the common ones come out (nearly) exact.
+ */
+class LogProbCodebook {
+public:
+	static const int kNumLevels = 256;
+
+	LogProbCodebook() { clear(); }
+	void clear();
+
+	/// picks the levels for 'values' - returns false if there are none
+	bool build(const std::vector<LogProb>& values);
+
+	/// the code of the level nearest to 'lp'
+	uint8_t encode(LogProb lp) const;
+	LogProb operator[](uint8_t code) const { return levels[code]; }
+	const LogProb* getLevels() const { return levels; }
+
+private:
+	LogProb levels[kNumLevels]; //< ascending
+};
+
+#endif
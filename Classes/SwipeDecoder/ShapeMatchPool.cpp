@@ -0,0 +1,90 @@
+#include "ShapeMatchPool.h"
+#include "TLogging.h"
+#include <algorithm>
+
+using namespace std;
+
+void ShapeMatchPool::setNumThreads(int numThreads) {
+	numThreads = TMax(numThreads, 1);
+	if (numThreads == getNumThreads())
+		return;
+
+	for (auto worker: workers) {
+		worker->thread.signalAndWaitForStop();
+		delete worker;
+	}
+	workers.clear();
+
+	for (int i=1; i<numThreads; i++) {
+		Worker* worker = new Worker(templates, lexicon);
+		worker->shard = i;
+		workers.push_back(worker);
+		worker->thread.go([this, worker](std::function<bool()> needToStop) {
+			run(worker, needToStop);
+		}, TThreadI::kNormalPriority, false);
+	}
+	TLogDebug("Shape match pool: %d threads", numThreads);
+}
+
+/// a worker's loop: wait for the next job, do its shard of it, tell the caller if it was the last
+void ShapeMatchPool::run(Worker* worker, std::function<bool()> needToStop) {
+	int seen = 0;
+	for (;;) {
+		{
+			LockNR l(worker->thread.conditionMutex);
+			worker->thread.condition.wait(l, [&]() { return needToStop() || worker->generation != seen; });
+			if (needToStop())
+				return;
+			seen = worker->generation;
+		}
+
+		worker->matches.clear();
+		worker->matcher.copyTrace(*source);
+		worker->matcher.match(worker->matches, deadline, worker->shard, numShards);
+		worker->converged = worker->matcher.hasConverged();
+
+		if (--pending == 0) {
+			LockNR l(doneMutex);
+			doneCondition.notifyOne();
+		}
+	}
+}
+
+int ShapeMatchPool::match(ShapeMatcher& matcher, std::vector<ShapeMatch>& out, const CountdownTimer* deadline) {
+	if (workers.empty() || matcher.getNumCandidates() < matcher.getConfig().minParallelCandidates) {
+		int n = matcher.match(out, deadline);
+		converged = matcher.hasConverged();
+		return n;
+	}
+
+	source = &matcher;
+	this->deadline = deadline;
+	numShards = getNumThreads();
+	pending += (int32_t)workers.size();
+	for (auto worker: workers) {
+		LockNR l(worker->thread.conditionMutex);
+		worker->generation++;
+		worker->thread.condition.notifyOne();
+	}
+
+	const size_t start = out.size();
+	matcher.match(out, deadline, 0, numShards);
+	converged = matcher.hasConverged();
+
+	{
+		LockNR l(doneMutex);
+		doneCondition.wait(l, [this]() { return pending.Value() == 0; });
+	}
+
+	// every shard's list is its own best; together they hold the overall best, once each
+	for (auto worker: workers) {
+		out.insert(out.end(), worker->matches.begin(), worker->matches.end());
+		converged = converged && worker->converged;
+	}
+	const size_t maxCount = TMin(out.size() - start, (size_t)matcher.getConfig().maxCandidates);
+	partial_sort(out.begin() + start, out.begin() + start + maxCount, out.end(), [](const ShapeMatch& a, const ShapeMatch& b) {
+		return a.score > b.score;
+	});
+	out.resize(start + maxCount);
+	return (int)maxCount;
+}
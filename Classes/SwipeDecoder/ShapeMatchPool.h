@@ -0,0 +1,74 @@
+#ifndef _ShapeMatchPool_h
+#define _ShapeMatchPool_h
+
+#include "TCommon.h"
+#include "GestureTemplates.h"
+#include "TAtomic.h"
+#include "TCondition.h"
+#include "TThreadI.h"
+#include "TTimer.h"
+#include <vector>
+
+/**
+ Runs ShapeMatcher::match() over several threads: the candidate blocks are dealt out round-robin to
+ the calling thread plus a few TThreadI workers, each with its own matcher (and so its own top-K
+ heap). When all of them are done the caller merges their sorted lists - by then nobody else is
+ touching them, so the merge needs no locks.
+
+ Waking the workers costs more than scoring a small candidate set, so below
+ ShapeMatchConfig::minParallelCandidates (see ShapeMatcher::getNumCandidates()) it just calls the
+ matcher directly.
+
+	pool.setNumThreads(2);
+	matcher.setTrace(trace);
+	pool.match(matcher, out, deadline);
+ */
+class ShapeMatchPool {
+	struct Worker {
+		ShapeMatcher matcher;
+		std::vector<ShapeMatch> matches;
+		int shard = 0;
+		int generation = 0; //< bumped (under thread.conditionMutex) to hand it the next job
+		bool converged = true;
+		TThreadI thread{"ShapeMatch"};
+
+		Worker(const GestureTemplates& t, const Lexicon& l) : matcher(t, l) {}
+	};
+
+	const GestureTemplates& templates;
+	const Lexicon& lexicon;
+	std::vector<Worker*> workers;
+
+	// the job in progress - only written while the workers are idle
+	const ShapeMatcher* source = nullptr;
+	const CountdownTimer* deadline = nullptr;
+	int numShards = 1;
+	AtomicInt pending;
+	TCondition doneCondition;
+	MutexNR doneMutex;
+
+	bool converged = true;
+
+public:
+	ShapeMatchPool(const GestureTemplates& t, const Lexicon& l) : templates(t), lexicon(l) {}
+	~ShapeMatchPool() { setNumThreads(1); }
+
+	/// the total including the caller's - 1 (the default) is single threaded
+	void setNumThreads(int numThreads);
+	int getNumThreads() const { return (int)workers.size() + 1; }
+
+	/**
+	 Same as matcher.match(out, deadline), but spread over the threads - 'matcher' has to have its
+	 trace set, and does the calling thread's share.
+	 */
+	int match(ShapeMatcher& matcher, std::vector<ShapeMatch>& out, const CountdownTimer* deadline = nullptr);
+	/// whether every shard of the last match() got through all of its candidates
+	bool hasConverged() const { return converged; }
+
+private:
+	void run(Worker* worker, std::function<bool()> needToStop);
+
+	DISALLOW_COPY_AND_ASSIGN(ShapeMatchPool);
+};
+
+#endif
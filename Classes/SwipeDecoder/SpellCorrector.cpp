@@ -0,0 +1,237 @@
+#include "SpellCorrector.h"
+#include "TFile.h"
+#include "TLogging.h"
+#include "WordHash.h"
+#include <algorithm>
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+#define MAX_LINE 100
+
+/// the longest string correct() looks at - nothing longer can be within reach of a word
+static const int kMaxTyped = Lexicon::kMaxWordLen + 8;
+/// the longest side of an edit in count_1edit.txt that's kept
+static const int kMaxEditLen = 4;
+
+bool SpellCorrector::loadEdits(const std::string& path) {
+	editKeys.clear();
+	editLogProbs.clear();
+	TFileReader fr(path);
+	if (!fr.isOpen()) {
+		TLogError("Failed to load edit counts from '%s'", path.c_str());
+		return false;
+	}
+
+	vector<pair<uint64_t, double> > counts;
+	double total = 0;
+	char line[MAX_LINE];
+	while (fr.readLine(line, MAX_LINE)) {
+		// "correct|typed<tab>count" - either side may contain spaces, so only the tab separates
+		char* bar = strchr(line, '|');
+		char* tab = bar ? strchr(bar, '\t') : nullptr;
+		if (!tab || bar - line > kMaxEditLen || tab - bar - 1 > kMaxEditLen)
+			continue;
+		double count = atof(tab + 1);
+		if (count <= 0)
+			continue;
+		counts.push_back(make_pair(hashEdit(line, (int)(bar - line), bar + 1, (int)(tab - bar - 1)), count));
+		total += count;
+	}
+	if (counts.empty()) {
+		TLogError("No edit counts in '%s'", path.c_str());
+		return false;
+	}
+
+	sort(counts.begin(), counts.end());
+	vector<double> merged;
+	for (auto& c: counts) {
+		// the same edit twice (it shouldn't be) adds up
+		if (!editKeys.empty() && editKeys.back() == c.first) {
+			merged.back() += c.second;
+			continue;
+		}
+		editKeys.push_back(c.first);
+		merged.push_back(c.second);
+	}
+	for (double count: merged)
+		editLogProbs.push_back(toLogProb(log(config.errorRate * count / total)));
+	unseenEdit = toLogProb(log(config.errorRate * 0.5 / total));
+	noEdit = toLogProb(log(1.0 - config.errorRate));
+	TLogDebug("Loaded %d edits (%.0f errors) from '%s'", (int)editKeys.size(), total, path.c_str());
+	return true;
+}
+
+uint64_t SpellCorrector::hashEdit(const char* correct, int correctLen, const char* typed, int typedLen) {
+	char edit[2*kMaxEditLen + 1];
+	correctLen = TMin(correctLen, kMaxEditLen);
+	typedLen = TMin(typedLen, kMaxEditLen);
+	memcpy(edit, correct, correctLen);
+	edit[correctLen] = '|';
+	memcpy(edit + correctLen + 1, typed, typedLen);
+	return WordHash::hashWord(edit, correctLen + 1 + typedLen);
+}
+
+LogProb SpellCorrector::editLogProb(const char* correct, int correctLen, const char* typed, int typedLen) const {
+	if (editKeys.empty())
+		return toLogProb(log(config.errorRate)); // no edit model - every edit is as likely
+	const uint64_t key = hashEdit(correct, correctLen, typed, typedLen);
+	auto it = lower_bound(editKeys.begin(), editKeys.end(), key);
+	if (it == editKeys.end() || *it != key)
+		return unseenEdit;
+	return editLogProbs[it - editKeys.begin()];
+}
+
+#pragma mark - deletion index
+
+/// every string 'len' long 'word' turns into with up to 'maxDeletes' deletions at or after 'from'
+static void addDeletes(char* word, int len, int from, int maxDeletes, std::vector<uint32_t>& out) {
+	out.push_back((uint32_t)(WordHash::hashWord(word, len) >> 32));
+	if (maxDeletes == 0 || len == 0)
+		return;
+	char shorter[kMaxTyped];
+	for (int p=from; p<len; p++) {
+		memcpy(shorter, word, p);
+		memcpy(shorter + p, word + p + 1, len - p - 1);
+		addDeletes(shorter, len-1, p, maxDeletes-1, out);
+	}
+}
+
+void SpellCorrector::deletionHashes(const char* word, int len, std::vector<uint32_t>& out) const {
+	char prefix[kMaxTyped];
+	const int n = TMin(len, TMin(config.prefixLength, kMaxTyped));
+	for (int i=0; i<n; i++)
+		prefix[i] = (char)tolower((unsigned char)word[i]);
+	const size_t start = out.size();
+	addDeletes(prefix, n, 0, config.maxDistance, out);
+	// repeated letters give the same string more than once
+	sort(out.begin() + start, out.end());
+	out.erase(unique(out.begin() + start, out.end()), out.end());
+}
+
+bool SpellCorrector::build() {
+	deletes.clear();
+	if (!lexicon.isLoaded())
+		return false;
+	lexicon.forEachWord([this](uint32_t wordId, const char* word, int len) {
+		hashes.clear();
+		deletionHashes(word, len, hashes);
+		for (uint32_t h: hashes)
+			deletes.push_back((uint64_t)h << 32 | wordId);
+	});
+	sort(deletes.begin(), deletes.end());
+	TLogDebug("Deletion index: %d entries for %d words (%d KB)", (int)deletes.size(), lexicon.wordCount(),
+			  (int)(deletes.size() * sizeof(uint64_t) / 1024));
+	return true;
+}
+
+#pragma mark - correction
+
+int SpellCorrector::correct(const char* typed, int len, SpellCandidate* out, int maxCount) {
+	if (deletes.empty() || len <= 0 || len > Lexicon::kMaxWordLen + config.maxDistance || maxCount <= 0)
+		return 0;
+	char lower[kMaxTyped];
+	for (int i=0; i<len; i++)
+		lower[i] = (char)tolower((unsigned char)typed[i]);
+
+	hashes.clear();
+	deletionHashes(lower, len, hashes);
+	candidates.clear();
+	for (uint32_t h: hashes) {
+		auto it = lower_bound(deletes.begin(), deletes.end(), (uint64_t)h << 32);
+		for (; it != deletes.end() && (uint32_t)(*it >> 32) == h; ++it)
+			candidates.push_back((uint32_t)*it);
+	}
+	sort(candidates.begin(), candidates.end());
+	candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+	// the index only says they might be close - the full strings decide, best kept in 'out'
+	int count = 0;
+	char word[Lexicon::kMaxWordLen + 1];
+	for (uint32_t wordId: candidates) {
+		const int wordLen = lexicon.word(wordId, word);
+		if (abs(wordLen - len) > config.maxDistance)
+			continue;
+		int distance;
+		const int32_t channel = channelLogProb(word, wordLen, lower, len, &distance);
+		if (distance > config.maxDistance)
+			continue;
+		const int32_t prior = lexicon.logPrior(wordId);
+		const float score = logScoreToFloat(channel + prior);
+		if (count == maxCount && score <= out[count-1].score)
+			continue;
+		int at = TMin(count, maxCount-1);
+		for (; at > 0 && out[at-1].score < score; at--)
+			out[at] = out[at-1];
+		out[at].wordId = (int)wordId;
+		out[at].distance = distance;
+		out[at].score = score;
+		out[at].channel = logScoreToFloat(channel);
+		out[at].prior = logScoreToFloat(prior);
+		count = TMin(count+1, maxCount);
+	}
+	return count;
+}
+
+int32_t SpellCorrector::channelLogProb(const char* word, int wordLen, const char* typed, int typedLen, int* distance) const {
+	if (distance)
+		*distance = config.maxDistance + 1;
+	if (wordLen >= kMaxTyped || typedLen >= kMaxTyped || abs(wordLen - typedLen) > config.maxDistance)
+		return kMinLogProb;
+
+	// optimal string alignment distance - Levenshtein plus swapping two neighbours
+	uint8_t d[kMaxTyped][kMaxTyped];
+	for (int i=0; i<=wordLen; i++)
+		d[i][0] = (uint8_t)i;
+	for (int j=0; j<=typedLen; j++)
+		d[0][j] = (uint8_t)j;
+	for (int i=1; i<=wordLen; i++) {
+		for (int j=1; j<=typedLen; j++) {
+			int best = d[i-1][j-1] + (word[i-1] != typed[j-1]);
+			best = TMin(best, d[i-1][j] + 1);
+			best = TMin(best, d[i][j-1] + 1);
+			if (i > 1 && j > 1 && word[i-1] == typed[j-2] && word[i-2] == typed[j-1])
+				best = TMin(best, d[i-2][j-2] + 1);
+			d[i][j] = (uint8_t)best;
+		}
+	}
+	const int edits = d[wordLen][typedLen];
+	if (distance)
+		*distance = edits;
+	if (edits > config.maxDistance)
+		return kMinLogProb;
+	if (edits == 0)
+		return noEdit;
+
+	// walk one cheapest alignment back, adding up its edits - a deletion or insertion is named by
+	// the letter before it ('<' at the start), as in count_1edit.txt
+	int32_t logProb = 0;
+	int i = wordLen, j = typedLen;
+	while (i > 0 || j > 0) {
+		if (i > 0 && j > 0 && word[i-1] == typed[j-1] && d[i][j] == d[i-1][j-1]) {
+			i--; j--;
+		}
+		else if (i > 1 && j > 1 && word[i-1] == typed[j-2] && word[i-2] == typed[j-1] && d[i][j] == d[i-2][j-2] + 1) {
+			logProb += editLogProb(word + i-2, 2, typed + j-2, 2);
+			i -= 2; j -= 2;
+		}
+		else if (i > 0 && j > 0 && d[i][j] == d[i-1][j-1] + 1) {
+			logProb += editLogProb(word + i-1, 1, typed + j-1, 1);
+			i--; j--;
+		}
+		else if (i > 0 && d[i][j] == d[i-1][j] + 1) {
+			const char before[2] = { (i > 1) ? word[i-2] : '<', word[i-1] };
+			logProb += editLogProb(before, 2, before, 1);
+			i--;
+		}
+		else {
+			const char before[2] = { (j > 1) ? typed[j-2] : '<', typed[j-1] };
+			logProb += editLogProb(before, 1, before, 2);
+			j--;
+		}
+	}
+	return logProb;
+}
@@ -0,0 +1,96 @@
+#ifndef _SpellCorrector_h
+#define _SpellCorrector_h
+
+#include "TCommon.h"
+#include "Lexicon.h"
+#include "LogProb.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// a lexicon word that a misspelling could have been meant as: score = channel + prior
+struct SpellCandidate {
+	int wordId;
+	int distance;    //< edits between the word and what was typed
+	float score;
+	float channel;   //< log P(typed | word), from the edit model
+	float prior;     //< log P(word), from the lexicon
+};
+
+struct SpellConfig {
+	int maxDistance = 2;     //< edits (insert, delete, substitute, swap neighbours) a word may be away
+	int prefixLength = 7;    //< only this much of a word goes in the deletion index - the rest is checked per candidate
+	float errorRate = 0.05f; //< chance of any one edit being made, on top of its share of count_1edit.txt
+};
+
+/**
+ Noisy-channel spelling correction: the words within a couple of edits of what was typed, each
+ scored by log P(word) + log P(typed | word).
+
+ Candidates come from a SymSpell-style deletion index - every string that some deletions turn a
+ lexicon word into, each pointing back at its words. Deleting from the typed string as well, two
+ strings are within the edit distance exactly when they share one of those, so a lookup is a few
+ dozen binary searches instead of an edit distance against every word. The index is a sorted array
+ of (32-bit hash of the deleted string, word id) pairs; hash collisions only cost a check.
+
+ P(typed | word) is from the single-edit counts in count_1edit.txt ("e|i 917" = 'e' was typed as
+ 'i'; deletions and insertions carry the letter before them, "ea|e", "t|te"), as in Norvig's
+ "Natural Language Corpus Data": each edit is errorRate * count / total, unseen edits get a count
+ of 0.5, and a word typed right gets 1 - errorRate.
+
+	SpellCorrector corrector(lexicon);
+	corrector.loadEdits(TUtils::pathForResource("count_1edit.txt"));
+	corrector.build();
+	SpellCandidate candidates[5];
+	int n = corrector.correct("helo", 4, candidates, 5);
+ */
+class SpellCorrector {
+	const Lexicon& lexicon;
+	SpellConfig config;
+	// the edit model, sorted by key - hashEdit() of "correct|typed"
+	std::vector<uint64_t> editKeys;
+	std::vector<LogProb> editLogProbs;
+	LogProb unseenEdit = kMinLogProb;
+	LogProb noEdit = 0;
+	/// (hash of a deleted string << 32 | word id), sorted
+	std::vector<uint64_t> deletes;
+	// scratch space for correct()
+	std::vector<uint32_t> hashes;
+	std::vector<uint32_t> candidates;
+
+public:
+	SpellCorrector(const Lexicon& lex) : lexicon(lex) {}
+
+	SpellConfig& getConfig() { return config; }
+
+	/// reads the edit counts - returns false if the file couldn't be read
+	bool loadEdits(const std::string& path);
+	bool hasEdits() const { return !editKeys.empty(); }
+
+	/// (re)builds the deletion index from the lexicon - returns false if there's no lexicon
+	bool build();
+	void clear() { deletes.clear(); }
+	bool empty() const { return deletes.empty(); }
+	/// entries in the deletion index
+	int indexSize() const { return (int)deletes.size(); }
+
+	/**
+	 The best (up to) 'maxCount' words for 'typed', best first, into 'out'. Returns the number
+	 found - 0 if nothing is within maxDistance edits.
+	 */
+	int correct(const char* typed, int len, SpellCandidate* out, int maxCount);
+
+	/// log P(typed | word) under the edit model, over the cheapest alignment of the two - or
+	/// kMinLogProb if they're more than maxDistance edits apart. 'distance' gets the number of edits.
+	int32_t channelLogProb(const char* word, int wordLen, const char* typed, int typedLen, int* distance = nullptr) const;
+
+private:
+	static uint64_t hashEdit(const char* correct, int correctLen, const char* typed, int typedLen);
+	LogProb editLogProb(const char* correct, int correctLen, const char* typed, int typedLen) const;
+	/// hashes of 'word' (up to prefixLength of it) with up to maxDistance letters deleted, appended to 'out'
+	void deletionHashes(const char* word, int len, std::vector<uint32_t>& out) const;
+
+	DISALLOW_COPY_AND_ASSIGN(SpellCorrector);
+};
+
+#endif
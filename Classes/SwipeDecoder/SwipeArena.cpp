@@ -0,0 +1,43 @@
+#include "SwipeArena.h"
+#include "TLogging.h"
+#include <stdlib.h>
+
+using namespace std;
+
+void SwipeArena::grow(size_t size) {
+	// at least double what there is, so that a big gesture takes a few blocks, not one per allocation
+	const size_t blockSize = TMax(TMax(size, kMinBlockSize), capacity);
+	char* block = (char*)malloc(blockSize);
+	numMallocs++;
+	if (!block) {
+		TLogError("SwipeArena: out of memory (%d bytes)", (int)blockSize);
+		abort();
+	}
+	blocks.push_back(block);
+	capacity += blockSize;
+	top = block;
+	end = block + blockSize;
+}
+
+void SwipeArena::reset() {
+	peak = TMax(peak, used);
+	used = 0;
+	if (blocks.size() > 1) {
+		// one block big enough for all of the last gesture
+		const size_t size = capacity;
+		release();
+		grow(size);
+	}
+	else if (!blocks.empty()) {
+		top = blocks.back();
+	}
+}
+
+void SwipeArena::release() {
+	for (char* block: blocks)
+		free(block);
+	blocks.clear();
+	top = end = nullptr;
+	used = 0;
+	capacity = 0;
+}
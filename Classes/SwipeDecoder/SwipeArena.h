@@ -0,0 +1,115 @@
+#ifndef _SwipeArena_h
+#define _SwipeArena_h
+
+#include "TCommon.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ A monotonic arena for the decoder's per-gesture scratch space: allocate() just bumps a pointer,
+ nothing is freed on its own, and reset() takes back everything at once when the next gesture
+ begins.
+
+ The memory is kept between gestures. A gesture that needs more than there is gets another block
+ (from malloc), and the next reset() replaces them all with a single block of their combined size -
+ so once the decoder has seen its biggest gesture, decoding never calls malloc again.
+ getNumMallocs() counts the calls, to prove it.
+
+	SwipeArena arena;
+	SwipeArenaVector<Hypothesis> beam{SwipeArenaAllocator<Hypothesis>(&arena)};
+	...
+	arena.reset();   // beam's storage is gone - it has to be emptied first
+
+ Not thread-safe: an arena per decoder.
+ */
+class SwipeArena {
+public:
+	/// the first block, and the least a new one gets
+	static const size_t kMinBlockSize = 64 * 1024;
+	/// every allocation is aligned to this
+	static const size_t kAlignment = 16;
+
+	SwipeArena() {}
+	~SwipeArena() { release(); }
+
+	/// 'size' bytes, aligned to kAlignment - never null (aborts if malloc fails)
+	inline void* allocate(size_t size) {
+		size = (size + kAlignment-1) & ~(kAlignment-1);
+		if (size > (size_t)(end - top))
+			grow(size);
+		void* p = top;
+		top += size;
+		used += size;
+		return p;
+	}
+
+	/// takes back everything allocated since the last reset() - coalescing the blocks if there was more than one
+	void reset();
+	/// frees the blocks too
+	void release();
+
+	/// calls to malloc since it was made - stays put once the decoder is warmed up
+	int64_t getNumMallocs() const { return numMallocs; }
+	/// bytes allocated since the last reset()
+	size_t getUsed() const { return used; }
+	/// the most allocated between two reset()s
+	size_t getPeak() const { return TMax(peak, used); }
+	/// bytes held in blocks
+	size_t getCapacity() const { return capacity; }
+
+private:
+	std::vector<char*> blocks;  //< the current one last
+	char* top = nullptr;        //< the next free byte in the current block
+	char* end = nullptr;
+	size_t used = 0;
+	size_t peak = 0;
+	size_t capacity = 0;
+	int64_t numMallocs = 0;
+
+	void grow(size_t size);
+
+	DISALLOW_COPY_AND_ASSIGN(SwipeArena);
+};
+
+/**
+ An STL allocator on a SwipeArena: deallocate() does nothing, the memory comes back with the
+ arena's reset(). A container using it has to be emptied (swapped with an empty one) before then.
+ */
+template <class T>
+class SwipeArenaAllocator {
+public:
+	typedef T value_type;
+
+	explicit SwipeArenaAllocator(SwipeArena* arena) : arena(arena) {}
+	template <class U>
+	SwipeArenaAllocator(const SwipeArenaAllocator<U>& o) : arena(o.arena) {}
+
+	inline T* allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T))); }
+	inline void deallocate(T*, size_t) {}
+
+	template <class U>
+	bool operator==(const SwipeArenaAllocator<U>& o) const { return arena == o.arena; }
+	template <class U>
+	bool operator!=(const SwipeArenaAllocator<U>& o) const { return arena != o.arena; }
+
+private:
+	template <class U> friend class SwipeArenaAllocator;
+	SwipeArena* arena;
+};
+
+template <class T>
+using SwipeArenaVector = std::vector<T, SwipeArenaAllocator<T>>;
+
+/**
+ Empties 'v' for the next gesture - call before the arena's reset() - and returns the capacity it
+ had, to reserve() again after.
+ */
+template <class T>
+inline size_t recycleArenaVector(SwipeArenaVector<T>& v) {
+	const size_t capacity = v.capacity();
+	SwipeArenaVector<T>(v.get_allocator()).swap(v);
+	return capacity;
+}
+
+#endif
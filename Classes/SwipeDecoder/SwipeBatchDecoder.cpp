@@ -0,0 +1,133 @@
+#include "SwipeBatchDecoder.h"
+#include "TLogging.h"
+#include <thread>
+
+using namespace std;
+
+bool SwipeBatchDecoder::start(int numThreads, Setup setup) {
+	stop();
+	if (numThreads <= 0)
+		numThreads = TMax((int)std::thread::hardware_concurrency(), 1);
+
+	pending += numThreads;
+	for (int i=0; i<numThreads; i++) {
+		Worker* worker = new Worker();
+		workers.push_back(worker);
+		worker->thread.go([this, worker, setup](std::function<bool()> needToStop) {
+			run(worker, setup, needToStop);
+		}, TThreadI::kNormalPriority, false);
+	}
+	waitForWorkers();
+
+	for (auto worker: workers) {
+		if (!worker->ready) {
+			TLogError("Batch decoder: a worker's setup failed");
+			stop();
+			return false;
+		}
+	}
+	TLogDebug("Batch decoder: %d threads", numThreads);
+	return true;
+}
+
+void SwipeBatchDecoder::stop() {
+	for (auto worker: workers) {
+		worker->thread.signalAndWaitForStop();
+		delete worker;
+	}
+	workers.clear();
+}
+
+void SwipeBatchDecoder::workerDone() {
+	if (--pending == 0) {
+		LockNR l(doneMutex);
+		doneCondition.notifyOne();
+	}
+}
+
+void SwipeBatchDecoder::waitForWorkers() {
+	LockNR l(doneMutex);
+	doneCondition.wait(l, [this]() { return pending.Value() == 0; });
+}
+
+/// a worker's loop: set up its decoder, then per job take chunks until there are none left
+void SwipeBatchDecoder::run(Worker* worker, Setup setup, std::function<bool()> needToStop) {
+	worker->ready = setup(worker->decoder);
+	worker->decoder.setResultCacheSize(resultCacheSize);
+	workerDone();
+
+	int seen = 0;
+	for (;;) {
+		{
+			LockNR l(worker->thread.conditionMutex);
+			worker->thread.condition.wait(l, [&]() { return needToStop() || worker->generation != seen; });
+			if (needToStop())
+				return;
+			seen = worker->generation;
+		}
+
+		worker->gestures.clear();
+		worker->results.clear();
+		for (;;) {
+			const int first = (++nextChunk - 1) * kChunkSize;
+			if (first >= numGestures)
+				break;
+			for (int i=first; i<TMin(first + kChunkSize, numGestures); i++)
+				decodeGesture(worker, i);
+		}
+		workerDone();
+	}
+}
+
+void SwipeBatchDecoder::decodeGesture(Worker* worker, int i) {
+	worker->gestures.push_back(i);
+	worker->results.push_back(SwipeBatchResult());
+	SwipeBatchResult& result = worker->results.back();
+	SwipeTrace& trace = worker->trace;
+	if (!corpus->read(i, trace) || trace.points.empty())
+		return;
+
+	SwipeDecoder& decoder = worker->decoder;
+	if (useKeyLayouts && trace.layout)
+		decoder.setKeyLayout(*trace.layout);
+	SwipeResults results(result.results, SwipeBatchResult::kMaxResults);
+	TDateTime start = TDateTime::now();
+	decoder.begin();
+	for (auto& point: trace.points)
+		decoder.addPoint(point);
+	result.count = decoder.finish(results);
+	timeval tv = (TDateTime::now() - start).asTV();
+	result.decodeUs = (int64_t)tv.tv_sec*1000000 + tv.tv_usec;
+	result.numPoints = (int)trace.points.size();
+	result.converged = results.converged;
+}
+
+int SwipeBatchDecoder::decode(const SwipeTraceReader& corpus, std::vector<SwipeBatchResult>& out) {
+	out.clear();
+	if (workers.empty()) {
+		TLogError("Batch decoder: not started");
+		return 0;
+	}
+	this->corpus = &corpus;
+	numGestures = corpus.gestureCount();
+	nextChunk -= nextChunk.Value();
+	pending += (int32_t)workers.size();
+	for (auto worker: workers) {
+		LockNR l(worker->thread.conditionMutex);
+		worker->generation++;
+		worker->thread.condition.notifyOne();
+	}
+	waitForWorkers();
+
+	// every gesture was done by exactly one worker - put them back in corpus order
+	out.resize(numGestures);
+	int decoded = 0;
+	for (auto worker: workers) {
+		for (size_t r=0; r<worker->gestures.size(); r++) {
+			out[worker->gestures[r]] = worker->results[r];
+			decoded += (worker->results[r].count > 0);
+		}
+	}
+	this->corpus = nullptr;
+	return decoded;
+}
@@ -0,0 +1,109 @@
+#ifndef _SwipeBatchDecoder_h
+#define _SwipeBatchDecoder_h
+
+#include "TCommon.h"
+#include "SwipeDecoder.h"
+#include "SwipeTrace.h"
+#include "TAtomic.h"
+#include "TCondition.h"
+#include "TThreadI.h"
+#include <functional>
+#include <vector>
+
+/// one gesture of a corpus, decoded
+struct SwipeBatchResult {
+	static const int kMaxResults = 5;
+	SwipeResult results[kMaxResults]; //< best first
+	int count = 0;        //< of results - 0 if nothing was decoded (or the gesture was bad)
+	int numPoints = 0;
+	int64_t decodeUs = 0; //< begin() to the end of finish()
+	bool converged = true;
+};
+
+/**
+ Decodes a whole trace corpus (see SwipeTrace.h) in parallel, for offline evaluation and tuning:
+ a TThreadI worker per core, each with a SwipeDecoder of its own, all reading gestures straight
+ from the one mapped corpus (SwipeTraceReader::read()). The gestures are dealt out in chunks from a
+ shared counter, so a worker that gets the long ones just takes fewer chunks; each worker keeps its
+ results in its own buffer, and they are only put together, in corpus order, once all of the
+ workers are done - so nothing is shared while decoding but the counter. The decoders' result
+ caches are off unless setResultCacheSize() says otherwise, so that the results don't depend on
+ which worker got which gestures.
+
+	SwipeBatchDecoder batch;
+	batch.start(0, [](SwipeDecoder& decoder) {
+		return decoder.loadCharLM(path2l, path3l) && decoder.loadLexicon(lexPath);
+	});
+	corpus.buildIndex();
+	std::vector<SwipeBatchResult> results;
+	batch.decode(corpus, results);   // results[i] is gesture i
+
+ The workers are kept (with their decoders' scratch space) between decode()s. The TStats counters
+ (e.g. "SwipeDecoder: converged") are shared by all of them, and so only best effort.
+ */
+class SwipeBatchDecoder {
+public:
+	/// loads the models into one worker's decoder - called on the worker's thread, for all of them at once
+	typedef std::function<bool(SwipeDecoder& decoder)> Setup;
+
+	SwipeBatchDecoder() {}
+	~SwipeBatchDecoder() { stop(); }
+
+	/**
+	 Starts 'numThreads' workers (0 for one per core), and waits for each to run 'setup' on its
+	 decoder - returns false (with no workers) if any of them failed.
+	 */
+	bool start(int numThreads, Setup setup);
+	void stop();
+	int getNumThreads() const { return (int)workers.size(); }
+
+	/// decode on the layout recorded with each gesture (the default), or without the shape matcher
+	void setUseKeyLayouts(bool use) { useKeyLayouts = use; }
+	/**
+	 Each worker's SwipeDecoder::setResultCacheSize(), as of the next start() - 0, the default,
+	 turns the cache off. With it on, a hit returns the words of whichever earlier gesture had the
+	 same key, and which ones a worker saw first depends on the timing - so the results are only
+	 the same from run to run with the cache off (or on one thread).
+	 */
+	void setResultCacheSize(int numEntries) { resultCacheSize = numEntries; }
+
+	/**
+	 Decodes every gesture in 'corpus', which has to have its index built - out[i] is gesture i.
+	 Returns the number decoded (with at least one result).
+	 */
+	int decode(const SwipeTraceReader& corpus, std::vector<SwipeBatchResult>& out);
+
+	/// gestures taken from the counter at a time - enough to keep it cold, few enough to even out the end
+	static const int kChunkSize = 16;
+
+private:
+	struct Worker {
+		SwipeDecoder decoder;
+		SwipeTrace trace;
+		std::vector<int> gestures;                //< the ones it did in the last decode(), in order...
+		std::vector<SwipeBatchResult> results;    //< ... and what they came out as
+		int generation = 0; //< bumped (under thread.conditionMutex) to hand it the next job
+		bool ready = false; //< its setup succeeded
+		TThreadI thread{"SwipeBatch"};
+	};
+	std::vector<Worker*> workers;
+
+	// the job in progress - only written while the workers are idle
+	const SwipeTraceReader* corpus = nullptr;
+	int numGestures = 0;
+	bool useKeyLayouts = true;
+	int resultCacheSize = 0;
+	AtomicInt nextChunk;
+	AtomicInt pending;
+	TCondition doneCondition;
+	MutexNR doneMutex;
+
+	void run(Worker* worker, Setup setup, std::function<bool()> needToStop);
+	void decodeGesture(Worker* worker, int i);
+	void workerDone();
+	void waitForWorkers();
+
+	DISALLOW_COPY_AND_ASSIGN(SwipeBatchDecoder);
+};
+
+#endif
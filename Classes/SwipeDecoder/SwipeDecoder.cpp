@@ -0,0 +1,609 @@
+#include "SwipeDecoder.h"
+#include "TLogging.h"
+#include "TStats.h"
+#include <algorithm>
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+/// how far outside a key (in key widths) a touch is still counted as on it
+static const float kMaxSnapKeyWidths = 0.5f;
+/// what the segmenter and the result cache take a key to be without a layout, in points
+static const float kDefaultKeyWidth = 32.0f;
+/// the result cache's shape signature: the trace's length, in steps of this many key widths
+static const float kCacheLengthKeyWidths = 2.0f;
+
+static inline int64_t usSince(const TDateTime& start) {
+	timeval tv = (TDateTime::now() - start).asTV();
+	return (int64_t)tv.tv_sec*1000000 + tv.tv_usec;
+}
+
+bool SwipeDecoder::loadLexicon(const std::string& path) {
+	// the word ids are about to change
+	bigrams.clear();
+	commitWord(-1);
+	resultCache.clear();
+	userDict.detach();
+	if (!lexicon.load(path)) {
+		userDict.rebuild();
+		return false;
+	}
+	if (!keyLayout.empty())
+		templates.build(lexicon, keyLayout);
+	if (corrector.hasEdits())
+		corrector.build();
+	userDict.rebuild();
+	return true;
+}
+
+bool SwipeDecoder::loadBigrams(const std::string& path) {
+	commitWord(-1);
+	resultCache.clear();
+	return bigrams.load(path, lexicon);
+}
+
+void SwipeDecoder::commitWord(int wordId) {
+	prevWord = wordId;
+	predictions.resize(TMax(beamConfig.numPredictions, 0));
+	predictions.resize(bigrams.topSuccessors(wordId, predictions.data(), (int)predictions.size()));
+
+	// log P(w | prev) - log P(w), where that's positive: successors sorted by id, so a binary search
+	// finds them
+	boosts.clear();
+	const int32_t contextScale = toLogScore(beamConfig.contextWeight);
+	bigrams.forEachSuccessor(wordId, [&](int next, LogProb lp) {
+		const int32_t gain = (int32_t)lp - lexicon.logPrior((uint32_t)next);
+		if (gain <= 0)
+			return;
+		ContextBoost b = { (uint32_t)next, contextScale * gain / kLogProbScale };
+		boosts.push_back(b);
+	});
+}
+
+bool SwipeDecoder::learnWord(const char* word, int len) {
+	// only a new word, or one the user's typing now makes likelier than the lexicon does, can change
+	// what a gesture decodes to - so the common words the cache is for mostly stay cached
+	const int wordId = lexicon.lookup(word, TMax(len, 0));
+	const LogProb before = (wordId >= 0) ? userDict.logPrior((uint32_t)wordId) : kMinLogProb;
+	if (!userDict.learn(word, len))
+		return false;
+	if (wordId < 0 || userDict.logPrior((uint32_t)wordId) != before)
+		resultCache.clear();
+	return true;
+}
+
+int32_t SwipeDecoder::contextBoost(uint32_t wordId) const {
+	auto it = lower_bound(boosts.begin(), boosts.end(), wordId, [](const ContextBoost& b, uint32_t id) {
+		return b.wordId < id;
+	});
+	return (it != boosts.end() && it->wordId == wordId) ? it->boost : 0;
+}
+
+bool SwipeDecoder::loadEdits(const std::string& path) {
+	if (!corrector.loadEdits(path))
+		return false;
+	resultCache.clear();
+	if (lexicon.isLoaded())
+		corrector.build();
+	return true;
+}
+
+void SwipeDecoder::setKeyLayout(const KeyLayout& layout) {
+	if (layout == keyLayout && (!templates.empty() || !lexicon.isLoaded()))
+		return;
+	keyLayout = layout;
+	touchModel.build(keyLayout);
+	templates.build(lexicon, keyLayout);
+	resultCache.clear();
+}
+
+void SwipeDecoder::collectKeyVisits(const SwipePoint* points, int count, std::vector<SwipeKeyVisit>& out) {
+	SwipeVisitTracker visitTracker(charLM);
+	SwipeKeyVisit visit;
+	for (int i=0; i<count; i++) {
+		if (visitTracker.addPoint(points[i], visit))
+			out.push_back(visit);
+	}
+	if (visitTracker.finish(visit))
+		out.push_back(visit);
+}
+
+int SwipeDecoder::decode(const SwipePoint* points, int count, std::vector<SwipeCandidate>& out) {
+	begin();
+	searchDeferred = lexicon.isLoaded() && resultCache.getCapacity() > 0;
+	for (int i=0; i<count; i++)
+		addPoint(points[i]);
+	return finish(out);
+}
+
+void SwipeDecoder::begin() {
+	// the last gesture's containers go back to the arena in one go, then get as much room as they had
+	const size_t numVisits = recycleArenaVector(visits);
+	const size_t numPending = recycleArenaVector(pending);
+	const size_t numBeam = recycleArenaVector(beam);
+	const size_t numNext = recycleArenaVector(next);
+	const size_t numRanked = recycleArenaVector(ranked);
+	const size_t numCorrections = recycleArenaVector(corrections);
+	arena.reset();
+	visits.reserve(numVisits);
+	pending.reserve(numPending);
+	beam.reserve(numBeam);
+	next.reserve(numNext);
+	ranked.reserve(numRanked);
+	corrections.reserve(numCorrections);
+
+	tracker.reset();
+	touchRun.reset();
+	visitStart = 0;
+	segmentsUsed = 0;
+	numPoints = 0;
+	searchUs = 0;
+	searchDeferred = false;
+	cacheHit = false;
+	// a few samples per key is plenty for the shape matcher
+	trace.reset(keyLayout.empty() ? 4.0f : keyLayout.getKeyWidth() / 8);
+	segmenter.reset(trace.getStep(), keyLayout.empty() ? kDefaultKeyWidth : keyLayout.getKeyWidth());
+	
+	priorScale = toLogScore(beamConfig.priorWeight);
+	Hypothesis start;
+	start.at = lexicon.root();
+	start.score = 0;
+	start.lastVisit = -1;
+	start.len = 0;
+	start.misses = 0;
+	beam.push_back(start);
+	if (userDict.hasNewWords()) {
+		start.at = userDict.root();
+		beam.push_back(start);
+	}
+}
+
+void SwipeDecoder::addPoint(const SwipePoint& point) {
+	TDateTime start = TDateTime::now();
+	numPoints++;
+	if (trace.empty())
+		traceStart = point.pTime;
+	const float t = (float)(point.pTime - traceStart).asMs();
+	trace.addPoint(point.pPoint.x, point.pPoint.y, t);
+	segmenter.update(trace);
+
+	// a touch in the gap between two keys belongs to the nearer one, rather than breaking the key run
+	SwipePoint snapped = point;
+	if (snapped.key < 0 && !keyLayout.empty()) {
+		float distance;
+		const SwipeKey* key = keyLayout.nearestKey(point.pPoint.x, point.pPoint.y, &distance);
+		if (key && distance < keyLayout.getKeyWidth() * kMaxSnapKeyWidths)
+			snapped.key = key->key;
+	}
+	SwipeKeyVisit visit;
+	if (tracker.addPoint(snapped, visit)) {
+		touchRun.fillAlternatives(visit, beamConfig.maxTouchCost);
+		touchRun.reset();
+		PendingVisit p = { visit, visitStart, t };
+		pending.push_back(p);
+		visitStart = t;
+	}
+	flushVisits(false);
+	if (!touchModel.empty())
+		touchRun.add(touchModel.lookup(point.pPoint.x, point.pPoint.y));
+	searchUs += usSince(start);
+}
+
+int SwipeDecoder::liveCandidates(std::vector<SwipeCandidate>& out, int maxCount) {
+	if (!lexicon.isLoaded())
+		return 0;
+	collectCandidates(maxCount);
+	return copyRanked(out, maxCount);
+}
+
+int SwipeDecoder::liveCandidates(SwipeResults& out) {
+	out.count = 0;
+	if (!lexicon.isLoaded())
+		return 0;
+	collectCandidates(out.capacity);
+	return copyRanked(out);
+}
+
+int SwipeDecoder::finish(std::vector<SwipeCandidate>& out) {
+	finishRanked(nullptr);
+	return copyRanked(out, beamConfig.maxCandidates);
+}
+
+int SwipeDecoder::finish(SwipeResults& out, const CountdownTimer* deadline) {
+	TDateTime start = TDateTime::now();
+	out.numPoints = numPoints;
+	out.converged = finishRanked(deadline);
+	if (out.converged)
+		TSTATS_INC("SwipeDecoder: converged")
+	else
+		TSTATS_INC("SwipeDecoder: deadline")
+	out.numVisits = (int)visits.size();
+	out.searchUs = searchUs;
+	out.cached = cacheHit;
+	int added = copyRanked(out);
+	out.finishUs = usSince(start);
+	return added;
+}
+
+/// ends the gesture, leaving the words (best first) in 'ranked' - returns false if the deadline cut it short
+bool SwipeDecoder::finishRanked(const CountdownTimer* deadline) {
+	ranked.clear();
+	segmenter.finish(trace);
+	SwipeKeyVisit visit;
+	if (tracker.finish(visit)) {
+		touchRun.fillAlternatives(visit, beamConfig.maxTouchCost);
+		PendingVisit p = { visit, visitStart, INFINITY };
+		pending.push_back(p);
+	}
+	flushVisits(true);
+	tracker.reset();
+	touchRun.reset();
+	if (visits.empty())
+		return true;
+	
+	if (lexicon.isLoaded()) {
+		SwipeCacheKey key;
+		const bool useCache = resultCache.getCapacity() > 0;
+		if (useCache) {
+			makeCacheKey(key);
+			const SwipeResult* cached;
+			const int count = resultCache.find(key, cached);
+			if (count >= 0) {
+				TSTATS_INC("SwipeDecoder: cache hit")
+				ranked.assign(cached, cached + count);
+				cacheHit = true;
+				return true;
+			}
+			TSTATS_INC("SwipeDecoder: cache miss")
+		}
+		if (searchDeferred)
+			searchVisits();
+
+		if (collectCandidates(beamConfig.maxCandidates) == 0)
+			addCorrections(beamConfig.maxCandidates);
+		bool converged = true;
+		if (!templates.empty())
+			converged = !(deadline && deadline->isFinished()) && addShapeMatches(deadline);
+		// a cut short search isn't what the same gesture should get next time
+		if (useCache && converged)
+			resultCache.insert(key, ranked.data(), (int)ranked.size());
+		return converged;
+	}
+	
+TLogDebug("--NEW WORD--")
+	SwipeResult result = SwipeResult();
+	int len = 0;
+	for(auto& visit: visits) {
+		if (!visit.significant || len >= Lexicon::kMaxWordLen)
+			continue;
+TLogDebug("c:%c #:%d ms:%d >:%d vel:%f dist:%f", static_cast<char>(visit.key), visit.nCnt, visit.nMs, visit.nAngle, visit.fVelocity, visit.fDist);
+		result.word[len++] = static_cast<char>(visit.key);
+	}
+	if (len == 0)
+		return true;
+	result.word[len] = 0;
+	result.wordId = -1;
+	ranked.push_back(result);
+	
+	return true;
+}
+
+int SwipeDecoder::copyRanked(std::vector<SwipeCandidate>& out, int maxCount) const {
+	int added = TMin((int)ranked.size(), maxCount);
+	for (int i=0; i<added; i++) {
+		SwipeCandidate candidate;
+		candidate.word = ranked[i].word;
+		candidate.score = ranked[i].score;
+		candidate.wordId = ranked[i].wordId;
+		out.push_back(candidate);
+	}
+	return added;
+}
+
+int SwipeDecoder::copyRanked(SwipeResults& out) const {
+	out.count = TMin((int)ranked.size(), out.capacity);
+	for (int i=0; i<out.count; i++)
+		out.results[i] = ranked[i];
+	return out.count;
+}
+
+/**
+ Searches the pending visits that the segmenter has caught up with (or all of them). A visit is
+ significant - expensive to skip, and worth trying its neighbouring keys for - if the finger turned
+ or slowed down on it, or if the word starts there.
+ */
+void SwipeDecoder::flushVisits(bool all) {
+	const vector<SwipeSegment>& segments = segmenter.getSegments();
+	size_t done = 0;
+	for (; done<pending.size(); done++) {
+		PendingVisit& p = pending[done];
+		if (!all && p.tEnd > segmenter.getConfirmedTime())
+			break;
+		bool segment = false;
+		for (; segmentsUsed<segments.size() && segments[segmentsUsed].t < p.tEnd; segmentsUsed++)
+			segment = segment || (segments[segmentsUsed].t >= p.tStart);
+		p.visit.significant = visits.empty() || segment;
+		addVisit(p.visit);
+	}
+	pending.erase(pending.begin(), pending.begin() + done);
+}
+
+void SwipeDecoder::addVisit(const SwipeKeyVisit& visit) {
+	const int maxVisits = 0x7fff; // Hypothesis::lastVisit
+	if ((int)visits.size() >= maxVisits)
+		return;
+	visits.push_back(visit);
+	if (lexicon.isLoaded() && !beam.empty() && !searchDeferred) {
+		advance((int)visits.size()-1, visit);
+		prune();
+	}
+}
+
+/// the search decode() put off - all of the visits at once, as addVisit() would have
+void SwipeDecoder::searchVisits() {
+	searchDeferred = false;
+	for (int t=0; t<(int)visits.size() && !beam.empty(); t++) {
+		advance(t, visits[t]);
+		prune();
+	}
+}
+
+/**
+ What the result cache knows a gesture by: the significant keys in order - the ones the search
+ can't skip cheaply, and so what its best words are spelled from - and the last key, which every
+ word ends on; as a coarse signature of the shape, the trace's length; and the previous word,
+ whose successors get a boost. The keys passed over, the dwell times and the neighbouring keys are
+ left out: with them hardly two swipes of a word matched, and without them the words came out the
+ same.
+ */
+void SwipeDecoder::makeCacheKey(SwipeCacheKey& key) const {
+	key.add(prevWord);
+	for (size_t i=0; i<visits.size(); i++) {
+		if (visits[i].significant || i+1 == visits.size())
+			key.add(visits[i].key);
+	}
+	key.add(-1);
+	const float keyWidth = keyLayout.empty() ? kDefaultKeyWidth : keyLayout.getKeyWidth();
+	key.add((int32_t)lroundf(trace.getLength() / (keyWidth * kCacheLengthKeyWidths)));
+}
+
+#pragma mark - beam search
+
+/// words whose last letter is on the last key so far, best first, into 'ranked'
+int SwipeDecoder::collectCandidates(int maxCount) {
+	int numVisits = (int)visits.size();
+	next.clear();
+	for (auto& h: beam) {
+		if (h.lastVisit != numVisits-1 || !isWord(h.at))
+			continue;
+		next.push_back(h);
+		next.back().score += wordPrior(h.at.wordId);
+	}
+	sort(next.begin(), next.end(), [](const Hypothesis& a, const Hypothesis& b) {
+		return a.score > b.score;
+	});
+	
+	ranked.clear();
+	for (auto& h: next) {
+		if ((int)ranked.size() >= maxCount)
+			break;
+		SwipeResult r;
+		memcpy(r.word, h.word, h.len);
+		r.word[h.len] = 0;
+		r.wordId = h.at.wordId;
+		r.score = logScoreToFloat(h.score);
+		r.prior = logScoreToFloat(wordPrior(h.at.wordId));
+		r.beam = r.score - r.prior;
+		r.shape = 0;
+		r.shapeOnly = false;
+		ranked.push_back(r);
+	}
+	return (int)ranked.size();
+}
+
+/**
+ When the beam search came up empty: the lexicon words nearest to the significant key run, by the
+ spelling corrector, into 'ranked'. Their beam score is the edit model's log P(key run | word).
+ */
+int SwipeDecoder::addCorrections(int maxCount) {
+	if (corrector.empty())
+		return 0;
+	char run[Lexicon::kMaxWordLen + 1];
+	int len = 0;
+	for (auto& visit: visits) {
+		if (visit.significant && len < Lexicon::kMaxWordLen && visit.key > 0 && visit.key < 256)
+			run[len++] = (char)tolower(visit.key);
+	}
+	corrections.resize(TMax(maxCount, 0));
+	const int found = corrector.correct(run, len, corrections.data(), maxCount);
+	for (int i=0; i<found; i++) {
+		const SpellCandidate& c = corrections[i];
+		SwipeResult r;
+		lexicon.word(c.wordId, r.word);
+		r.wordId = c.wordId;
+		r.beam = c.channel;
+		r.prior = logScoreToFloat(wordPrior(c.wordId));
+		r.score = r.beam + r.prior;
+		r.shape = 0;
+		r.shapeOnly = false;
+		ranked.push_back(r);
+	}
+	// re-ranked by the weighted prior
+	sort(ranked.begin(), ranked.end(), [](const SwipeResult& a, const SwipeResult& b) {
+		return a.score > b.score;
+	});
+	if (found > 0)
+		TSTATS_INC("SwipeDecoder: corrected")
+	return found;
+}
+
+/// rescores the beam's candidates with the shape matcher, and adds the words only it found - returns
+/// false if the deadline stopped the matcher short
+bool SwipeDecoder::addShapeMatches(const CountdownTimer* deadline) {
+	if (!shapeMatcher.setTrace(trace))
+		return true;
+	
+	float worstBeam = INFINITY;
+	float worstShape = 0;
+	for (auto& r: ranked) {
+		worstBeam = TMin(worstBeam, r.score);
+		r.shape = beamConfig.shapeWeight * shapeMatcher.logLikelihood(r.wordId);
+		if (r.shape > -INFINITY)
+			worstShape = TMin(worstShape, r.shape);
+	}
+	// learned words have no template - they get the worst shape of the rest, rather than none
+	for (auto& r: ranked) {
+		if (r.shape == -INFINITY)
+			r.shape = worstShape;
+		r.score += r.shape;
+	}
+	
+	shapeMatches.clear();
+	shapePool.match(shapeMatcher, shapeMatches, deadline);
+	const size_t numBeam = ranked.size();
+	for (auto& m: shapeMatches) {
+		bool found = false;
+		for (size_t i=0; i<numBeam; i++)
+			found = found || (ranked[i].wordId == (int)m.wordId);
+		if (found)
+			continue;
+		
+		SwipeResult r;
+		lexicon.word(m.wordId, r.word);
+		r.wordId = m.wordId;
+		r.shapeOnly = true;
+		if (worstBeam == INFINITY) {
+			r.prior = logScoreToFloat(wordPrior(m.wordId));
+			r.beam = 0;
+		}
+		else {
+			r.prior = logScoreToFloat(contextBoost(m.wordId));
+			r.beam = worstBeam - beamConfig.shapeOnlyPenalty;
+		}
+		r.shape = beamConfig.shapeWeight * shapeMatcher.logLikelihood(m.wordId);
+		r.score = r.beam + r.prior + r.shape;
+		ranked.push_back(r);
+	}
+	
+	sort(ranked.begin(), ranked.end(), [](const SwipeResult& a, const SwipeResult& b) {
+		return a.score > b.score;
+	});
+	return shapePool.hasConverged();
+}
+
+/// extends every hypothesis in 'beam' by visit 't' into 'next'
+void SwipeDecoder::advance(int t, const SwipeKeyVisit& visit) {
+	const SwipeBeamConfig& cfg = beamConfig;
+	const unsigned char key = (visit.key >= 0 && visit.key < 256) ? (unsigned char)tolower(visit.key) : 0;
+	// the costs in LogProb units, so that the loop below is all integer adds
+	const int32_t skipCost = toLogScore((visit.significant ? cfg.skipSignificant : cfg.skipPassing)
+		+ cfg.skipDwellPer100ms * TMin(visit.nMs, 300) / 100.0f);
+	const int32_t doublePenalty = toLogScore(cfg.doublePenalty);
+	const int32_t missPenalty = toLogScore(cfg.missPenalty);
+	const int numAlts = visit.significant ? visit.numAlts : 0;
+	int32_t altCost[kMaxVisitAlts];
+	for (int a=0; a<numAlts; a++)
+		altCost[a] = toLogScore(cfg.touchWeight * visit.alts[a].cost);
+	
+	next.clear();
+	for (const Hypothesis& h: beam) {
+		// the first letter has to be on the first key, after that any key can be passed over
+		if (h.len > 0) {
+			next.push_back(h);
+			next.back().score -= skipCost;
+		}
+		
+		if (h.len >= Lexicon::kMaxWordLen)
+			continue;
+		
+		// the key is the next letter
+		Hypothesis m = h;
+		if (child(m.at, key)) {
+			m.word[m.len++] = key;
+			m.lastVisit = t;
+			next.push_back(m);
+			
+			// ... and maybe the one after that too
+			if (m.len < Lexicon::kMaxWordLen && child(m.at, key)) {
+				m.word[m.len++] = key;
+				m.score -= doublePenalty;
+				next.push_back(m);
+			}
+		}
+		
+		// the touches were meant for a neighbouring key - only where the finger stopped or turned, a
+		// key that was just passed over is no more likely to be meant than its neighbours
+		for (int a=0; a<numAlts; a++) {
+			const unsigned char alt = (unsigned char)tolower(visit.alts[a].key);
+			Hypothesis m = h;
+			if (alt == key || !child(m.at, alt))
+				continue;
+			m.word[m.len++] = alt;
+			m.lastVisit = t;
+			m.score -= altCost[a];
+			next.push_back(m);
+		}
+		
+		// a letter whose key we never saw, then the key
+		if (h.len == 0 || h.misses >= cfg.maxMisses || h.len+1 >= Lexicon::kMaxWordLen)
+			continue;
+		uint32_t mask = childMask(h.at);
+		for (; mask; mask &= mask-1) {
+			unsigned char missed = 'a' + __builtin_ctz(mask);
+			if (missed == key)
+				continue;
+			Hypothesis x = h;
+			child(x.at, missed);
+			if (!child(x.at, key))
+				continue;
+			x.word[x.len++] = missed;
+			x.word[x.len++] = key;
+			x.lastVisit = t;
+			x.misses++;
+			x.score -= missPenalty;
+			next.push_back(x);
+		}
+	}
+}
+
+/// merges duplicate hypotheses in 'next' and keeps the best beamWidth of them in 'beam'
+void SwipeDecoder::prune() {
+	beam.clear();
+	if (next.empty())
+		return;
+	
+	// two hypotheses are the same if they spell the same prefix (node + first word id) and are
+	// equally far along the trail - only the better one can ever win
+	sort(next.begin(), next.end(), [](const Hypothesis& a, const Hypothesis& b) {
+		if (a.at.node != b.at.node) return a.at.node < b.at.node;
+		if (a.at.wordId != b.at.wordId) return a.at.wordId < b.at.wordId;
+		if (a.lastVisit != b.lastVisit) return a.lastVisit < b.lastVisit;
+		return a.score > b.score;
+	});
+	size_t n = 0;
+	for (size_t i=1; i<next.size(); i++) {
+		const Hypothesis& a = next[n];
+		const Hypothesis& b = next[i];
+		if (b.at.node != a.at.node || b.at.wordId != a.at.wordId || b.lastVisit != a.lastVisit)
+			next[++n] = b;
+	}
+	next.resize(n+1);
+	
+	int width = TMin((int)next.size(), beamConfig.beamWidth);
+	if (width < (int)next.size()) {
+		nth_element(next.begin(), next.begin() + width, next.end(), [this](const Hypothesis& a, const Hypothesis& b) {
+			return rank(a) > rank(b);
+		});
+	}
+	int32_t best = INT32_MIN;
+	for (int i=0; i<width; i++)
+		best = TMax(best, rank(next[i]));
+	const int32_t pruneDelta = toLogScore(beamConfig.pruneDelta);
+	for (int i=0; i<width; i++) {
+		if (rank(next[i]) >= best - pruneDelta)
+			beam.push_back(next[i]);
+	}
+}
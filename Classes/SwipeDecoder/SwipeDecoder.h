@@ -0,0 +1,335 @@
+#ifndef _SwipeDecoder_h
+#define _SwipeDecoder_h
+
+#include "TCommon.h"
+#include "CharLM.h"
+#include "GestureTemplates.h"
+#include "KeyLayout.h"
+#include "Lexicon.h"
+#include "ShapeMatchPool.h"
+#include "SpellCorrector.h"
+#include "SwipeArena.h"
+#include "SwipePoint.h"
+#include "SwipeResampler.h"
+#include "SwipeResult.h"
+#include "SwipeResultCache.h"
+#include "SwipeSegmenter.h"
+#include "SwipeVisitTracker.h"
+#include "TouchModel.h"
+#include "UserDictionary.h"
+#include "WordBigrams.h"
+#include <string>
+#include <vector>
+
+struct SwipeCandidate {
+	std::string word;
+	float score = 0;
+	int wordId = -1; //< in the lexicon (or learned, see SwipeResult), -1 if it came from the key-run fallback
+};
+
+/**
+ The results of one gesture, in a buffer the caller owns - e.g. for a suggestion bar, so that the
+ alternatives come with the best guess rather than from decoding again:
+	SwipeResult buffer[5];
+	SwipeResults results(buffer, 5);
+	decoder.finish(results);
+ */
+struct SwipeResults {
+	SwipeResult* results = nullptr;
+	int capacity = 0;
+	int count = 0;       //< filled in, best first
+
+	int numPoints = 0;
+	int numVisits = 0;
+	int64_t searchUs = 0; //< spent in addPoint() - the search done while the finger was moving
+	int64_t finishUs = 0; //< spent in finish()
+	bool converged = true; //< false if finish() ran out of time and returned its best so far
+	bool cached = false;   //< the words came from the result cache (see setResultCacheSize())
+
+	SwipeResults() {}
+	SwipeResults(SwipeResult* buffer, int size) : results(buffer), capacity(size) {}
+};
+
+/**
+ Tuning for the lexicon beam search. Scores are natural-log based and only ever go down, so all of
+ the costs are positive numbers that get subtracted.
+ */
+struct SwipeBeamConfig {
+	int beamWidth = 64;          //< hypotheses kept after every key visit
+	float pruneDelta = 15.0f;    //< hypotheses further than this behind the best are dropped
+	int maxCandidates = 5;       //< words returned by decode()
+
+	float skipPassing = 0.5f;    //< cost of a visited key not being part of the word
+	float skipSignificant = 3.0f;//< ... for a key the finger turned or slowed down on (see SwipeSegmenter)
+	float skipDwellPer100ms = 1.0f; //< plus this much per 100ms spent on the key (capped at 300ms)
+	float doublePenalty = 0.5f;  //< a letter repeated on the same visit ('ll' in hello)
+	float missPenalty = 4.0f;    //< a letter whose key wasn't visited at all
+	int maxMisses = 1;
+	float touchWeight = 6.0f;    //< weight of the touch model's cost for a visit meaning a neighbouring key
+	float maxTouchCost = 1.0f;   //< neighbouring keys more than this much less likely aren't tried
+	float priorWeight = 1.0f;    //< weight of the word frequency prior
+	float contextWeight = 1.0f;  //< weight of how much likelier the previous word makes a word (bigram over unigram)
+	int numPredictions = 5;      //< next words worked out by commitWord()
+
+	// combining with the shape matcher (only when there is a key layout)
+	float shapeWeight = 1.0f;    //< weight of the shape log-likelihood
+	float shapeOnlyPenalty = 5.0f; //< below the worst beam candidate, for words only the shape matcher found
+};
+
+/**
+ The word-recognition part of the swipe keyboard, pulled out of -[PaintingView getSwypedWord] so
+ that it is plain C++ - no NSString/UIKit - and can be built, profiled and benchmarked headless.
+
+ Usage:
+	SwipeDecoder decoder;
+	decoder.loadCharLM(TUtils::pathForResource("count_2l.txt"), TUtils::pathForResource("count_3l.txt"));
+	decoder.loadLexicon(TUtils::pathForResource("count_big.lex"));
+	...
+	std::vector<SwipeCandidate> candidates;
+	if(decoder.decode(&points[0], points.size(), candidates)) {
+		// candidates[0] is the best guess
+	}
+
+ The points are expected to carry the key they were over (SwipePoint::key) plus the velocity/angle/
+ distance as filled in by SwipePoint::ComparePointVsLast().
+
+ The same can be done incrementally, straight from the touch handlers - the beam advances every
+ time the finger leaves a key, so all that is left to do on lift is the last key:
+	decoder.begin();                       // touchesBegan
+	decoder.addPoint(point);               // touchesBegan + touchesMoved
+	decoder.liveCandidates(suggestions, 3); // any time, e.g. for a suggestion bar
+	decoder.finish(candidates);            // touchesEnded
+
+ With a lexicon loaded the trail is reduced to key visits, and a beam search walks the lexicon trie
+ along them: the word's first letter has to be on the first key, its last letter on the last key,
+ and everything in between either matches a visited key in order or pays a penalty. So the result
+ is always a word from the lexicon, and the work per visit is bounded by the beam width. Without a
+ lexicon it falls back to the old heuristic of just emitting the significant key runs.
+
+ Which visits are significant - where the finger turned or slowed down, so most likely meant - comes
+ from the SwipeSegmenter running over the resampled trail. The search only tries neighbouring keys
+ for those and makes them expensive to skip; the rest are mostly just passed over. A visit is
+ searched once the segmenter has caught up with it, a few samples after the finger left the key.
+
+ Given the key layout (setKeyLayout()) there is a second engine: the trace is also compared against
+ the ideal gesture of every word (see GestureTemplates), and the two are combined - each word scores
+ its beam score plus its weighted shape log-likelihood.
+
+ The layout also gives a touch model (see TouchModel): each visit can be taken to mean one of its
+ neighbouring keys instead, at the cost of how much less likely the touches make that key.
+
+ Words the user has typed (see UserDictionary) are searched alongside the lexicon: they raise the
+ prior of lexicon words, and new words get a trie of their own that the beam starts in as well.
+
+ The finished words of recent gestures are kept in a SwipeResultCache, keyed by the significant
+ keys, the length of the trace in steps of two keys and the previous word (see makeCacheKey()): a
+ gesture that comes out the same skips the shape matcher on lift, and decode() - which has the
+ whole trail up front, so can put the search off until then - skips the search too.
+
+ The gesture's visits, hypotheses and results live in a SwipeArena that begin() resets, each
+ container getting back the capacity it had: after the first few gestures the decoding state
+ doesn't touch the heap at all.
+ */
+class SwipeDecoder {
+	CharLM charLM;
+	Lexicon lexicon;
+	SwipeBeamConfig beamConfig;
+	KeyLayout keyLayout;
+	GestureTemplates templates;
+	ShapeMatcher shapeMatcher;
+	ShapeMatchPool shapePool;
+	TouchModel touchModel;
+	SpellCorrector corrector;
+	WordBigrams bigrams;
+	UserDictionary userDict;
+	SwipeResultCache resultCache;
+
+	struct Hypothesis {
+		LexCursor at;
+		int32_t score;      //< LogProb units
+		int16_t lastVisit;  //< the visit the last letter was matched to
+		uint8_t len;
+		uint8_t misses;
+		char word[Lexicon::kMaxWordLen];
+	};
+	/// where the gesture's containers below live - reset by begin()
+	SwipeArena arena;
+	// state of the gesture in progress
+	SwipeVisitTracker tracker;
+	TouchRun touchRun;
+	SwipeArenaVector<SwipeKeyVisit> visits{SwipeArenaAllocator<SwipeKeyVisit>(&arena)};
+	SwipeResampler trace;
+	SwipeSegmenter segmenter;
+	/// a visit that's waiting for the segmenter to catch up with it - [tStart, tEnd) in the trail's ms
+	struct PendingVisit {
+		SwipeKeyVisit visit;
+		float tStart, tEnd;
+	};
+	SwipeArenaVector<PendingVisit> pending{SwipeArenaAllocator<PendingVisit>(&arena)};
+	float visitStart = 0;
+	size_t segmentsUsed = 0;   //< segments before this one are in visits that were already searched
+	TDateTime traceStart;
+	int numPoints = 0;
+	int64_t searchUs = 0;
+	int32_t priorScale = kLogProbScale; //< beamConfig.priorWeight in LogProb units, as of begin()
+	bool searchDeferred = false; //< decode(): the beam search is left to finish(), in case the cache has the gesture
+	bool cacheHit = false;       //< finish() found the words in resultCache
+	// scratch space - on the arena too, but for shapeMatches, which ShapeMatchPool fills (and which
+	// just keeps its capacity between decodes)
+	SwipeArenaVector<Hypothesis> beam{SwipeArenaAllocator<Hypothesis>(&arena)};
+	SwipeArenaVector<Hypothesis> next{SwipeArenaAllocator<Hypothesis>(&arena)};
+	std::vector<ShapeMatch> shapeMatches;
+	SwipeArenaVector<SwipeResult> ranked{SwipeArenaAllocator<SwipeResult>(&arena)};
+	SwipeArenaVector<SpellCandidate> corrections{SwipeArenaAllocator<SpellCandidate>(&arena)};
+	// the word before the next gesture (see commitWord())
+	int prevWord = -1;
+	std::vector<WordPrediction> predictions;
+	/// the successors of prevWord that it makes likelier than their prior, by word id
+	struct ContextBoost {
+		uint32_t wordId;
+		int32_t boost;  //< weighted, in LogProb units
+	};
+	std::vector<ContextBoost> boosts;
+
+public:
+	SwipeDecoder() : shapeMatcher(templates, lexicon), shapePool(templates, lexicon), corrector(lexicon), userDict(lexicon), tracker(charLM) {
+		resultCache.setCapacity(kDefaultResultCacheSize);
+	}
+
+	/// returns false if either of the letter-frequency files couldn't be read
+	bool loadCharLM(const std::string& path2l, const std::string& path3l) { return charLM.load(path2l, path3l); }
+
+	/// a compiled lexicon (mapped) or the word list it was compiled from - see Lexicon::load()
+	bool loadLexicon(const std::string& path);
+
+	/**
+	 The edit counts (count_1edit.txt) for correcting the significant key run when the beam search
+	 finds no word - see SpellCorrector. Returns false if they couldn't be read.
+	 */
+	bool loadEdits(const std::string& path);
+	const SpellCorrector& getSpellCorrector() const { return corrector; }
+
+	/// word bigrams for the loaded lexicon (see WordBigrams) - returns false if they're missing or for another lexicon
+	bool loadBigrams(const std::string& path);
+	const WordBigrams& getBigrams() const { return bigrams; }
+
+	/**
+	 The user accepted 'wordId' (-1 for none, e.g. after punctuation): works out the likeliest next
+	 words (see getPredictions()), and which words the next gesture should favour - their bigram
+	 over their unigram probability is added to their prior, at contextWeight. That's a lookup per
+	 finished candidate, nothing while the finger is moving.
+	 */
+	void commitWord(int wordId);
+	/// the likeliest words after the last commitWord(), best first
+	const std::vector<WordPrediction>& getPredictions() const { return predictions; }
+
+	/// the user dictionary kept in 'dir' (see UserDictionary::open()) - returns false if it can't be written to
+	bool openUserDictionary(const std::string& dir) { return userDict.open(dir); }
+	/// the user typed 'word' - it's searched from the next gesture on, whether the lexicon has it or not
+	bool learnWord(const char* word, int len);
+	bool forgetWord(const char* word, int len) { resultCache.clear(); return userDict.forget(word, len); }
+	UserDictionary& getUserDictionary() { return userDict; }
+
+	/// (re)builds the shape templates if the layout changed
+	void setKeyLayout(const KeyLayout& layout);
+	const KeyLayout& getKeyLayout() const { return keyLayout; }
+	ShapeMatchConfig& getShapeConfig() { return shapeMatcher.getConfig(); }
+	/// threads for the shape matcher (see ShapeMatchPool) - 1, the default, keeps it on the caller's
+	void setNumShapeThreads(int numThreads) { shapePool.setNumThreads(numThreads); }
+
+	/// e.g. to extend the alphabet before loadCharLM()
+	CharLM& getCharLM() { return charLM; }
+	const Lexicon& getLexicon() const { return lexicon; }
+
+	/// after changing either config through these, clearResultCache()
+	SwipeBeamConfig& getBeamConfig() { return beamConfig; }
+	void setBeamConfig(const SwipeBeamConfig& config) { beamConfig = config; resultCache.clear(); }
+
+	/**
+	 Gestures whose words are kept (see SwipeResultCache) - 0 turns the cache off. It's cleared
+	 whenever the layout, lexicon, bigrams, edits or user dictionary change; hits and misses go to
+	 the stats ("SwipeDecoder: cache hit" / "SwipeDecoder: cache miss").
+	 */
+	void setResultCacheSize(int numEntries) { resultCache.setCapacity(numEntries); }
+	void clearResultCache() { resultCache.clear(); }
+	const SwipeResultCache& getResultCache() const { return resultCache; }
+	static const int kDefaultResultCacheSize = 256;
+
+	/// the gesture's scratch space - its getNumMallocs() stays put once the decoder is warmed up
+	const SwipeArena& getArena() const { return arena; }
+
+	/**
+	 Decodes the given trail, appending candidates (best first) to 'out'.
+	 Returns the number of candidates added - 0 if nothing could be decoded.
+	 */
+	int decode(const SwipePoint* points, int count, std::vector<SwipeCandidate>& out);
+
+	/// starts a new gesture, dropping anything from the previous one
+	void begin();
+
+	/// adds the next point of the gesture - this is where the search work happens
+	void addPoint(const SwipePoint& point);
+
+	/**
+	 The best (up to) 'maxCount' words so far, as if the finger had lifted on the last key that was
+	 searched - the search waits for the segmenter, so that's a few samples behind the finger.
+	 Doesn't change the decoding state. Returns the number of candidates added to 'out'.
+	 */
+	int liveCandidates(std::vector<SwipeCandidate>& out, int maxCount);
+	/// the same, up to out.capacity of them, without allocating
+	int liveCandidates(SwipeResults& out);
+
+	/// ends the gesture: same as decode() for all of the points added since begin()
+	int finish(std::vector<SwipeCandidate>& out);
+	/**
+	 The same, filling in up to out.capacity (best first) results with their score breakdown, plus
+	 the gesture's timing. Nothing is allocated once the decoder has seen a few gestures.
+
+	 With a deadline the work is done most-promising first and stops when it runs out, returning the
+	 best so far: the beam search's words always, then as much of the shape matcher as there is time
+	 for. Whether it converged goes to out.converged and the stats ("SwipeDecoder: converged" /
+	 "SwipeDecoder: deadline"). Only converged results are cached, and a cache hit returns at most
+	 SwipeResultCache::kMaxResults.
+	 */
+	int finish(SwipeResults& out, const CountdownTimer* deadline = nullptr);
+
+	/// reduces the trail to the keys that were visited, appending to 'out'
+	void collectKeyVisits(const SwipePoint* points, int count, std::vector<SwipeKeyVisit>& out);
+
+private:
+	void addVisit(const SwipeKeyVisit& visit);
+	void flushVisits(bool all);
+	bool finishRanked(const CountdownTimer* deadline);
+	void makeCacheKey(SwipeCacheKey& key) const;
+	void searchVisits();
+	int collectCandidates(int maxCount);
+	int addCorrections(int maxCount);
+	bool addShapeMatches(const CountdownTimer* deadline);
+	int copyRanked(std::vector<SwipeCandidate>& out, int maxCount) const;
+	int copyRanked(SwipeResults& out) const;
+	void advance(int t, const SwipeKeyVisit& visit);
+	void prune();
+
+	/// a prior times beamConfig.priorWeight, in integers
+	inline int32_t weightedPrior(LogProb lp) const { return priorScale * lp / kLogProbScale; }
+	/// how much the previous word favours 'wordId', 0 if it doesn't
+	int32_t contextBoost(uint32_t wordId) const;
+	/// the weighted prior of a finished word, including the previous word's boost
+	inline int32_t wordPrior(uint32_t wordId) const { return weightedPrior(userDict.logPrior(wordId)) + contextBoost(wordId); }
+
+	// a cursor in either the lexicon or the user dictionary's overlay
+	inline bool child(LexCursor& at, unsigned char c) const { return userDict.owns(at) ? userDict.child(at, c) : lexicon.child(at, c); }
+	inline uint32_t childMask(const LexCursor& at) const { return userDict.owns(at) ? userDict.childMask(at) : lexicon.node(at.node).childMask; }
+	inline bool isWord(const LexCursor& at) const { return userDict.owns(at) ? userDict.isWord(at) : lexicon.node(at.node).isWord; }
+	inline LogProb maxLogPrior(const LexCursor& at) const {
+		return userDict.owns(at) ? userDict.maxLogPrior(at) : lexicon.node(at.node).maxLogPrior;
+	}
+
+	inline int32_t rank(const Hypothesis& h) const {
+		return h.score + weightedPrior(maxLogPrior(h.at));
+	}
+
+	DISALLOW_COPY_AND_ASSIGN(SwipeDecoder);
+};
+
+#endif
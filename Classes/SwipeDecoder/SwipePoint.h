@@ -0,0 +1,66 @@
+#ifndef _SwipePoint_h
+#define _SwipePoint_h
+
+#include <math.h>
+#include "TDateTime.h"
+
+/**
+ A single sample of the swipe trail, as captured from the touch handlers in PaintingView.
+ 
+ This is kept free of UIKit so that the decoder can be built+run headless - on Apple platforms the
+ point is still a CGPoint (so the touch handlers can assign to it directly), elsewhere it is just a
+ plain x/y pair.
+ */
+#ifdef __APPLE__
+#	include <CoreGraphics/CGGeometry.h>
+typedef CGPoint SwipeXY;
+#else
+struct SwipeXY {
+	float x;
+	float y;
+};
+#endif
+
+#define PI 3.14159265
+// TODO: probably there is a better representation for the letters/characters than int
+class SwipePoint {
+public:
+	SwipePoint() {
+		//pTime.setToNow();
+		nMs = 0;
+		pPoint.x = 0;
+		pPoint.y = 0;
+		key = -1;
+		nCnt = 0;
+		fVelocity = 0.0F;
+		fDist = 0.0F;
+		nAngle = 0;
+	}
+	~SwipePoint() {};
+	SwipeXY pPoint;
+	TDateTime pTime;
+	int nMs;
+	int nCnt;
+	int key;
+	float fVelocity;
+	float fDist;
+	int nAngle;
+	
+	void ComparePointVsLast(SwipePoint prev, float& nVelocity, int& nDist, int& nTime)
+	{
+		//nTime = pTime.asMs() - prev.pTime.asMs();
+	
+		int nDistX = pPoint.x - prev.pPoint.x;
+		int nDistY = pPoint.y - prev.pPoint.y;
+		if (nTime<=0) nTime = 1;
+		
+		fDist = sqrt(nDistX*nDistX + nDistY*nDistY);
+		fVelocity = fDist/(float)nTime;
+		nAngle = atan2(nDistY, nDistX) * 180.0 / PI;
+		
+		nVelocity = fVelocity;
+		nDist = fDist;
+	}
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "SwipeResampler.h"
+#include <math.h>
+
+void SwipeResampler::reset(float newStep) {
+	step = (newStep > 0) ? newStep : 1.0f;
+	x.clear();
+	y.clear();
+	t.clear();
+	length = 0;
+	sinceSample = 0;
+}
+
+void SwipeResampler::pushSample(float px, float py, float pt) {
+	x.push_back(px);
+	y.push_back(py);
+	t.push_back(pt);
+}
+
+void SwipeResampler::addPoint(float px, float py, float tMs) {
+	if (x.empty()) {
+		pushSample(px, py, tMs);
+		prevX = px;
+		prevY = py;
+		prevT = tMs;
+		return;
+	}
+
+	// the tail is about to move on
+	if (sinceSample > 0) {
+		x.pop_back();
+		y.pop_back();
+		t.pop_back();
+	}
+
+	float d = hypotf(px - prevX, py - prevY);
+	float pos = 0;
+	while (sinceSample + (d - pos) >= step) {
+		pos += step - sinceSample;
+		float f = pos / d;
+		pushSample(prevX + (px - prevX)*f, prevY + (py - prevY)*f, prevT + (tMs - prevT)*f);
+		sinceSample = 0;
+	}
+	sinceSample += d - pos;
+	length += d;
+	prevX = px;
+	prevY = py;
+	prevT = tMs;
+
+	if (sinceSample > 0)
+		pushSample(px, py, tMs);
+}
+
+float SwipeResampler::resample(int numOut, float* outX, float* outY, float* outT) const {
+	if (x.empty())
+		return 0;
+	return resample(&x[0], &y[0], &t[0], size(), numOut, outX, outY, outT);
+}
+
+float SwipeResampler::resample(const float* xs, const float* ys, const float* ts, int n, int numOut,
+							   float* outX, float* outY, float* outT) {
+	if (n <= 0 || numOut <= 0)
+		return 0;
+
+	float total = 0;
+	for (int i=1; i<n; i++)
+		total += hypotf(xs[i]-xs[i-1], ys[i]-ys[i-1]);
+
+	outX[0] = xs[0];
+	outY[0] = ys[0];
+	if (outT)
+		outT[0] = ts ? ts[0] : 0;
+	int k = 1;
+	if (total > 0 && numOut > 1) {
+		float interval = total / (numOut-1);
+		float segStart = 0;
+		for (int i=1; i<n && k<numOut-1; i++) {
+			float d = hypotf(xs[i]-xs[i-1], ys[i]-ys[i-1]);
+			while (k < numOut-1 && k*interval <= segStart + d) {
+				float f = (d > 0) ? (k*interval - segStart) / d : 0;
+				outX[k] = xs[i-1] + (xs[i]-xs[i-1])*f;
+				outY[k] = ys[i-1] + (ys[i]-ys[i-1])*f;
+				if (outT)
+					outT[k] = ts ? ts[i-1] + (ts[i]-ts[i-1])*f : 0;
+				k++;
+			}
+			segStart += d;
+		}
+	}
+	// the last point (and anything rounding left short)
+	for (; k<numOut; k++) {
+		outX[k] = xs[n-1];
+		outY[k] = ys[n-1];
+		if (outT)
+			outT[k] = ts ? ts[n-1] : 0;
+	}
+	return total;
+}
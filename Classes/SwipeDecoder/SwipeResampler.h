@@ -0,0 +1,64 @@
+#ifndef _SwipeResampler_h
+#define _SwipeResampler_h
+
+#include "TCommon.h"
+#include <vector>
+
+/**
+ Turns the raw touch trail - whose density depends on the device's event rate and how fast the
+ finger moves - into points spaced equally along the path, stored as separate x/y/t float arrays.
+
+ Points go in one at a time (addPoint(), e.g. from touchesMoved) and samples come out every 'step'
+ of path length. The last sample is always the latest raw point (the 'tail'), which moves along as
+ more points arrive, so the arrays always cover the whole trail so far.
+
+ Scoring code usually wants a fixed number of points regardless of how long the gesture was -
+ resample() gives N points spaced equally along the whole trail, in O(size() + N). The static
+ version does the same for any polyline, for batch use.
+ */
+class SwipeResampler {
+	float step = 4.0f;
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> t;
+	float length = 0;
+	float sinceSample = 0;  //< path length between the last real sample and the tail
+	float prevX = 0, prevY = 0, prevT = 0; //< the last raw point
+
+public:
+	SwipeResampler() {}
+
+	/// starts a new trail, with samples every 'step' (in the same units as the points)
+	void reset(float newStep);
+	void reset() { reset(step); }
+
+	void addPoint(float px, float py, float tMs);
+
+	int size() const { return (int)x.size(); }
+	/// the samples before the tail - those won't change any more
+	int numFixed() const { return (sinceSample > 0) ? size()-1 : size(); }
+	bool empty() const { return x.empty(); }
+	float getLength() const { return length; }
+	float getStep() const { return step; }
+
+	const float* xs() const { return x.empty() ? nullptr : &x[0]; }
+	const float* ys() const { return y.empty() ? nullptr : &y[0]; }
+	const float* ts() const { return t.empty() ? nullptr : &t[0]; }
+
+	/**
+	 Writes 'numOut' points spaced equally along the trail (including both ends) into outX/outY,
+	 and the interpolated times into outT if it isn't nullptr. Returns the trail length.
+	 */
+	float resample(int numOut, float* outX, float* outY, float* outT = nullptr) const;
+
+	/// the same for any polyline; 'ts' and 'outT' may be nullptr
+	static float resample(const float* xs, const float* ys, const float* ts, int n, int numOut,
+						  float* outX, float* outY, float* outT = nullptr);
+
+private:
+	void pushSample(float px, float py, float pt);
+
+	DISALLOW_COPY_AND_ASSIGN(SwipeResampler);
+};
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef _SwipeResult_h
+#define _SwipeResult_h
+
+#include "TCommon.h"
+#include "Lexicon.h"
+
+/// one decoded word, with where its score came from: score = beam + prior + shape
+struct SwipeResult {
+	char word[Lexicon::kMaxWordLen + 1];
+	int wordId;      //< in the lexicon, or from lexicon.wordCount() a learned word (see UserDictionary) - -1 if it came from the key-run fallback
+	float score;
+	float beam;      //< the beam search's costs - skipped keys, misses, neighbouring keys
+	float prior;     //< the weighted word frequency prior, plus the previous word's boost (see commitWord())
+	float shape;     //< the weighted shape log-likelihood (0 without a key layout)
+	bool shapeOnly;  //< only the shape matcher found it - 'beam' is then a stand-in, see shapeOnlyPenalty
+};
+
+#endif
@@ -0,0 +1,115 @@
+#include "SwipeResultCache.h"
+#include <string.h>
+
+using namespace std;
+
+void SwipeResultCache::setCapacity(int numEntries) {
+	numEntries = TMax(numEntries, 0);
+	entries.resize(numEntries);
+	size_t tableSize = 0;
+	if (numEntries > 0) {
+		for (tableSize = 2; tableSize < (size_t)numEntries * 2; tableSize *= 2)
+			;
+	}
+	table.resize(tableSize);
+	clear();
+}
+
+void SwipeResultCache::clear() {
+	fill(table.begin(), table.end(), -1);
+	head = tail = -1;
+	numUsed = 0;
+	hits = misses = 0;
+}
+
+uint32_t SwipeResultCache::slotOf(const SwipeCacheKey& key) const {
+	const uint32_t mask = (uint32_t)table.size() - 1;
+	uint32_t slot = home(key);
+	// never more than half full, so there's always an empty slot to stop at
+	while (table[slot] >= 0 && !(entries[table[slot]].key == key))
+		slot = (slot + 1) & mask;
+	return slot;
+}
+
+void SwipeResultCache::unlink(int32_t e) {
+	Entry& entry = entries[e];
+	if (entry.prev >= 0)
+		entries[entry.prev].next = entry.next;
+	else
+		head = entry.next;
+	if (entry.next >= 0)
+		entries[entry.next].prev = entry.prev;
+	else
+		tail = entry.prev;
+}
+
+void SwipeResultCache::pushFront(int32_t e) {
+	Entry& entry = entries[e];
+	entry.prev = -1;
+	entry.next = head;
+	if (head >= 0)
+		entries[head].prev = e;
+	head = e;
+	if (tail < 0)
+		tail = e;
+}
+
+/// takes 'key' out of the table - the entry itself is left to the caller
+void SwipeResultCache::erase(const SwipeCacheKey& key) {
+	const uint32_t mask = (uint32_t)table.size() - 1;
+	uint32_t hole = slotOf(key);
+	if (table[hole] < 0)
+		return;
+	table[hole] = -1;
+	// anything further along the run that could live in the hole moves back into it, so that a
+	// lookup never stops short at the hole
+	for (uint32_t slot = (hole + 1) & mask; table[slot] >= 0; slot = (slot + 1) & mask) {
+		const uint32_t want = home(entries[table[slot]].key);
+		if (((slot - want) & mask) >= ((slot - hole) & mask)) {
+			table[hole] = table[slot];
+			table[slot] = -1;
+			hole = slot;
+		}
+	}
+}
+
+int SwipeResultCache::find(const SwipeCacheKey& key, const SwipeResult*& results) {
+	if (entries.empty())
+		return -1;
+	const int32_t e = table[slotOf(key)];
+	if (e < 0) {
+		misses++;
+		return -1;
+	}
+	hits++;
+	if (e != head) {
+		unlink(e);
+		pushFront(e);
+	}
+	results = entries[e].results;
+	return entries[e].count;
+}
+
+void SwipeResultCache::insert(const SwipeCacheKey& key, const SwipeResult* results, int count) {
+	if (entries.empty())
+		return;
+	uint32_t slot = slotOf(key);
+	int32_t e = table[slot];
+	if (e >= 0)
+		unlink(e);
+	else if (numUsed < (int)entries.size())
+		e = numUsed++;
+	else {
+		// the least recently used one goes
+		e = tail;
+		unlink(e);
+		erase(entries[e].key);
+		slot = slotOf(key);
+	}
+	Entry& entry = entries[e];
+	entry.key = key;
+	entry.count = TRange(count, 0, kMaxResults);
+	memcpy(entry.results, results, entry.count * sizeof(SwipeResult));
+	table[slot] = e;
+	pushFront(e);
+}
@@ -0,0 +1,91 @@
+#ifndef _SwipeResultCache_h
+#define _SwipeResultCache_h
+
+#include "TCommon.h"
+#include "SwipeResult.h"
+#include <stdint.h>
+#include <vector>
+
+/**
+ What a gesture is looked up by: two independent 64-bit hashes of whatever it's built from, so
+ that telling two keys apart doesn't need the values kept - a false hit takes a collision of both.
+ */
+struct SwipeCacheKey {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	uint64_t check = 0x9e3779b97f4a7c15ULL;
+
+	void add(int32_t v) {
+		hash = (hash ^ (uint32_t)v) * 0x100000001b3ULL;
+		check = (check + (uint32_t)v + 1) * 0xff51afd7ed558ccdULL;
+		check ^= check >> 29;
+	}
+	bool operator==(const SwipeCacheKey& o) const { return hash == o.hash && check == o.check; }
+};
+
+/**
+ A bounded LRU cache of decoded gestures - the top results for a SwipeCacheKey - so that a word
+ swiped the same way again (common words are, over and over) costs a hash lookup instead of the
+ search. What goes into the key, and so what counts as "the same way", is up to the caller (see
+ SwipeDecoder::finish()).
+
+ Nothing is allocated after setCapacity(): the entries are a fixed array, chained most recently
+ used first by index, and found through an open-addressed table of entry indexes twice the size
+ (linear probing, deletion by shifting the rest of the run back), so find() and insert() are O(1).
+
+	SwipeResultCache cache;
+	cache.setCapacity(256);
+	const SwipeResult* results;
+	int count = cache.find(key, results);
+	if (count < 0)
+		cache.insert(key, ranked, numRanked);
+ */
+class SwipeResultCache {
+public:
+	/// results kept per gesture - any more are dropped
+	static const int kMaxResults = 8;
+
+	SwipeResultCache() {}
+
+	/// entries kept before the least recently used one goes - 0 turns it off. Clears it.
+	void setCapacity(int numEntries);
+	int getCapacity() const { return (int)entries.size(); }
+	int size() const { return numUsed; }
+	void clear();
+
+	/**
+	 The results cached for 'key' (best first, in 'results') and makes it the most recently used -
+	 returns their number, or -1 if it isn't cached.
+	 */
+	int find(const SwipeCacheKey& key, const SwipeResult*& results);
+	/// caches (up to kMaxResults of) 'results' for 'key', in place of the least recently used entry if full
+	void insert(const SwipeCacheKey& key, const SwipeResult* results, int count);
+
+	/// find()s since the last clear()
+	int64_t getHits() const { return hits; }
+	int64_t getMisses() const { return misses; }
+
+private:
+	struct Entry {
+		SwipeCacheKey key;
+		int32_t prev, next;  //< in the LRU list, -1 at the ends
+		int32_t count;
+		SwipeResult results[kMaxResults];
+	};
+	std::vector<Entry> entries;
+	std::vector<int32_t> table; //< entry indexes, -1 for empty - a power of two
+	int32_t head = -1;           //< most recently used
+	int32_t tail = -1;           //< least recently used
+	int numUsed = 0;
+	int64_t hits = 0, misses = 0;
+
+	inline uint32_t home(const SwipeCacheKey& key) const { return (uint32_t)(key.hash >> 32 ^ key.hash) & (uint32_t)(table.size() - 1); }
+	/// the table slot holding 'key', or the empty one it would go in
+	uint32_t slotOf(const SwipeCacheKey& key) const;
+	void unlink(int32_t e);
+	void pushFront(int32_t e);
+	void erase(const SwipeCacheKey& key);
+
+	DISALLOW_COPY_AND_ASSIGN(SwipeResultCache);
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "SwipeSegmenter.h"
+#include <math.h>
+
+using namespace std;
+
+void SwipeSegmenter::reset(float step, float keyWidth) {
+	samplesPerKey = (step > 0) ? keyWidth / step : 8;
+	turnCos2.clear();
+	msPerStep.clear();
+	numFeatures = 0;
+	numDecided = 0;
+	confirmedTime = 0;
+	segments.clear();
+}
+
+void SwipeSegmenter::computeFeatures(const float* xs, const float* ys, const float* ts, int lo, int hi, int w,
+									 float* turnCos2, float* msPerStep) {
+	const float invSpan = 1.0f / (2*w);
+	for (int i=lo; i<hi; i++) {
+		const float ax = xs[i] - xs[i-w], ay = ys[i] - ys[i-w];
+		const float bx = xs[i+w] - xs[i], by = ys[i+w] - ys[i];
+		const float dot = ax*bx + ay*by;
+		// cos^2 keeps the sign of the cos - the sample spacing keeps the lengths well away from 0
+		turnCos2[i] = dot * fabsf(dot) / ((ax*ax + ay*ay) * (bx*bx + by*by) + 1e-6f);
+		msPerStep[i] = (ts[i+w] - ts[i-w]) * invSpan;
+	}
+}
+
+/// features for every sample with 'window' samples either side among the first 'numSamples'
+void SwipeSegmenter::extendFeatures(const SwipeResampler& trace, int numSamples) {
+	const int w = config.window;
+	if ((int)turnCos2.size() < numSamples) {
+		// the first few can't be measured - straight on and not slow, so never a segment
+		turnCos2.resize(numSamples, 1.0f);
+		msPerStep.resize(numSamples, 0.0f);
+	}
+	const int lo = TMax(numFeatures, w);
+	const int hi = numSamples - w;
+	if (hi > lo)
+		computeFeatures(trace.xs(), trace.ys(), trace.ts(), lo, hi, w, &turnCos2[0], &msPerStep[0]);
+	numFeatures = TMax(numFeatures, TMax(hi, TMin(w, numSamples)));
+}
+
+/// looks for segments among the samples up to 'upTo', comparing them with the features up to 'numFeatures'
+int SwipeSegmenter::decide(const SwipeResampler& trace, int upTo) {
+	const int w = config.window;
+	const float* ts = trace.ts();
+	const int before = (int)segments.size();
+	for (int i=numDecided; i<upTo; i++) {
+		const float cos2 = turnCos2[i];
+		const float ms = msPerStep[i];
+		// a local extremum within the window - the first of a tie
+		bool minTurn = cos2 < config.maxCornerCos2;
+		bool maxSlow = ms > 0;
+		const int lo = TMax(0, i-w), hi = TMin(numFeatures, i+w+1);
+		for (int j=lo; j<hi; j++) {
+			if (j == i)
+				continue;
+			minTurn = minTurn && (j < i ? cos2 <= turnCos2[j] : cos2 < turnCos2[j]);
+			maxSlow = maxSlow && (j < i ? ms >= msPerStep[j] : ms > msPerStep[j]);
+		}
+		if (maxSlow) {
+			const int end = TMin(i+w, trace.size()-1);
+			const float average = (ts[end] - ts[0]) / end;
+			maxSlow = (ms * samplesPerKey > config.minDwellMsPerKey) || (ms > average * config.minDwellSlowdown);
+		}
+		if (!minTurn && !maxSlow)
+			continue;
+		SwipeSegment s;
+		s.sample = i;
+		s.x = trace.xs()[i];
+		s.y = trace.ys()[i];
+		s.t = ts[i];
+		s.turnCos2 = cos2;
+		s.msPerKey = ms * samplesPerKey;
+		s.corner = minTurn;
+		s.dwell = maxSlow;
+		segments.push_back(s);
+	}
+	numDecided = TMax(numDecided, upTo);
+	if (numDecided > 0)
+		confirmedTime = ts[numDecided-1];
+	return (int)segments.size() - before;
+}
+
+int SwipeSegmenter::update(const SwipeResampler& trace) {
+	const int numFixed = trace.numFixed();
+	if (numFixed <= numDecided + 2*config.window)
+		return 0;
+	extendFeatures(trace, numFixed);
+	return decide(trace, numFeatures - config.window);
+}
+
+int SwipeSegmenter::finish(const SwipeResampler& trace) {
+	const int n = trace.size();
+	if (n == 0)
+		return 0;
+	extendFeatures(trace, n);
+	int added = decide(trace, numFeatures);
+	// nothing after the last measurable sample can be a segment
+	numDecided = n;
+	confirmedTime = trace.ts()[n-1];
+	return added;
+}
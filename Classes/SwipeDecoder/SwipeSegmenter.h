@@ -0,0 +1,88 @@
+#ifndef _SwipeSegmenter_h
+#define _SwipeSegmenter_h
+
+#include "TCommon.h"
+#include "SwipeResampler.h"
+#include <vector>
+
+/// a point where the finger most likely meant a key: it turned, or slowed down
+struct SwipeSegment {
+	int sample;       //< in the resampled trail
+	float x, y, t;
+	float turnCos2;   //< signed cos^2 of the turn: 1 straight on, 0 a right angle, -1 a reversal
+	float msPerKey;   //< how long the finger took over a key width around here
+	bool corner;
+	bool dwell;
+};
+
+struct SwipeSegmentConfig {
+	int window = 2;              //< samples either side that the turn and the speed are measured over
+	float maxCornerCos2 = 0.5f;  //< a turn of more than 45 degrees is a corner
+	float minDwellMsPerKey = 100;//< slower than this is a dwell ...
+	float minDwellSlowdown = 2;  //< ... and so is this much slower than the gesture's average
+};
+
+/**
+ Finds the corners and dwells of a swipe as it is drawn, from the equidistant samples of a
+ SwipeResampler - the places the finger most likely meant a key, as opposed to just passing it.
+
+ Per sample it measures the turn between the 'window' samples before and after it (as a signed
+ cos^2, from dot products - no atan2 or sqrt), and the time the finger took over those samples
+ (equidistant, so that's the inverse of the speed). Both are plain loops over the x/y/t arrays
+ that the compiler can vectorise. A corner is a local minimum of the cos^2 below
+ maxCornerCos2; a dwell is a local maximum of the time that is slow in absolute terms or compared
+ to the rest of the gesture.
+
+ A sample's features need 'window' samples after it, and deciding whether it's a local extremum
+ another 'window', so segments come out that far behind the finger - getConfirmedTime() says up to
+ when they're final.
+
+	segmenter.reset(trace.getStep(), keyWidth);
+	for each point:
+		trace.addPoint(...);
+		segmenter.update(trace);
+	segmenter.finish(trace);
+ */
+class SwipeSegmenter {
+	SwipeSegmentConfig config;
+	float samplesPerKey = 8;
+	// features of every sample so far - valid for [0, numFeatures)
+	std::vector<float> turnCos2;
+	std::vector<float> msPerStep;
+	int numFeatures = 0;
+	int numDecided = 0;   //< samples checked for being a segment
+	float confirmedTime = 0;
+	std::vector<SwipeSegment> segments;
+
+public:
+	SwipeSegmenter() {}
+
+	SwipeSegmentConfig& getConfig() { return config; }
+
+	/// starts a new gesture, whose trail is sampled every 'step', on keys 'keyWidth' wide
+	void reset(float step, float keyWidth);
+
+	/// looks at the samples that are far enough behind the finger - returns the number of new segments
+	int update(const SwipeResampler& trace);
+	/// ... and at the rest, when the finger has lifted
+	int finish(const SwipeResampler& trace);
+
+	const std::vector<SwipeSegment>& getSegments() const { return segments; }
+	/// the segments before this time (in the trail's ms) won't change
+	float getConfirmedTime() const { return confirmedTime; }
+
+	/**
+	 The features of samples [lo, hi), which must have 'w' samples either side: the signed cos^2 of
+	 the turn, and the ms per sample step.
+	 */
+	static void computeFeatures(const float* xs, const float* ys, const float* ts, int lo, int hi, int w,
+								float* turnCos2, float* msPerStep);
+
+private:
+	void extendFeatures(const SwipeResampler& trace, int numSamples);
+	int decide(const SwipeResampler& trace, int upTo);
+
+	DISALLOW_COPY_AND_ASSIGN(SwipeSegmenter);
+};
+
+#endif
@@ -0,0 +1,349 @@
+#include "SwipeTrace.h"
+#include "TLogging.h"
+#include <math.h>
+#include <string.h>
+
+using namespace std;
+
+// the file: a magic, then varints version and kTraceCoordScale, then records of [type, varint
+// length, payload]
+static const char kTraceMagic[4] = { 'Q', 'T', 'R', 'C' };
+static const uint32_t kTraceVersion = 1;
+static const uint8_t kGestureRecord = 'G';
+static const uint8_t kLayoutRecord = 'L';
+
+#pragma mark - varints
+
+static inline void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+	while (v >= 0x80) {
+		out.push_back((uint8_t)(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back((uint8_t)v);
+}
+
+/// small negative numbers small too
+static inline void putSigned(std::vector<uint8_t>& out, int32_t v) {
+	putVarint(out, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+/// false if it runs past 'end' (or is too long to be one of ours)
+static inline bool getVarint(const uint8_t*& p, const uint8_t* end, uint32_t& v) {
+	v = 0;
+	for (int shift=0; shift<35; shift+=7) {
+		if (p >= end)
+			return false;
+		const uint8_t b = *p++;
+		v |= (uint32_t)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+static inline bool getSigned(const uint8_t*& p, const uint8_t* end, int32_t& v) {
+	uint32_t u;
+	if (!getVarint(p, end, u))
+		return false;
+	v = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+	return true;
+}
+
+static inline int32_t quantise(float coord) {
+	return (int32_t)lroundf(coord * kTraceCoordScale);
+}
+
+#pragma mark - writing
+
+bool SwipeTraceWriter::open(const std::string& path) {
+	close();
+	numWritten = 0;
+	// whatever the file had last, the next gesture says which layout it's for
+	layoutPending = !layout.empty();
+
+	const int existing = TFileReader::fileExists(path) ? TFileReader::fileSize(path) : 0;
+	if (existing > 0) {
+		char magic[sizeof(kTraceMagic)] = {};
+		TFileReader fr(path);
+		if (!fr.isOpen() || fr.read(magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, kTraceMagic, sizeof(magic)) != 0) {
+			TLogError("'%s' isn't a trace corpus", path.c_str());
+			return false;
+		}
+	}
+	file.open(path.c_str(), "ab");
+	if (!file.isOpen()) {
+		TLogError("Can't write the trace corpus '%s'", path.c_str());
+		return false;
+	}
+	if (existing <= 0) {
+		record.assign(kTraceMagic, kTraceMagic + sizeof(kTraceMagic));
+		putVarint(record, kTraceVersion);
+		putVarint(record, kTraceCoordScale);
+		file.write(&record[0], (int)record.size());
+		file.flush();
+	}
+	return true;
+}
+
+void SwipeTraceWriter::setKeyLayout(const KeyLayout& newLayout) {
+	if (newLayout == layout)
+		return;
+	layout = newLayout;
+	layoutPending = true;
+}
+
+/// writes 'record' as the payload of a record of 'type'
+bool SwipeTraceWriter::writeRecord(uint8_t type) {
+	uint8_t head[6] = { type };
+	int headSize = 1;
+	for (uint32_t length = (uint32_t)record.size(); ; length >>= 7) {
+		head[headSize++] = (uint8_t)((length & 0x7f) | (length >= 0x80 ? 0x80 : 0));
+		if (length < 0x80)
+			break;
+	}
+	const bool ok = file.write(head, headSize) == (size_t)headSize &&
+		file.write(&record[0], (int)record.size()) == record.size();
+	file.flush();
+	return ok;
+}
+
+bool SwipeTraceWriter::write(const SwipePoint* points, int count, const char* word) {
+	if (!file.isOpen() || count <= 0)
+		return false;
+
+	if (layoutPending) {
+		// [varint numKeys] then per key [varint key, x, y, w, h]
+		record.clear();
+		putVarint(record, (uint32_t)layout.size());
+		for (int i=0; i<layout.size(); i++) {
+			const SwipeKey& k = layout[i];
+			putVarint(record, (uint32_t)k.key);
+			putSigned(record, quantise(k.x));
+			putSigned(record, quantise(k.y));
+			putSigned(record, quantise(k.w));
+			putSigned(record, quantise(k.h));
+		}
+		if (!writeRecord(kLayoutRecord))
+			return false;
+		layoutPending = false;
+	}
+
+	// [varint numPoints, varint wordLen, word] then the x, y and t deltas, then [varint numRuns]
+	// and runs of [varint key+1, varint length]
+	const int wordLen = (int)strlen(word);
+	record.clear();
+	putVarint(record, (uint32_t)count);
+	putVarint(record, (uint32_t)wordLen);
+	record.insert(record.end(), word, word + wordLen);
+	int32_t last = 0;
+	for (int i=0; i<count; i++) {
+		const int32_t x = quantise(points[i].pPoint.x);
+		putSigned(record, x - last);
+		last = x;
+	}
+	last = 0;
+	for (int i=0; i<count; i++) {
+		const int32_t y = quantise(points[i].pPoint.y);
+		putSigned(record, y - last);
+		last = y;
+	}
+	int64_t lastMs = 0;
+	for (int i=0; i<count; i++) {
+		const int64_t ms = (points[i].pTime - points[0].pTime).asMs();
+		putVarint(record, (uint32_t)TMax(ms - lastMs, (int64_t)0));
+		lastMs = TMax(ms, lastMs);
+	}
+	int numRuns = 0;
+	for (int i=0; i<count; i++)
+		numRuns += (i == 0 || points[i].key != points[i-1].key);
+	putVarint(record, (uint32_t)numRuns);
+	for (int i=0; i<count; ) {
+		int j = i+1;
+		while (j < count && points[j].key == points[i].key)
+			j++;
+		putVarint(record, (uint32_t)(points[i].key + 1));
+		putVarint(record, (uint32_t)(j - i));
+		i = j;
+	}
+	if (!writeRecord(kGestureRecord))
+		return false;
+	numWritten++;
+	return true;
+}
+
+#pragma mark - reading
+
+bool SwipeTraceReader::open(const std::string& path) {
+	close();
+	if (!mapped.open(path))
+		return false;
+	data = (const uint8_t*)mapped.data();
+	const uint8_t* p = data + sizeof(kTraceMagic);
+	const uint8_t* end = data + mapped.size();
+	uint32_t version, scale;
+	if (mapped.size() < sizeof(kTraceMagic) || memcmp(data, kTraceMagic, sizeof(kTraceMagic)) != 0 ||
+		!getVarint(p, end, version) || !getVarint(p, end, scale) || version != kTraceVersion || scale != kTraceCoordScale) {
+		TLogError("Bad trace corpus '%s'", path.c_str());
+		close();
+		return false;
+	}
+	start = at = p - data;
+	return true;
+}
+
+void SwipeTraceReader::close() {
+	mapped.close();
+	data = nullptr;
+	start = at = 0;
+	layouts.clear();
+	layout = nullptr;
+	index.clear();
+}
+
+/// the layouts are kept, so that traces already read (and the index) still point at them
+void SwipeTraceReader::rewind() {
+	at = start;
+	layout = nullptr;
+}
+
+bool SwipeTraceReader::next(SwipeTrace& out) {
+	const uint8_t* end = data + mapped.size();
+	while (data && at < mapped.size()) {
+		const uint8_t* p = data + at;
+		const uint8_t type = *p++;
+		uint32_t length;
+		if (!getVarint(p, end, length) || length > (size_t)(end - p)) {
+			at = mapped.size(); // cut short
+			return false;
+		}
+		at = (p - data) + length;
+		if (type == kGestureRecord) {
+			if (readGesture(p, p + length, layout, out))
+				return true;
+			TLogError("Bad gesture at %d in the trace corpus", (int)(p - data));
+		}
+		else if (type == kLayoutRecord) {
+			if (const KeyLayout* newLayout = readLayout(p, p + length))
+				layout = newLayout;
+			else
+				TLogError("Bad layout at %d in the trace corpus", (int)(p - data));
+		}
+		// anything else is from a later version - skipped
+	}
+	return false;
+}
+
+int SwipeTraceReader::buildIndex() {
+	index.clear();
+	const uint8_t* end = data + mapped.size();
+	const KeyLayout* indexLayout = nullptr;
+	for (size_t offset = start; data && offset < mapped.size(); ) {
+		const uint8_t* p = data + offset;
+		const uint8_t type = *p++;
+		uint32_t length;
+		if (!getVarint(p, end, length) || length > (size_t)(end - p))
+			break; // cut short
+		offset = (p - data) + length;
+		if (type == kGestureRecord) {
+			IndexEntry entry = { (size_t)(p - data), length, indexLayout };
+			index.push_back(entry);
+		}
+		else if (type == kLayoutRecord) {
+			if (const KeyLayout* newLayout = readLayout(p, p + length))
+				indexLayout = newLayout;
+			else
+				TLogError("Bad layout at %d in the trace corpus", (int)(p - data));
+		}
+	}
+	return (int)index.size();
+}
+
+bool SwipeTraceReader::read(int i, SwipeTrace& out) const {
+	if (i < 0 || i >= (int)index.size())
+		return false;
+	const IndexEntry& entry = index[i];
+	const uint8_t* p = data + entry.offset;
+	return readGesture(p, p + entry.length, entry.layout, out);
+}
+
+const KeyLayout* SwipeTraceReader::readLayout(const uint8_t* p, const uint8_t* end) {
+	uint32_t numKeys;
+	if (!getVarint(p, end, numKeys))
+		return nullptr;
+	KeyLayout newLayout;
+	for (uint32_t i=0; i<numKeys; i++) {
+		uint32_t key;
+		int32_t x, y, w, h;
+		if (!getVarint(p, end, key) || !getSigned(p, end, x) || !getSigned(p, end, y) || !getSigned(p, end, w) || !getSigned(p, end, h))
+			return nullptr;
+		const float scale = 1.0f / kTraceCoordScale;
+		newLayout.addKey((int)key, x*scale, y*scale, w*scale, h*scale);
+	}
+	// a corpus switches between a few layouts at most, and is read more than once - only a new one
+	// needs its index built
+	for (auto& known: layouts) {
+		if (known == newLayout)
+			return &known;
+	}
+	newLayout.build();
+	layouts.push_back(newLayout);
+	return &layouts.back();
+}
+
+bool SwipeTraceReader::readGesture(const uint8_t* p, const uint8_t* end, const KeyLayout* gestureLayout, SwipeTrace& out) const {
+	uint32_t count, wordLen;
+	if (!getVarint(p, end, count) || !getVarint(p, end, wordLen) || wordLen > (size_t)(end - p) || count > (size_t)(end - p))
+		return false;
+	out.word.assign((const char*)p, wordLen);
+	p += wordLen;
+	out.layout = gestureLayout;
+	out.points.resize(count);
+
+	const float scale = 1.0f / kTraceCoordScale;
+	int32_t v = 0;
+	for (uint32_t i=0; i<count; i++) {
+		int32_t delta;
+		if (!getSigned(p, end, delta))
+			return false;
+		v += delta;
+		out.points[i].pPoint.x = v * scale;
+	}
+	v = 0;
+	for (uint32_t i=0; i<count; i++) {
+		int32_t delta;
+		if (!getSigned(p, end, delta))
+			return false;
+		v += delta;
+		out.points[i].pPoint.y = v * scale;
+	}
+	int64_t ms = 0;
+	for (uint32_t i=0; i<count; i++) {
+		uint32_t delta;
+		if (!getVarint(p, end, delta))
+			return false;
+		ms += delta;
+		out.points[i].pTime = TDateTime((long)(ms / 1000), (long)(ms % 1000) * 1000);
+	}
+	uint32_t numRuns, done = 0;
+	if (!getVarint(p, end, numRuns))
+		return false;
+	for (uint32_t r=0; r<numRuns; r++) {
+		uint32_t key, length;
+		if (!getVarint(p, end, key) || !getVarint(p, end, length) || length > count - done)
+			return false;
+		for (uint32_t i=0; i<length; i++)
+			out.points[done++].key = (int)key - 1;
+	}
+	if (done != count)
+		return false;
+
+	// the rest as the touch handlers fill it in
+	for (uint32_t i=1; i<count; i++) {
+		SwipePoint& pt = out.points[i];
+		float velocity;
+		int distance;
+		int ms = (int)(pt.pTime - out.points[i-1].pTime).asMs();
+		pt.ComparePointVsLast(out.points[i-1], velocity, distance, ms);
+	}
+	return true;
+}
@@ -0,0 +1,134 @@
+#ifndef _SwipeTrace_h
+#define _SwipeTrace_h
+
+#include "TCommon.h"
+#include "KeyLayout.h"
+#include "SwipePoint.h"
+#include "TFile.h"
+#include "TMappedFile.h"
+#include <deque>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// coordinates are stored in 1/kTraceCoordScale of a point
+static const int kTraceCoordScale = 4;
+
+/// one recorded gesture, as read back from a trace corpus
+struct SwipeTrace {
+	std::vector<SwipePoint> points; //< times from TDateTime(0), with the velocity etc. filled in
+	std::string word;               //< what was committed for it
+	const KeyLayout* layout = nullptr; //< the layout it was swiped on (owned by the reader), nullptr if none was recorded
+};
+
+/**
+ A corpus of recorded gestures, for replaying through the decoder headless (benchmarks, tuning):
+ a file header, then records - a gesture, or a key layout that applies to the gestures after it.
+
+ A gesture is stored a column at a time - all the x deltas, all the y deltas, all the time deltas,
+ then the keys as runs - each as varints, so a typical point takes 3-4 bytes. Coordinates are
+ quantised to 1/kTraceCoordScale of a point and times to the ms, which is all the decoder sees of
+ them anyway. Every record starts with its type and length, so a reader can skip what it doesn't
+ know, and a record cut short by a crash is just the end of the file.
+
+ The writer only ever appends, so one file can collect gestures over many sessions:
+	SwipeTraceWriter recorder;
+	recorder.open(path);
+	recorder.setKeyLayout(layout);
+	recorder.write(points, count, "hello");
+
+ and the reader maps the file and decodes a gesture at a time:
+	SwipeTraceReader corpus;
+	corpus.open(path);
+	SwipeTrace trace;
+	while (corpus.next(trace))
+		decoder.decode(&trace.points[0], (int)trace.points.size(), candidates);
+
+ or, once buildIndex() has found where every gesture starts, any gesture by number - from any
+ number of threads at once (see SwipeBatchDecoder):
+	corpus.buildIndex();
+	corpus.read(i, trace);
+ */
+class SwipeTraceWriter {
+public:
+	SwipeTraceWriter() {}
+
+	/// appends to 'path', creating it if need be - returns false if it can't be written, or isn't a trace corpus
+	bool open(const std::string& path);
+	void close() { file.close(); }
+	bool isOpen() const { return file.isOpen(); }
+
+	/// the layout of the gestures from now on - only written (before the next gesture) if it changed
+	void setKeyLayout(const KeyLayout& layout);
+
+	/// appends a gesture and the word committed for it - returns false if it couldn't be written
+	bool write(const SwipePoint* points, int count, const char* word);
+
+	int gestureCount() const { return numWritten; }
+
+private:
+	TFileWriter file;
+	KeyLayout layout;
+	bool layoutPending = false;
+	int numWritten = 0;
+	std::vector<uint8_t> record; //< scratch, kept between gestures
+
+	bool writeRecord(uint8_t type);
+
+	DISALLOW_COPY_AND_ASSIGN(SwipeTraceWriter);
+};
+
+class SwipeTraceReader {
+public:
+	SwipeTraceReader() {}
+
+	/// maps the corpus - returns false if it can't be read or isn't a trace corpus
+	bool open(const std::string& path);
+	void close();
+	bool isOpen() const { return mapped.isOpen(); }
+
+	/// decodes the next gesture into 'out' (reusing its storage) - returns false at the end
+	bool next(SwipeTrace& out);
+	/// back to the first gesture
+	void rewind();
+
+	/**
+	 Scans the corpus for where every gesture starts, for read() - returns the number of gestures.
+	 Doesn't move next()'s position.
+	 */
+	int buildIndex();
+	int gestureCount() const { return (int)index.size(); }
+	/**
+	 Decodes gesture 'i' (of gestureCount()) into 'out' - returns false if it's out of range or bad.
+	 Only reads the mapped file and the index, so it's safe to call from several threads at once
+	 (each with its own 'out').
+	 */
+	bool read(int i, SwipeTrace& out) const;
+
+	/// bytes of the corpus read so far, and in all
+	size_t position() const { return at; }
+	size_t size() const { return mapped.size(); }
+
+private:
+	TMappedFile mapped;
+	const uint8_t* data = nullptr;
+	size_t start = 0; //< of the first record
+	size_t at = 0;
+	std::deque<KeyLayout> layouts; //< every different one seen - a deque, so the traces can point at them
+	const KeyLayout* layout = nullptr; //< next()'s current one
+	/// a gesture record's payload, and the layout in effect for it
+	struct IndexEntry {
+		size_t offset;
+		uint32_t length;
+		const KeyLayout* layout;
+	};
+	std::vector<IndexEntry> index;
+
+	/// returns the layout (one of 'layouts'), nullptr if it's bad
+	const KeyLayout* readLayout(const uint8_t* p, const uint8_t* end);
+	bool readGesture(const uint8_t* p, const uint8_t* end, const KeyLayout* gestureLayout, SwipeTrace& out) const;
+
+	DISALLOW_COPY_AND_ASSIGN(SwipeTraceReader);
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "SwipeTraceGenerator.h"
+#include <algorithm>
+#include <ctype.h>
+#include <math.h>
+
+using namespace std;
+
+/// spline samples between two keys - plenty for the arc length and for sampling at 60Hz
+static const int kSegmentSamples = 16;
+
+/// minimum jerk: 0 to 1 with zero velocity and acceleration at both ends, as a relaxed reach moves
+static inline float minimumJerk(float f) {
+	return f*f*f * (10 - 15*f + 6*f*f);
+}
+
+static inline float catmullRom(float p0, float p1, float p2, float p3, float t) {
+	return 0.5f * (2*p1 + (p2 - p0)*t + (2*p0 - 5*p1 + 4*p2 - p3)*t*t + (3*p1 - p0 - 3*p2 + p3)*t*t*t);
+}
+
+bool SwipeTraceGenerator::generate(const char* word, int len, std::vector<SwipePoint>& out) {
+	out.clear();
+	if (layout.empty() || len <= 0)
+		return false;
+	const float keyWidth = layout.getKeyWidth();
+
+	// where the finger aims for each key - a double letter is one key, dwelt on for longer
+	aimX.clear();
+	aimY.clear();
+	extraDwell.clear();
+	for (int i=0; i<len; i++) {
+		const int c = tolower((unsigned char)word[i]);
+		if (i > 0 && c == tolower((unsigned char)word[i-1])) {
+			extraDwell.back() += config.doubleDwellMs;
+			continue;
+		}
+		const SwipeKey* key = layout.findKey(c);
+		if (!key)
+			return false;
+		aimX.push_back(key->centreX() + gauss(rng) * config.aimSigma * keyWidth);
+		aimY.push_back(key->centreY() + gauss(rng) * config.aimSigma * keyWidth);
+		extraDwell.push_back(0);
+	}
+	buildPath();
+
+	// the timeline: dwell, move, dwell, ... in ms
+	const float pxPerMs = config.speed * expf(config.speedSigma * gauss(rng)) * keyWidth / 1000.0f;
+	const int numKeys = (int)aimX.size();
+	phases.clear();
+	addPhase(config.startDwellMs + extraDwell[0], 0, 0, false);
+	if (config.profile == kSpeedWhole) {
+		const float total = pathLength.back();
+		if (numKeys > 1)
+			addPhase(TMax(total / pxPerMs, config.minSegmentMs * (numKeys-1)), 0, total, true);
+		addPhase(config.endDwellMs + extraDwell[numKeys-1], total, total, false);
+	}
+	else {
+		for (int k=1; k<numKeys; k++) {
+			const float from = pathLength[(k-1) * kSegmentSamples];
+			const float to = pathLength[k * kSegmentSamples];
+			addPhase(TMax((to - from) / pxPerMs, config.minSegmentMs), from, to, config.profile == kSpeedPerSegment);
+			addPhase(((k == numKeys-1) ? config.endDwellMs : config.dwellMs) + extraDwell[k], to, to, false);
+		}
+		if (numKeys == 1)
+			addPhase(config.endDwellMs, 0, 0, false);
+	}
+
+	// sampled at the event rate, always including the lift
+	const Phase& last = phases.back();
+	const float end = last.start + last.duration;
+	size_t p = 0;
+	for (float ms=0; ; ms+=config.sampleMs) {
+		ms = TMin(ms, end);
+		while (p+1 < phases.size() && ms > phases[p].start + phases[p].duration)
+			p++;
+		const Phase& phase = phases[p];
+		float f = (phase.duration > 0) ? TRange((ms - phase.start) / phase.duration, 0.0f, 1.0f) : 1.0f;
+		if (phase.bell)
+			f = minimumJerk(f);
+		float x, y;
+		pointAt(phase.from + (phase.to - phase.from) * f, x, y);
+		addPoint(x + gauss(rng) * config.jitter * keyWidth, y + gauss(rng) * config.jitter * keyWidth, (int)lroundf(ms), out);
+		if (ms >= end)
+			break;
+	}
+	return true;
+}
+
+void SwipeTraceGenerator::addPhase(float duration, float from, float to, bool bell) {
+	Phase phase;
+	phase.start = phases.empty() ? 0 : phases.back().start + phases.back().duration;
+	phase.duration = duration;
+	phase.from = from;
+	phase.to = to;
+	phase.bell = bell;
+	phases.push_back(phase);
+}
+
+/// the spline through the aim points, kSegmentSamples samples per segment, with the arc length so far
+void SwipeTraceGenerator::buildPath() {
+	const int n = (int)aimX.size();
+	pathX.assign(1, aimX[0]);
+	pathY.assign(1, aimY[0]);
+	pathLength.assign(1, 0.0f);
+	for (int i=0; i+1<n; i++) {
+		// the ends repeat, so the curve starts and ends heading straight for the next key
+		const int i0 = TMax(i-1, 0), i3 = TMin(i+2, n-1);
+		for (int s=1; s<=kSegmentSamples; s++) {
+			const float t = s / (float)kSegmentSamples;
+			const float x = catmullRom(aimX[i0], aimX[i], aimX[i+1], aimX[i3], t);
+			const float y = catmullRom(aimY[i0], aimY[i], aimY[i+1], aimY[i3], t);
+			pathLength.push_back(pathLength.back() + hypotf(x - pathX.back(), y - pathY.back()));
+			pathX.push_back(x);
+			pathY.push_back(y);
+		}
+	}
+}
+
+void SwipeTraceGenerator::pointAt(float distance, float& x, float& y) const {
+	const size_t j = upper_bound(pathLength.begin(), pathLength.end(), distance) - pathLength.begin();
+	if (j == 0 || j >= pathLength.size()) {
+		x = (j == 0) ? pathX.front() : pathX.back();
+		y = (j == 0) ? pathY.front() : pathY.back();
+		return;
+	}
+	const float span = pathLength[j] - pathLength[j-1];
+	const float f = (span > 0) ? (distance - pathLength[j-1]) / span : 0;
+	x = pathX[j-1] + (pathX[j] - pathX[j-1]) * f;
+	y = pathY[j-1] + (pathY[j] - pathY[j-1]) * f;
+}
+
+/// as the touch handlers would record it
+void SwipeTraceGenerator::addPoint(float x, float y, int ms, std::vector<SwipePoint>& out) {
+	SwipePoint point;
+	point.pPoint.x = x;
+	point.pPoint.y = y;
+	point.pTime = TDateTime(ms / 1000, (ms % 1000) * 1000);
+	const SwipeKey* key = layout.keyAt(x, y);
+	point.key = key ? key->key : -1;
+	if (!out.empty()) {
+		float velocity;
+		int distance;
+		int elapsed = ms - (int)out.back().pTime.asMs();
+		point.ComparePointVsLast(out.back(), velocity, distance, elapsed);
+	}
+	out.push_back(point);
+}
@@ -0,0 +1,85 @@
+#ifndef _SwipeTraceGenerator_h
+#define _SwipeTraceGenerator_h
+
+#include "TCommon.h"
+#include "KeyLayout.h"
+#include "SwipePoint.h"
+#include <random>
+#include <stdint.h>
+#include <vector>
+
+/// how the finger's speed varies along the path
+enum SwipeSpeedProfile {
+	kSpeedConstant,   //< the same speed all the way
+	kSpeedPerSegment, //< speeds up and slows down between every two keys (minimum jerk) - the usual careful swipe
+	kSpeedWhole,      //< one minimum jerk movement over the whole path - a fast, sloppy swipe
+};
+
+/// distances are in key widths, so the same config fits any layout
+struct SwipeSynthConfig {
+	SwipeSpeedProfile profile = kSpeedPerSegment;
+	float speed = 20.0f;        //< mean speed while moving, key widths per second
+	float speedSigma = 0.25f;   //< per-gesture spread of the speed (log-normal)
+	float startDwellMs = 60.0f; //< on the first key before moving
+	float dwellMs = 30.0f;      //< on every key in between
+	float doubleDwellMs = 80.0f; //< extra for a double letter, which is swiped as one key
+	float endDwellMs = 40.0f;   //< on the last key before lifting
+	float minSegmentMs = 30.0f; //< even between neighbouring keys
+	float aimSigma = 0.2f;      //< how far from the key centre the finger aims (per key, Gaussian)
+	float jitter = 0.04f;       //< touch noise on every sample (Gaussian)
+	float sampleMs = 16.0f;     //< between touch events - 60Hz
+};
+
+/**
+ Synthesises plausible swipes of words over a KeyLayout, for benchmarks and accuracy tests without
+ a device: the path is a Catmull-Rom spline through the key centres (each one missed by a random
+ aim offset), travelled at a speed profile and sampled at the touch event rate, with a dwell on
+ every key and Gaussian jitter on every sample. Points come out as the touch handlers would make
+ them - key under the finger, velocity etc. filled in - so they can go straight into the decoder or
+ a SwipeTraceWriter.
+
+	SwipeTraceGenerator generator(layout, seed);
+	std::vector<SwipePoint> points;
+	if (generator.generate("hello", 5, points))
+		writer.write(&points[0], (int)points.size(), "hello");
+
+ The same seed always gives the same gestures.
+ */
+class SwipeTraceGenerator {
+public:
+	SwipeTraceGenerator(const KeyLayout& keyLayout, uint32_t seed = 1) : layout(keyLayout), rng(seed) {}
+
+	SwipeSynthConfig& getConfig() { return config; }
+	void setSeed(uint32_t seed) { rng.seed(seed); gauss.reset(); }
+
+	/// replaces 'out' with a gesture for 'word' - returns false if a letter isn't on the layout
+	bool generate(const char* word, int len, std::vector<SwipePoint>& out);
+
+private:
+	const KeyLayout& layout;
+	SwipeSynthConfig config;
+	std::mt19937 rng;
+	std::normal_distribution<float> gauss;
+
+	// the gesture being generated, kept between calls
+	std::vector<float> aimX, aimY;     //< per key swiped (double letters once)
+	std::vector<float> extraDwell;     //< per key
+	std::vector<float> pathX, pathY;   //< along the spline, kSegmentSamples per segment
+	std::vector<float> pathLength;     //< cumulative, per sample
+	/// a stretch of the gesture: from 'from' to 'to' along the path (the same for a dwell)
+	struct Phase {
+		float start, duration;         //< ms
+		float from, to;
+		bool bell;                     //< minimum jerk, rather than constant speed
+	};
+	std::vector<Phase> phases;
+
+	void buildPath();
+	void pointAt(float distance, float& x, float& y) const;
+	void addPhase(float duration, float from, float to, bool bell);
+	void addPoint(float x, float y, int ms, std::vector<SwipePoint>& out);
+
+	DISALLOW_COPY_AND_ASSIGN(SwipeTraceGenerator);
+};
+
+#endif
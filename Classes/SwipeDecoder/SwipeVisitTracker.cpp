@@ -0,0 +1,137 @@
+#include "SwipeVisitTracker.h"
+#include "TLogging.h"
+#include <math.h>
+#include <stdlib.h>
+
+// logs every significant visit - off by default, as a log line costs an allocation and this is on
+// the decoder's hot path
+#ifndef SWIPE_LOG_VISITS
+#	define SWIPE_LOG_VISITS 0
+#endif
+
+// trigrams more likely than this are taken to be a real part of the word (was .000017 on the
+// linear probabilities that came out of the maps)
+static const LogProb kTriLogThreshold = toLogProb(log(0.000017));
+
+bool SwipeVisitTracker::addPoint(const SwipePoint& point, SwipeKeyVisit& visit) {
+	if (numPoints == 0) {
+#if SWIPE_LOG_VISITS
+TLogDebug("CAPTURE LETTERS");
+#endif
+		// setup the first key info, based on what we know
+		nKey = point.key;
+		nTLast = point.pTime.asMs();
+		nMs = 17;
+		nCnt = 1;
+		nFirstKey = -1;
+		nAngleMin = nAngleMax = -1000;
+		nAngleMaxLast = 0;
+		nVelMin = nVelMax = point.fVelocity;
+		nVelMaxLast = 0;
+		fDist = 0;
+		keyPrev2 = -1;
+		keyPrev1 = point.key;
+		numPoints = 1;
+		return false;
+	}
+
+	// not so smart algorithm
+	bool ended = false;
+	if (nKey>=0)
+	{
+		// if we have the same key, then measure how long we have stayed hovering over it
+		if (point.key == nKey) {
+			nMs += (point.pTime.asMs() - nTLast);
+			if (point.fVelocity<nVelMin)
+				nVelMin = point.fVelocity;
+			if (point.fVelocity>nVelMax)
+				nVelMax = point.fVelocity;
+			if (abs(point.nAngle)<abs(nAngleMin))
+				nAngleMin = point.nAngle;
+			if (abs(point.nAngle)>abs(nAngleMax))
+				nAngleMax = point.nAngle;
+			fDist += point.fDist;
+			nCnt++;
+		}
+		else {
+
+			// this algorithm is wrong for predicting what should
+			// be, but it shows us the p of what we captured
+
+
+			char c1 = ' ', c2 = ' ', c3 = ' ';
+			LogProb bi = 0;
+			LogProb tri = bi;
+			if (numPoints>1)
+			{
+				c1 = static_cast<char>(keyPrev2);
+				c2 = static_cast<char>(keyPrev1);
+				c3 = static_cast<char>(point.key);
+				tri = charLM.logProb3(c1, c2, c3);
+				bi = charLM.logProb2(c1, c2);
+			}
+
+			int nAbsAngleMaxDiff = abs(nAngleMax - nAngleMaxLast);
+			// OK so we are grabbing this swipe minus 1
+			visit = SwipeKeyVisit();
+			visit.fVelocity = nVelMaxLast;
+			// angle was originally determined as the angle of the line from last to current
+			// there is probably a lot more we could do with this analysis of angle to make
+			// this metric more useful - right now we are looking for angle least not angle max
+			// for example
+			visit.nAngle = nAbsAngleMaxDiff;
+			visit.nCnt = nCnt;
+			visit.nMs = nMs;
+			visit.key = nKey;
+			visit.fDist = fDist;
+			visit.significant =
+				(nFirstKey==-1) ||
+				((tri>kTriLogThreshold) && (nCnt>1)) ||
+				(nMs>100) ||
+				((tri>kTriLogThreshold) && (nMs>37) && ((nAbsAngleMaxDiff>45) && (nAbsAngleMaxDiff<360)));
+			if (visit.significant)
+			{
+				nFirstKey = nKey;
+#if SWIPE_LOG_VISITS
+TLogDebug("char:%c #:%d ms:%d >:%d bi:%f:%c%c tri:%f:%c%c%c ", static_cast<char>(visit.key), visit.nCnt, visit.nMs, visit.nAngle, logScoreToFloat(bi), c1, c2, logScoreToFloat(tri), c1, c2, c3);
+TLogDebug("vel:%d dist:%d", (int)visit.fVelocity, (int)visit.fDist);
+#endif
+			}
+			ended = true;
+			nAngleMaxLast = nAngleMax;
+			nVelMaxLast = nVelMax;
+			nAngleMin = nAngleMax = point.nAngle;
+			nVelMin = nVelMax = point.fVelocity;
+			nMs = 0;
+			nCnt = 0;
+			fDist = 0;
+		}
+	}
+	nKey = point.key;
+	nTLast = point.pTime.asMs();
+	keyPrev2 = keyPrev1;
+	keyPrev1 = point.key;
+	numPoints++;
+	return ended;
+}
+
+bool SwipeVisitTracker::finish(SwipeKeyVisit& visit) {
+	if (numPoints == 0 || nKey < 0)
+		return false;
+
+	visit = SwipeKeyVisit();
+	visit.key = nKey;
+	if (numPoints == 1)
+		return true; // a tap - nothing to measure
+
+	// get last key - always a visit (the word has to end there), but only significant if we
+	// actually stayed on it
+	// (this used to read one past the end of the trail)
+	visit.fVelocity = nVelMin;
+	visit.nAngle = nAngleMin;
+	visit.nCnt = nCnt;
+	visit.nMs = nMs;
+	visit.fDist = fDist;
+	visit.significant = (nCnt && nMs);
+	return true;
+}
@@ -0,0 +1,80 @@
+#ifndef _SwipeVisitTracker_h
+#define _SwipeVisitTracker_h
+
+#include "TCommon.h"
+#include "CharLM.h"
+#include "SwipePoint.h"
+
+static const int kMaxVisitAlts = 3;
+
+/// another key a visit could have been meant for, 'cost' nats less likely than the one visited
+struct SwipeKeyAlt {
+	int key;
+	float cost;
+};
+
+/**
+ One stay of the finger on a key - the run of consecutive points over the same key, summarised.
+ 'significant' is the old key-run heuristic's verdict (long dwell, a turn, or a likely trigram).
+ SwipeDecoder replaces it with whether the SwipeSegmenter found a corner or a dwell on the key,
+ and the beam search treats those as expensive to skip.
+
+ 'alts' are the neighbouring keys the touch model (see TouchModel) says were nearly as likely -
+ only filled in when the decoder has a key layout.
+ */
+struct SwipeKeyVisit {
+	int key = -1;
+	int nMs = 0;
+	int nCnt = 0;
+	int nAngle = 0;
+	float fVelocity = 0;
+	float fDist = 0;
+	bool significant = false;
+	int numAlts = 0;
+	SwipeKeyAlt alts[kMaxVisitAlts];
+};
+
+/**
+ Turns the trail into key visits one point at a time, so that it can be fed straight from the
+ touch handlers - a visit is complete as soon as the finger moves onto another key.
+
+	tracker.reset();
+	for each point:
+		if(tracker.addPoint(point, visit)) ... // 'visit' just ended
+	if(tracker.finish(visit)) ... // the key the finger lifted on
+ */
+class SwipeVisitTracker {
+	const CharLM& charLM;
+
+	int numPoints = 0;
+	int keyPrev2 = -1; //< keys of the last two points, for the trigram check
+	int keyPrev1 = -1;
+
+	int nKey = -1;
+	int nTLast = 0;
+	int nMs = 0;
+	int nCnt = 0;
+	int nFirstKey = -1;
+	int nAngleMin = 0, nAngleMax = 0;
+	int nAngleMaxLast = 0;
+	float nVelMin = 0, nVelMax = 0;
+	float nVelMaxLast = 0;
+	float fDist = 0;
+
+public:
+	SwipeVisitTracker(const CharLM& lm) : charLM(lm) {}
+
+	void reset() { numPoints = 0; }
+	int pointCount() const { return numPoints; }
+
+	/// returns true if 'point' ended a visit, which is then filled into 'visit'
+	bool addPoint(const SwipePoint& point, SwipeKeyVisit& visit);
+
+	/// the visit in progress when the finger lifted - returns false if it wasn't on a key
+	bool finish(SwipeKeyVisit& visit);
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(SwipeVisitTracker);
+};
+
+#endif
@@ -0,0 +1,137 @@
+#include "TouchModel.h"
+#include "SwipeVisitTracker.h"
+#include "TLogging.h"
+#include <math.h>
+
+#pragma mark - TouchModel
+
+bool TouchModel::build(const KeyLayout& layout) {
+	clear();
+	const int numKeys = layout.size();
+	if (numKeys == 0 || layout.getKeyWidth() <= 0)
+		return false;
+
+	// the keys plus a margin, so that touches just off the edge still get a spread
+	const float margin = layout.getKeyWidth();
+	float x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+	for (int k=0; k<numKeys; k++) {
+		const SwipeKey& key = layout[k];
+		x0 = TMin(x0, key.x);
+		y0 = TMin(y0, key.y);
+		x1 = TMax(x1, key.x + key.w);
+		y1 = TMax(y1, key.y + key.h);
+	}
+	cellSize = layout.getKeyWidth() / TMax(config.cellsPerKey, 1);
+	gridX = x0 - margin;
+	gridY = y0 - margin;
+	gridCols = (int)ceilf((x1 - x0 + 2*margin) / cellSize);
+	gridRows = (int)ceilf((y1 - y0 + 2*margin) / cellSize);
+	cells.resize(gridCols * gridRows);
+
+	// per key: centre, 1/(2 sigma^2) and the normalising term of its Gaussian
+	std::vector<float> cx(numKeys), cy(numKeys), ax(numKeys), ay(numKeys), norm(numKeys);
+	for (int k=0; k<numKeys; k++) {
+		const SwipeKey& key = layout[k];
+		float sx = TMax(config.sigma * key.w, 1e-3f);
+		float sy = TMax(config.sigma * key.h, 1e-3f);
+		cx[k] = key.centreX();
+		cy[k] = key.centreY();
+		ax[k] = 0.5f / (sx*sx);
+		ay[k] = 0.5f / (sy*sy);
+		norm[k] = -logf(sx * sy);
+	}
+
+	std::vector<float> logL(numKeys);
+	for (int r=0; r<gridRows; r++) {
+		for (int c=0; c<gridCols; c++) {
+			const float px = gridX + (c + 0.5f) * cellSize;
+			const float py = gridY + (r + 0.5f) * cellSize;
+			float best = -INFINITY;
+			for (int k=0; k<numKeys; k++) {
+				float dx = px - cx[k], dy = py - cy[k];
+				logL[k] = norm[k] - ax[k]*dx*dx - ay[k]*dy*dy;
+				best = TMax(best, logL[k]);
+			}
+			float sum = 0;
+			for (int k=0; k<numKeys; k++)
+				sum += expf(logL[k] - best);
+			const float logTotal = best + logf(sum);
+
+			// insertion into the cell's top list, cheapest first
+			TouchKeys& cell = cells[r*gridCols + c];
+			float topCost[kTouchTopK];
+			int n = 0;
+			for (int k=0; k<numKeys; k++) {
+				float cost = logTotal - logL[k];
+				if (n == kTouchTopK && cost >= topCost[n-1])
+					continue;
+				int i = (n < kTouchTopK) ? n++ : n-1;
+				for (; i>0 && topCost[i-1] > cost; i--) {
+					topCost[i] = topCost[i-1];
+					cell.key[i] = cell.key[i-1];
+				}
+				topCost[i] = cost;
+				cell.key[i] = (uint8_t)layout[k].key;
+			}
+			for (int i=0; i<kTouchTopK; i++) {
+				if (i < n) {
+					cell.cost[i] = (uint8_t)TMin(lroundf(topCost[i] * kTouchCostScale), 255L);
+				}
+				else {
+					cell.key[i] = 0;
+					cell.cost[i] = 255;
+				}
+			}
+		}
+	}
+	TLogDebug("Touch model: %dx%d cells for %d keys", gridCols, gridRows, numKeys);
+	return true;
+}
+
+#pragma mark - TouchRun
+
+void TouchRun::add(const TouchKeys& touch) {
+	for (int i=0; i<kTouchTopK && touch.key[i]; i++) {
+		int k = 0;
+		while (k < numKeys && keys[k] != touch.key[i])
+			k++;
+		if (k == numKeys) {
+			if (numKeys == kMaxKeys)
+				continue;
+			keys[k] = touch.key[i];
+			best[k] = touch.cost[i];
+			numKeys++;
+		}
+		else {
+			best[k] = TMin(best[k], touch.cost[i]);
+		}
+	}
+}
+
+void TouchRun::fillAlternatives(SwipeKeyVisit& visit, float maxCost) const {
+	visit.numAlts = 0;
+	// the visited key's own cost is the baseline - it's usually the best, but not always
+	float own = 0;
+	for (int k=0; k<numKeys; k++) {
+		if (keys[k] == visit.key)
+			own = TouchModel::costOf(best[k]);
+	}
+	for (int k=0; k<numKeys; k++) {
+		float cost = TMax(TouchModel::costOf(best[k]) - own, 0.0f);
+		if (keys[k] == visit.key || cost > maxCost)
+			continue;
+		// insert, cheapest first, dropping the most expensive if full
+		int n = visit.numAlts;
+		if (n == kMaxVisitAlts) {
+			if (cost >= visit.alts[n-1].cost)
+				continue;
+			n--;
+		}
+		int i = n;
+		for (; i>0 && visit.alts[i-1].cost > cost; i--)
+			visit.alts[i] = visit.alts[i-1];
+		visit.alts[i].key = keys[k];
+		visit.alts[i].cost = cost;
+		visit.numAlts = n+1;
+	}
+}
@@ -0,0 +1,92 @@
+#ifndef _TouchModel_h
+#define _TouchModel_h
+
+#include "TCommon.h"
+#include "KeyLayout.h"
+#include <stdint.h>
+#include <vector>
+
+static const int kTouchTopK = 4;
+
+/**
+ The keys a touch at some point was most likely meant for: up to kTouchTopK characters (0 for none),
+ best first, each with its cost -log P(key | point) in steps of 1/kTouchCostScale nats. 8 bytes, so
+ a lookup is one memory fetch.
+ */
+struct TouchKeys {
+	uint8_t key[kTouchTopK];
+	uint8_t cost[kTouchTopK];
+};
+
+/// TouchKeys::cost units per nat - so costs go up to 255/16 ~ 16 nats
+static const float kTouchCostScale = 16.0f;
+
+struct TouchModelConfig {
+	float sigma = 0.5f;   //< spread of the touches around a key's centre, in key widths (x) / heights (y)
+	int cellsPerKey = 4;  //< grid resolution, in cells per (average) key width
+};
+
+/**
+ Where the finger lands when it means a key: every key is a 2D Gaussian around its centre, scaled to
+ its size, and a point's distribution over the keys is their posterior (equal priors).
+
+ All of that is evaluated once per layout, into a grid covering the keys (plus a margin of one key
+ width) that stores each cell's top kTouchTopK keys. A point outside the grid uses the nearest cell.
+ */
+class TouchModel {
+	TouchModelConfig config;
+	float gridX = 0, gridY = 0;
+	float cellSize = 1;
+	int gridCols = 0, gridRows = 0;
+	std::vector<TouchKeys> cells;
+
+public:
+	TouchModel() {}
+
+	void clear() { cells.clear(); gridCols = gridRows = 0; }
+	bool empty() const { return cells.empty(); }
+
+	/// returns false (and leaves the model empty) if the layout has no keys
+	bool build(const KeyLayout& layout);
+
+	TouchModelConfig& getConfig() { return config; }
+
+	const TouchKeys& lookup(float px, float py) const {
+		int c = (int)((px - gridX) / cellSize);
+		int r = (int)((py - gridY) / cellSize);
+		c = TRange(c, 0, gridCols-1);
+		r = TRange(r, 0, gridRows-1);
+		return cells[r*gridCols + c];
+	}
+
+	static float costOf(uint8_t cost) { return cost / kTouchCostScale; }
+
+private:
+	DISALLOW_COPY_AND_ASSIGN(TouchModel);
+};
+
+struct SwipeKeyVisit;
+
+/**
+ Follows the touch model's costs over the points of one key visit, to work out which other keys it
+ could have been meant for. A key's cost for the visit is its cost at the point where the finger came
+ closest to it.
+ */
+class TouchRun {
+	static const int kMaxKeys = 8;
+	int numKeys = 0;
+	int keys[kMaxKeys];
+	uint8_t best[kMaxKeys];
+
+public:
+	void reset() { numKeys = 0; }
+	void add(const TouchKeys& touch);
+
+	/**
+	 Fills in visit.alts with the other keys whose cost is at most 'maxCost' nats more than visit.key's,
+	 cheapest first.
+	 */
+	void fillAlternatives(SwipeKeyVisit& visit, float maxCost) const;
+};
+
+#endif
@@ -0,0 +1,471 @@
+#include "UserDictionary.h"
+#include "TLogging.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace std;
+
+// the log: a magic, then records of [op, length, letters] - op is kLearn or kForget
+static const char kLogMagic[4] = { 'Q', 'U', 'L', 'G' };
+static const char kLearn = '+';
+static const char kForget = '-';
+
+// the snapshot: a header, then entries of [uint32 count, length, letters]
+struct UserSnapshotHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t generation; //< the logs up to this one are in it
+	uint32_t numEntries;
+};
+static const char kSnapshotMagic[4] = { 'Q', 'U', 'S', 'R' };
+static const uint32_t kSnapshotVersion = 1;
+
+UserDictionary::~UserDictionary() {
+	close();
+	// before the members it uses go
+	compactThread.signalAndWaitForStop();
+}
+
+void UserDictionary::close() {
+	waitForCompaction();
+	log.close();
+}
+
+LogProb UserDictionary::priorOf(uint32_t count) const {
+	if (count == 0)
+		return kMinLogProb;
+	return toLogProb(TMin((double)config.maxLogPrior, config.logPriorOfOne + ::log((double)count)));
+}
+
+/// lowercases 'word' into 'out' - false if the lexicon couldn't hold it
+bool UserDictionary::normalise(const char* word, int len, std::string& out) const {
+	if (len <= 0 || len > Lexicon::kMaxWordLen)
+		return false;
+	out.resize(len);
+	for (int i=0; i<len; i++) {
+		out[i] = (char)tolower((unsigned char)word[i]);
+		if (lexicon.letterIndex((unsigned char)out[i]) >= Lexicon::kMaxLetters)
+			return false;
+	}
+	return true;
+}
+
+bool UserDictionary::learn(const char* word, int len) {
+	string w;
+	if (!normalise(word, len, w))
+		return false;
+	setCount(w, countOf(w) + 1);
+	append(kLearn, w);
+	return true;
+}
+
+bool UserDictionary::forget(const char* word, int len) {
+	string w;
+	if (!normalise(word, len, w) || countOf(w) == 0)
+		return false;
+	setCount(w, 0);
+	append(kForget, w);
+	return true;
+}
+
+int UserDictionary::count(const char* word, int len) const {
+	string w;
+	if (!normalise(word, len, w))
+		return 0;
+	return (int)countOf(w);
+}
+
+int UserDictionary::word(uint32_t wordId, char* out) const {
+	if (wordId < numLexWords || wordId - numLexWords >= userWords.size()) {
+		out[0] = 0;
+		return 0;
+	}
+	const string& w = userWords[wordId - numLexWords];
+	memcpy(out, w.c_str(), w.size() + 1);
+	return (int)w.size();
+}
+
+#pragma mark - the counts and the overlay
+
+/// forgets everything learned, and starts over on the lexicon as it is now
+void UserDictionary::reset() {
+	numLexNodes = (uint32_t)lexicon.nodeCount();
+	numLexWords = (uint32_t)lexicon.wordCount();
+	lexCounts.clear();
+	boosted.clear();
+	numLearned = 0;
+	detached.clear();
+	isDetached = false;
+	nodes.clear();
+	children.clear();
+	userWords.clear();
+	userCounts.clear();
+	userPriors.clear();
+	Node root = { 0, kNoWord, kMinLogProb };
+	nodes.push_back(root);
+	children.resize(Lexicon::kMaxLetters, -1);
+}
+
+void UserDictionary::detach() {
+	if (isDetached)
+		return;
+	detached.clear();
+	collect(detached);
+	isDetached = true;
+}
+
+void UserDictionary::rebuild() {
+	vector<pair<string, uint32_t> > entries;
+	if (isDetached)
+		entries.swap(detached);
+	else
+		collect(entries);
+	reset();
+	for (auto& e: entries)
+		setCount(e.first, e.second);
+}
+
+/// every learned word and its count - from the lexicon's ids back to words, for the files
+void UserDictionary::collect(std::vector<std::pair<std::string, uint32_t> >& out) const {
+	if (isDetached) {
+		out = detached;
+		return;
+	}
+	for (uint32_t id=0; id<lexCounts.size(); id++) {
+		if (lexCounts[id] > 0)
+			out.push_back(make_pair(lexicon.word(id), lexCounts[id]));
+	}
+	for (size_t i=0; i<userWords.size(); i++)
+		out.push_back(make_pair(userWords[i], userCounts[i]));
+}
+
+uint32_t UserDictionary::countOf(const std::string& word) const {
+	const int wordId = lexicon.lookup(word.c_str(), (int)word.size());
+	if (wordId >= 0 && (uint32_t)wordId < numLexWords)
+		return lexCounts.empty() ? 0 : lexCounts[wordId];
+	const int32_t n = overlayNode(word);
+	return (n >= 0 && nodes[n].wordId != kNoWord) ? userCounts[nodes[n].wordId - numLexWords] : 0;
+}
+
+/// the user typed 'word' 'count' times (0 to forget it) - a lexicon word's count and prior go in by
+/// its id, anything else in the overlay
+void UserDictionary::setCount(const std::string& word, uint32_t count) {
+	if (nodes.empty())
+		reset(); // the first word since it was made
+	const int wordId = lexicon.lookup(word.c_str(), (int)word.size());
+	if (wordId >= 0 && (uint32_t)wordId < numLexWords) {
+		if (lexCounts.empty()) {
+			lexCounts.resize(numLexWords, 0);
+			boosted.resize(numLexWords, kMinLogProb);
+		}
+		numLearned += (count > 0) - (lexCounts[wordId] > 0);
+		lexCounts[wordId] = count;
+		boosted[wordId] = priorOf(count);
+	}
+	else if (count > 0) {
+		addToOverlay(word, count);
+	}
+	else {
+		removeFromOverlay(word);
+	}
+}
+
+/// the overlay node that spells 'word', -1 if there's none
+int32_t UserDictionary::overlayNode(const std::string& word) const {
+	if (nodes.empty())
+		return -1;
+	int32_t n = 0;
+	for (char c: word) {
+		const int letter = lexicon.letterIndex((unsigned char)c);
+		if (letter >= Lexicon::kMaxLetters)
+			return -1;
+		n = children[n*Lexicon::kMaxLetters + letter];
+		if (n < 0)
+			return -1;
+	}
+	return n;
+}
+
+void UserDictionary::addToOverlay(const std::string& word, uint32_t count) {
+	const LogProb prior = priorOf(count);
+	int32_t n = 0;
+	nodes[0].maxLogPrior = TMax(nodes[0].maxLogPrior, prior);
+	for (char c: word) {
+		const int letter = lexicon.letterIndex((unsigned char)c);
+		int32_t next = children[n*Lexicon::kMaxLetters + letter];
+		if (next < 0) {
+			next = (int32_t)nodes.size();
+			Node node = { 0, kNoWord, kMinLogProb };
+			nodes.push_back(node);
+			children.resize(children.size() + Lexicon::kMaxLetters, -1);
+			children[n*Lexicon::kMaxLetters + letter] = next;
+			nodes[n].childMask |= 1u << letter;
+		}
+		n = next;
+		nodes[n].maxLogPrior = TMax(nodes[n].maxLogPrior, prior);
+	}
+	if (nodes[n].wordId == kNoWord) {
+		nodes[n].wordId = numLexWords + (uint32_t)userWords.size();
+		userWords.push_back(word);
+		userCounts.push_back(count);
+		userPriors.push_back(prior);
+		numLearned++;
+	}
+	else {
+		userCounts[nodes[n].wordId - numLexWords] = count;
+		userPriors[nodes[n].wordId - numLexWords] = prior;
+	}
+}
+
+/// takes a new word out of the overlay's trie - and out of the best priors above it - which is
+/// simplest done by building the trie again from the rest
+void UserDictionary::removeFromOverlay(const std::string& word) {
+	const int32_t n = overlayNode(word);
+	if (n < 0 || nodes[n].wordId == kNoWord)
+		return;
+	const uint32_t gone = nodes[n].wordId - numLexWords;
+	vector<string> words;
+	vector<uint32_t> counts;
+	words.swap(userWords);
+	counts.swap(userCounts);
+	userPriors.clear();
+	numLearned -= (int)words.size();
+	nodes.resize(1);
+	nodes[0].childMask = 0;
+	nodes[0].maxLogPrior = kMinLogProb;
+	children.assign(Lexicon::kMaxLetters, -1);
+	for (uint32_t i=0; i<words.size(); i++) {
+		if (i != gone)
+			addToOverlay(words[i], counts[i]);
+	}
+}
+
+#pragma mark - persistence
+
+std::string UserDictionary::logPath(uint32_t gen) const {
+	char name[32];
+	snprintf(name, sizeof(name), "/user.%u.log", gen);
+	return dir + name;
+}
+
+bool UserDictionary::open(const std::string& directory) {
+	close();
+	dir = directory;
+	reset();
+
+	uint32_t snapshotGeneration = 0;
+	readSnapshot(snapshotPath(), snapshotGeneration);
+	// the logs since - consecutive generations, each created when the previous one was rotated
+	generation = snapshotGeneration + 1;
+	logRecords = 0;
+	bool intact = true;
+	for (uint32_t gen = snapshotGeneration + 1; TFileReader::fileExists(logPath(gen)); gen++) {
+		generation = gen;
+		intact = replay(logPath(gen));
+	}
+	// records appended after a torn one would never be read back (or worse, be read as part of it) -
+	// so they go in a new log
+	if (!intact) {
+		TLogError("User dictionary log '%s' was cut short - starting another", logPath(generation).c_str());
+		generation++;
+		logRecords = 0;
+	}
+
+	const bool exists = TFileReader::fileExists(logPath(generation));
+	log.open(logPath(generation).c_str(), "ab");
+	if (!log.isOpen()) {
+		TLogError("Can't write the user dictionary log '%s'", logPath(generation).c_str());
+		return false;
+	}
+	if (!exists) {
+		log.write(kLogMagic, sizeof(kLogMagic));
+		log.flush();
+	}
+
+	if (!compactThread.started) {
+		compactThread.go([this](std::function<bool()> needToStop) {
+			runCompaction(needToStop);
+		}, TThreadI::kLowPriority, false);
+	}
+	TLogDebug("User dictionary: %d words (%d new) from '%s', %d log records", size(), newWordCount(), dir.c_str(), logRecords);
+	return true;
+}
+
+bool UserDictionary::append(char op, const std::string& word) {
+	if (!log.isOpen())
+		return false;
+	uint8_t record[2 + Lexicon::kMaxWordLen];
+	record[0] = (uint8_t)op;
+	record[1] = (uint8_t)word.size();
+	memcpy(record + 2, word.c_str(), word.size());
+	const bool ok = log.write(record, 2 + (int)word.size()) == 2 + word.size();
+	log.flush();
+	if (++logRecords >= config.compactAfter)
+		compact();
+	return ok;
+}
+
+static bool readFile(const std::string& path, std::vector<uint8_t>& out) {
+	TFileReader fr(path);
+	if (!fr.isOpen())
+		return false;
+	const int size = fr.fileSize();
+	out.resize(TMax(size, 0));
+	return size <= 0 || fr.read(&out[0], size) == (size_t)size;
+}
+
+/// applies a log's records - stops at the first incomplete one (the app died writing it), returning false
+bool UserDictionary::replay(const std::string& path) {
+	vector<uint8_t> data;
+	if (!readFile(path, data) || data.size() < sizeof(kLogMagic) || memcmp(&data[0], kLogMagic, sizeof(kLogMagic)) != 0) {
+		TLogError("Bad user dictionary log '%s'", path.c_str());
+		return false;
+	}
+	size_t at = sizeof(kLogMagic);
+	logRecords = 0;
+	while (at + 2 <= data.size()) {
+		const char op = (char)data[at];
+		const size_t len = data[at+1];
+		if (at + 2 + len > data.size() || len == 0 || len > Lexicon::kMaxWordLen)
+			break;
+		const string word((const char*)&data[at+2], len);
+		if (op == kLearn)
+			setCount(word, countOf(word) + 1);
+		else if (op == kForget)
+			setCount(word, 0);
+		else
+			break;
+		at += 2 + len;
+		logRecords++;
+	}
+	return at == data.size();
+}
+
+bool UserDictionary::readSnapshot(const std::string& path, uint32_t& snapshotGeneration) {
+	snapshotGeneration = 0;
+	vector<uint8_t> data;
+	if (!readFile(path, data))
+		return false; // none yet
+	UserSnapshotHeader h;
+	if (data.size() < sizeof(h))
+		return false;
+	memcpy(&h, &data[0], sizeof(h));
+	if (memcmp(h.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 || h.version != kSnapshotVersion) {
+		TLogError("Bad user dictionary '%s'", path.c_str());
+		return false;
+	}
+	size_t at = sizeof(h);
+	for (uint32_t i=0; i<h.numEntries; i++) {
+		uint32_t count;
+		if (at + sizeof(count) + 1 > data.size())
+			return false;
+		memcpy(&count, &data[at], sizeof(count));
+		const size_t len = data[at + sizeof(count)];
+		at += sizeof(count) + 1;
+		if (at + len > data.size())
+			return false;
+		setCount(string((const char*)&data[at], len), count);
+		at += len;
+	}
+	snapshotGeneration = h.generation;
+	return true;
+}
+
+bool UserDictionary::writeSnapshot(const std::string& path, const std::vector<std::pair<std::string, uint32_t> >& entries,
+								   uint32_t generation) {
+	TFileWriter fw(path);
+	if (!fw.isOpen())
+		return false;
+	UserSnapshotHeader h = {};
+	memcpy(h.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+	h.version = kSnapshotVersion;
+	h.generation = generation;
+	h.numEntries = (uint32_t)entries.size();
+	size_t expected = sizeof(h);
+	size_t written = fw.write(&h, sizeof(h));
+	for (auto& e: entries) {
+		const uint8_t len = (uint8_t)e.first.size();
+		written += fw.write(&e.second, sizeof(e.second));
+		written += fw.write(&len, 1);
+		written += fw.write(e.first.c_str(), len);
+		expected += sizeof(e.second) + 1 + len;
+	}
+	fw.flush();
+	return written == expected;
+}
+
+#pragma mark - compaction
+
+bool UserDictionary::compact() {
+	if (!log.isOpen())
+		return false;
+	{
+		LockNR l(compactThread.conditionMutex);
+		if (writing)
+			return false;
+		writing = true;
+	}
+
+	// everything up to the current log goes in the snapshot, anything from now on in a new log
+	const uint32_t compacted = generation;
+	log.close();
+	generation++;
+	logRecords = 0;
+	log.open(logPath(generation).c_str(), "ab");
+	if (log.isOpen()) {
+		log.write(kLogMagic, sizeof(kLogMagic));
+		log.flush();
+	}
+	else {
+		TLogError("Can't write the user dictionary log '%s'", logPath(generation).c_str());
+	}
+
+	vector<pair<string, uint32_t> > entries;
+	collect(entries);
+	LockNR l(compactThread.conditionMutex);
+	toWrite.swap(entries);
+	toWriteGeneration = compacted;
+	requested++;
+	compactThread.condition.notifyOne();
+	return true;
+}
+
+void UserDictionary::waitForCompaction() {
+	LockNR l(compactThread.conditionMutex);
+	idle.wait(l, [this]() { return !writing; });
+}
+
+/// the compaction thread: writes each snapshot it's handed, then drops the logs it replaces
+void UserDictionary::runCompaction(std::function<bool()> needToStop) {
+	int seen = 0;
+	for (;;) {
+		vector<pair<string, uint32_t> > entries;
+		uint32_t gen;
+		{
+			LockNR l(compactThread.conditionMutex);
+			compactThread.condition.wait(l, [&]() { return needToStop() || requested != seen; });
+			if (needToStop())
+				return;
+			seen = requested;
+			entries.swap(toWrite);
+			gen = toWriteGeneration;
+		}
+
+		// written aside and renamed over the old one, so there's always a complete snapshot
+		const string tmp = snapshotPath() + ".tmp";
+		if (writeSnapshot(tmp, entries, gen) && rename(tmp.c_str(), snapshotPath().c_str()) == 0) {
+			for (uint32_t g = gen; g > 0 && TFileReader::fileExists(logPath(g)); g--)
+				TDirectory::deleteFile(logPath(g));
+			TLogDebug("User dictionary: compacted %d words up to log %u", (int)entries.size(), gen);
+		}
+		else {
+			TLogError("Failed to write the user dictionary '%s'", snapshotPath().c_str());
+		}
+
+		LockNR l(compactThread.conditionMutex);
+		writing = false;
+		idle.notifyAll();
+	}
+}
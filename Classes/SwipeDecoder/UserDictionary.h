@@ -0,0 +1,177 @@
+#ifndef _UserDictionary_h
+#define _UserDictionary_h
+
+#include "TCommon.h"
+#include "Lexicon.h"
+#include "LogProb.h"
+#include "TCondition.h"
+#include "TFile.h"
+#include "TThreadI.h"
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct UserDictionaryConfig {
+	float logPriorOfOne = -11.0f; //< prior of a word the user has typed once - then + log(count)
+	float maxLogPrior = -5.0f;    //< ... up to this
+	int compactAfter = 256;       //< log records before the log is folded into the snapshot
+};
+
+/**
+ The words the user has typed, layered over the (read-only, maybe mapped) lexicon without changing
+ it: words the lexicon already has get a prior from how often the user typed them, if that's
+ higher than their own, and new words go into a small trie of their own that the beam search walks
+ alongside the lexicon's.
+
+ The overlay uses the same LexCursor as the lexicon: its nodes are numbered after the lexicon's
+ (from lexicon.nodeCount()) and its words after the lexicon's (from lexicon.wordCount()), so a
+ cursor says by itself which trie it's in, and learned words have ids that can't clash. What the
+ user typed is counted by those ids too - a flat array over the lexicon's words, found through its
+ word hash (Lexicon::lookup()), and one over the overlay's - so learning a word is a hash lookup
+ (plus a walk of the small overlay trie for a new word) and one appended record.
+
+ The ids are only good for one lexicon: before loading another, detach() keeps the learned words
+ as words, and rebuild() looks them up again in the new one.
+
+ Persistence is a snapshot (user.dict) plus an append-only log of what was learned since
+ (user.<generation>.log), both in 'dir'. Every compactAfter records the log is rotated and a
+ background thread folds everything up to it into a new snapshot, then deletes it - so startup
+ reads the snapshot and replays only the logs newer than it. A crash at any point loses at most the
+ record being written.
+
+	UserDictionary user(lexicon);
+	user.open(documentsDir);
+	user.learn("quicktext", 9);
+ */
+class UserDictionary {
+public:
+	static const uint32_t kNoWord = 0xffffffff;
+
+	UserDictionary(const Lexicon& lex) : lexicon(lex) {}
+	~UserDictionary();
+
+	UserDictionaryConfig& getConfig() { return config; }
+
+	/// loads the snapshot and replays the logs in 'dir', and appends to the latest - returns false if it can't be written to
+	bool open(const std::string& dir);
+	/// stops writing (after any compaction in progress) - what was learned stays in memory
+	void close();
+	bool isOpen() const { return log.isOpen(); }
+
+	/// the user typed 'word' (once more) - returns false if the lexicon can't hold it
+	bool learn(const char* word, int len);
+	/// ... or wants it gone - returns false if it wasn't learned. The other new words' overlay ids can change.
+	bool forget(const char* word, int len);
+	/// times the user typed 'word', 0 if never (or forgotten)
+	int count(const char* word, int len) const;
+
+	/// learned words, including ones the lexicon has
+	int size() const { return numLearned; }
+	/// learned words that the lexicon doesn't have
+	int newWordCount() const { return (int)userWords.size(); }
+	bool hasNewWords() const { return !userWords.empty(); }
+
+	/// the lexicon is about to change - keeps the learned words (as words) for rebuild()
+	void detach();
+	/// looks the learned words up again, in the lexicon as it is now (ids and nodes are all different)
+	void rebuild();
+
+	/// writes a snapshot of everything now on the background thread - returns false if one is still being written
+	bool compact();
+	/// waits for a compaction in progress
+	void waitForCompaction();
+
+#pragma mark - the overlay, for searching
+
+	/// log prior of a word id from either the lexicon or the overlay, merged
+	inline LogProb logPrior(uint32_t wordId) const {
+		if (wordId < numLexWords)
+			return boosted.empty() ? lexicon.logPrior(wordId) : TMax(lexicon.logPrior(wordId), boosted[wordId]);
+		return userPriors[wordId - numLexWords];
+	}
+
+	/// the overlay's root - only meaningful if hasNewWords()
+	LexCursor root() const { LexCursor c = { numLexNodes, nodes[0].wordId }; return c; }
+	/// is the cursor in the overlay rather than the lexicon
+	inline bool owns(const LexCursor& at) const { return at.node >= numLexNodes; }
+
+	/// the same as Lexicon::child(), for a cursor in the overlay
+	inline bool child(LexCursor& at, unsigned char c) const {
+		const int letter = lexicon.letterIndex(c);
+		if (letter >= Lexicon::kMaxLetters)
+			return false;
+		const int32_t next = children[(at.node - numLexNodes)*Lexicon::kMaxLetters + letter];
+		if (next < 0)
+			return false;
+		at.node = numLexNodes + next;
+		at.wordId = nodes[next].wordId;
+		return true;
+	}
+	inline uint32_t childMask(const LexCursor& at) const { return nodes[at.node - numLexNodes].childMask; }
+	inline bool isWord(const LexCursor& at) const { return nodes[at.node - numLexNodes].wordId != kNoWord; }
+	inline LogProb maxLogPrior(const LexCursor& at) const { return nodes[at.node - numLexNodes].maxLogPrior; }
+
+	/// the learned word with overlay id 'wordId' (from numLexWords), into 'out' - returns its length
+	int word(uint32_t wordId, char* out) const;
+
+private:
+	const Lexicon& lexicon;
+	UserDictionaryConfig config;
+
+	// what the user typed - for the lexicon's words by id, for the rest in the overlay (userCounts)
+	std::vector<uint32_t> lexCounts;       //< by lexicon word id - empty until one is learned
+	int numLearned = 0;
+	std::vector<std::pair<std::string, uint32_t> > detached; //< the learned words while the lexicon changes
+	bool isDetached = false;
+
+	// the overlay
+	uint32_t numLexNodes = 0;
+	uint32_t numLexWords = 0;
+	std::vector<LogProb> boosted;          //< by lexicon word id - kMinLogProb for words the user didn't type
+	struct Node {
+		uint32_t childMask;
+		uint32_t wordId;                   //< kNoWord if no word ends here
+		LogProb maxLogPrior;               //< best prior below
+	};
+	std::vector<Node> nodes;
+	std::vector<int32_t> children;         //< kMaxLetters per node, -1 for none
+	std::vector<std::string> userWords;    //< by overlay id - renumbered when one is forgotten
+	std::vector<uint32_t> userCounts;
+	std::vector<LogProb> userPriors;
+
+	// persistence
+	std::string dir;
+	TFileWriter log;
+	uint32_t generation = 0;               //< of the log being appended to
+	int logRecords = 0;
+
+	// compaction - the snapshot to write, handed over under the thread's conditionMutex
+	TThreadI compactThread{"UserDictCompact"};
+	std::vector<std::pair<std::string, uint32_t> > toWrite;
+	uint32_t toWriteGeneration = 0;
+	int requested = 0;
+	bool writing = false;                  //< from compact() until the snapshot is written
+	TCondition idle;                       //< signalled when it is
+
+	LogProb priorOf(uint32_t count) const;
+	void reset();
+	uint32_t countOf(const std::string& word) const;
+	void setCount(const std::string& word, uint32_t count);
+	int32_t overlayNode(const std::string& word) const;
+	void addToOverlay(const std::string& word, uint32_t count);
+	void removeFromOverlay(const std::string& word);
+	void collect(std::vector<std::pair<std::string, uint32_t> >& out) const;
+	bool append(char op, const std::string& word);
+	bool replay(const std::string& path);
+	bool readSnapshot(const std::string& path, uint32_t& snapshotGeneration);
+	static bool writeSnapshot(const std::string& path, const std::vector<std::pair<std::string, uint32_t> >& entries, uint32_t generation);
+	std::string logPath(uint32_t gen) const;
+	std::string snapshotPath() const { return dir + "/user.dict"; }
+	bool normalise(const char* word, int len, std::string& out) const;
+	void runCompaction(std::function<bool()> needToStop);
+
+	DISALLOW_COPY_AND_ASSIGN(UserDictionary);
+};
+
+#endif
@@ -0,0 +1,242 @@
+#include "WordBigrams.h"
+#include "TFile.h"
+#include "TLogging.h"
+#include <algorithm>
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+#define MAX_LINE 200
+
+struct BigramFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t byteOrder;  //< kBigramByteOrder as written - the arrays are in the writer's byte order
+	uint32_t numWords;
+	uint32_t numBigrams;
+	uint32_t offsetsOffset; //< from the start of the file
+	uint32_t successorsOffset;
+	uint32_t levelsOffset;
+	uint32_t codesOffset;
+	uint32_t fileSize;
+	uint64_t lexiconSignature;
+};
+
+static const char kBigramMagic[4] = { 'Q', 'B', 'I', 'G' };
+static const uint32_t kBigramVersion = 1;
+static const uint32_t kBigramByteOrder = 0x01020304;
+
+void WordBigrams::clear() {
+	offsets = nullptr;
+	successors = nullptr;
+	codes = nullptr;
+	levels = nullptr;
+	numWords = 0;
+	numBigrams = 0;
+	signature = 0;
+	builtOffsets.clear();
+	builtSuccessors.clear();
+	builtCodes.clear();
+	codebook.clear();
+	mapped.close();
+}
+
+uint64_t WordBigrams::lexiconSignature(const Lexicon& lexicon) {
+	// FNV-1a over the words in id order
+	uint64_t h = 0xcbf29ce484222325ULL;
+	lexicon.forEachWord([&h](uint32_t wordId, const char* word, int len) {
+		for (int i=0; i<=len; i++) { // with the nul, so that word boundaries count
+			h ^= (uint8_t)word[i];
+			h *= 0x100000001b3ULL;
+		}
+	});
+	return h;
+}
+
+LogProb WordBigrams::logProb(int prev, int next) const {
+	if (!validWord(prev))
+		return kMinLogProb;
+	const uint32_t* begin = successors + offsets[prev];
+	const uint32_t* end = successors + offsets[prev+1];
+	const uint32_t* it = lower_bound(begin, end, (uint32_t)next);
+	if (it == end || *it != (uint32_t)next)
+		return kMinLogProb;
+	return levels[codes[it - successors]];
+}
+
+int WordBigrams::topSuccessors(int prev, WordPrediction* out, int maxCount) const {
+	int count = 0;
+	forEachSuccessor(prev, [&](int next, LogProb lp) {
+		if (maxCount <= 0 || (count == maxCount && lp <= out[count-1].logProb))
+			return;
+		int at = TMin(count, maxCount-1);
+		for (; at > 0 && out[at-1].logProb < lp; at--)
+			out[at] = out[at-1];
+		out[at].wordId = next;
+		out[at].logProb = lp;
+		count = TMin(count+1, maxCount);
+	});
+	return count;
+}
+
+#pragma mark - building
+
+bool WordBigrams::build(const std::string& countsPath, const Lexicon& lexicon) {
+	clear();
+	if (!lexicon.isLoaded())
+		return false;
+	TFileReader fr(countsPath);
+	if (!fr.isOpen()) {
+		TLogError("Failed to read bigram counts from '%s'", countsPath.c_str());
+		return false;
+	}
+
+	// (prev << 32 | next, count)
+	vector<pair<uint64_t, double> > counts;
+	int skipped = 0;
+	char line[MAX_LINE];
+	while (fr.readLine(line, MAX_LINE)) {
+		char* words[2];
+		int lens[2];
+		char* ptr = line;
+		int n = 0;
+		for (; n<2; n++) {
+			while (isspace(*ptr))
+				++ptr;
+			words[n] = ptr;
+			while (*ptr && !isspace(*ptr))
+				++ptr;
+			lens[n] = (int)(ptr - words[n]);
+			if (lens[n] == 0)
+				break;
+		}
+		if (n < 2)
+			continue;
+		const double count = atof(ptr);
+		const int prev = lexicon.lookup(words[0], lens[0]);
+		const int next = lexicon.lookup(words[1], lens[1]);
+		if (prev < 0 || next < 0 || count <= 0) {
+			skipped++;
+			continue;
+		}
+		counts.push_back(make_pair((uint64_t)prev << 32 | (uint32_t)next, count));
+	}
+	if (counts.empty()) {
+		TLogError("No bigrams of lexicon words in '%s'", countsPath.c_str());
+		return false;
+	}
+
+	// merge duplicates (e.g. different case), then P(next | prev) over everything seen after prev
+	sort(counts.begin(), counts.end());
+	size_t n = 0;
+	for (size_t i=1; i<counts.size(); i++) {
+		if (counts[i].first == counts[n].first)
+			counts[n].second += counts[i].second;
+		else
+			counts[++n] = counts[i];
+	}
+	counts.resize(n+1);
+
+	numWords = (uint32_t)lexicon.wordCount();
+	numBigrams = (uint32_t)counts.size();
+	builtOffsets.assign(numWords + 1, 0);
+	builtSuccessors.resize(numBigrams);
+	vector<double> totals(numWords, 0.0);
+	for (auto& c: counts) {
+		builtOffsets[(c.first >> 32) + 1]++;
+		totals[c.first >> 32] += c.second;
+	}
+	for (uint32_t w=0; w<numWords; w++)
+		builtOffsets[w+1] += builtOffsets[w];
+
+	vector<LogProb> logProbs(numBigrams);
+	for (uint32_t i=0; i<numBigrams; i++) {
+		builtSuccessors[i] = (uint32_t)counts[i].first;
+		logProbs[i] = toLogProb(log(counts[i].second / totals[counts[i].first >> 32]));
+	}
+	codebook.build(logProbs);
+	builtCodes.resize(numBigrams);
+	for (uint32_t i=0; i<numBigrams; i++)
+		builtCodes[i] = codebook.encode(logProbs[i]);
+
+	offsets = &builtOffsets[0];
+	successors = &builtSuccessors[0];
+	codes = &builtCodes[0];
+	levels = codebook.getLevels();
+	signature = lexiconSignature(lexicon);
+	TLogDebug("Loaded %d bigrams (%d skipped) from '%s'", (int)numBigrams, skipped, countsPath.c_str());
+	return true;
+}
+
+#pragma mark - compiled form
+
+bool WordBigrams::save(const std::string& path) const {
+	if (!isLoaded())
+		return false;
+
+	BigramFileHeader h = {};
+	memcpy(h.magic, kBigramMagic, sizeof(kBigramMagic));
+	h.version = kBigramVersion;
+	h.byteOrder = kBigramByteOrder;
+	h.numWords = numWords;
+	h.numBigrams = numBigrams;
+	h.lexiconSignature = signature;
+	h.offsetsOffset = sizeof(BigramFileHeader);
+	h.successorsOffset = h.offsetsOffset + (numWords+1)*sizeof(uint32_t);
+	h.levelsOffset = h.successorsOffset + numBigrams*sizeof(uint32_t);
+	h.codesOffset = h.levelsOffset + LogProbCodebook::kNumLevels*sizeof(LogProb);
+	h.fileSize = h.codesOffset + numBigrams;
+
+	TFileWriter fw(path);
+	if (!fw.isOpen())
+		return false;
+	size_t written = fw.write(&h, sizeof(h));
+	written += fw.write(offsets, (numWords+1)*sizeof(uint32_t));
+	written += fw.write(successors, numBigrams*sizeof(uint32_t));
+	written += fw.write(levels, LogProbCodebook::kNumLevels*sizeof(LogProb));
+	written += fw.write(codes, numBigrams);
+	if (written != h.fileSize) {
+		TLogError("Failed to write bigrams '%s'", path.c_str());
+		return false;
+	}
+	return true;
+}
+
+/// maps the file - checks the header and that it's for this lexicon, but trusts the contents
+bool WordBigrams::load(const std::string& path, const Lexicon& lexicon) {
+	clear();
+	if (!mapped.open(path))
+		return false;
+	const uint8_t* base = (const uint8_t*)mapped.data();
+	const BigramFileHeader& h = *(const BigramFileHeader*)base;
+	bool ok = mapped.size() >= sizeof(BigramFileHeader) && memcmp(h.magic, kBigramMagic, sizeof(kBigramMagic)) == 0 &&
+		h.version == kBigramVersion && h.byteOrder == kBigramByteOrder && h.fileSize == mapped.size() && h.numWords > 0 &&
+		((h.offsetsOffset | h.successorsOffset | h.levelsOffset) & 3) == 0 &&
+		h.offsetsOffset + (uint64_t)(h.numWords+1)*sizeof(uint32_t) <= h.fileSize &&
+		h.successorsOffset + (uint64_t)h.numBigrams*sizeof(uint32_t) <= h.fileSize &&
+		h.levelsOffset + (uint64_t)LogProbCodebook::kNumLevels*sizeof(LogProb) <= h.fileSize &&
+		h.codesOffset + (uint64_t)h.numBigrams <= h.fileSize;
+	if (!ok) {
+		TLogError("Bad bigram file '%s'", path.c_str());
+		clear();
+		return false;
+	}
+	if (h.numWords != (uint32_t)lexicon.wordCount() || h.lexiconSignature != lexiconSignature(lexicon)) {
+		TLogError("Bigram file '%s' is for a different lexicon", path.c_str());
+		clear();
+		return false;
+	}
+
+	offsets = (const uint32_t*)(base + h.offsetsOffset);
+	successors = (const uint32_t*)(base + h.successorsOffset);
+	levels = (const LogProb*)(base + h.levelsOffset);
+	codes = base + h.codesOffset;
+	numWords = h.numWords;
+	numBigrams = h.numBigrams;
+	signature = h.lexiconSignature;
+	TLogDebug("Mapped %d bigrams from '%s'", (int)numBigrams, path.c_str());
+	return true;
+}
@@ -0,0 +1,82 @@
+#ifndef _WordBigrams_h
+#define _WordBigrams_h
+
+#include "TCommon.h"
+#include "Lexicon.h"
+#include "LogProb.h"
+#include "TMappedFile.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// a word likely to come next, with log P(word | previous word)
+struct WordPrediction {
+	int wordId;
+	LogProb logProb;
+};
+
+/**
+ Word bigrams over the lexicon's word ids: for every word, the words seen after it and log P(next |
+ word). The successors of each word are one sorted run of a flat id array (indexed through an
+ offsets array, one entry per word), with a byte per bigram coding its LogProb through a
+ LogProbCodebook - so 5 bytes a bigram, and a lookup is a binary search within the word's run.
+
+ Built from "word1 word2<whitespace>count" lines (as in count_2w.txt) by Tools/BigramCompiler.cpp,
+ and saved in a form that load() maps straight back in, like the compiled lexicon. The file
+ records which lexicon its ids are for, and won't load against another one.
+ */
+class WordBigrams {
+public:
+	WordBigrams() {}
+
+	/// maps a compiled bigram file - returns false if it can't be read or is for a different lexicon
+	bool load(const std::string& path, const Lexicon& lexicon);
+	/// reads bigram counts, skipping words that aren't in the lexicon - returns false if none are left
+	bool build(const std::string& countsPath, const Lexicon& lexicon);
+	bool save(const std::string& path) const;
+	void clear();
+
+	bool isLoaded() const { return numWords > 0; }
+	bool isMapped() const { return mapped.isOpen(); }
+	int bigramCount() const { return (int)numBigrams; }
+
+	int successorCount(int prev) const { return validWord(prev) ? (int)(offsets[prev+1] - offsets[prev]) : 0; }
+
+	/// log P(next | prev), kMinLogProb if 'next' was never seen after 'prev'
+	LogProb logProb(int prev, int next) const;
+
+	/// calls fn(nextWordId, logProb) for every word seen after 'prev', in id order
+	template<typename F>
+	void forEachSuccessor(int prev, F fn) const {
+		if (!validWord(prev))
+			return;
+		for (uint32_t i=offsets[prev]; i<offsets[prev+1]; i++)
+			fn((int)successors[i], levels[codes[i]]);
+	}
+
+	/// the (up to) 'maxCount' likeliest words after 'prev', best first - returns how many
+	int topSuccessors(int prev, WordPrediction* out, int maxCount) const;
+
+	/// identifies the lexicon's words and their ids - a bigram file only fits the lexicon it was built for
+	static uint64_t lexiconSignature(const Lexicon& lexicon);
+
+private:
+	const uint32_t* offsets = nullptr;    //< numWords+1 - word w's successors are [offsets[w], offsets[w+1])
+	const uint32_t* successors = nullptr;
+	const uint8_t* codes = nullptr;
+	const LogProb* levels = nullptr;
+	uint32_t numWords = 0;
+	uint32_t numBigrams = 0;
+	uint64_t signature = 0;
+	std::vector<uint32_t> builtOffsets;
+	std::vector<uint32_t> builtSuccessors;
+	std::vector<uint8_t> builtCodes;
+	LogProbCodebook codebook;
+	TMappedFile mapped;
+
+	bool validWord(int w) const { return w >= 0 && (uint32_t)w < numWords; }
+
+	DISALLOW_COPY_AND_ASSIGN(WordBigrams);
+};
+
+#endif
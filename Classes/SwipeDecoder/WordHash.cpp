@@ -0,0 +1,186 @@
+#include "WordHash.h"
+#include "TFile.h"
+#include "TLogging.h"
+#include <ctype.h>
+#include <string.h>
+
+using namespace std;
+
+/// bits per key still to place, at each level - more is faster to build and look up, but bigger
+static const float kGamma = 2.0f;
+
+/// 64-bit finaliser (from MurmurHash3) - spreads every input bit over the whole output
+static inline uint64_t mix64(uint64_t h) {
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+uint64_t WordHash::hashWord(const char* word, int len) {
+	// FNV-1a
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (int i=0; i<len; i++) {
+		h ^= (uint8_t)tolower((unsigned char)word[i]);
+		h *= 0x100000001b3ULL;
+	}
+	return mix64(h ^ (uint64_t)len);
+}
+
+inline uint32_t WordHash::levelBit(uint64_t hash, int level, uint32_t numBits) {
+	uint64_t h = mix64(hash + (uint64_t)(level+1) * 0x9e3779b97f4a7c15ULL);
+	return (uint32_t)(((h >> 32) * numBits) >> 32);
+}
+
+inline uint32_t WordHash::fingerprint(uint64_t hash) {
+	return (uint32_t)(mix64(hash ^ 0xc2b2ae3d27d4eb4fULL) >> 32);
+}
+
+void WordHash::clear() {
+	header = Header();
+	numKeys = 0;
+	bits = nullptr;
+	ranks = nullptr;
+	slotIds = nullptr;
+	fingerprints = nullptr;
+	ownBits.clear();
+	ownRanks.clear();
+	ownSlotIds.clear();
+	ownFingerprints.clear();
+}
+
+bool WordHash::build(const std::vector<uint64_t>& keys) {
+	clear();
+	if (keys.empty())
+		return false;
+
+	vector<uint64_t> remaining(keys), next;
+	vector<uint64_t> collided;
+	int level = 0;
+	for (; level<kMaxLevels && !remaining.empty(); level++) {
+		const uint32_t numWords = (uint32_t)((remaining.size() * kGamma + 63) / 64);
+		const uint32_t numBits = numWords * 64;
+		const uint32_t start = (uint32_t)ownBits.size();
+		header.levelStart[level] = start;
+		ownBits.resize(start + numWords, 0);
+		collided.assign(numWords, 0);
+
+		uint64_t* levelBits = &ownBits[start];
+		for (uint64_t k: remaining) {
+			uint32_t b = levelBit(k, level, numBits);
+			uint64_t mask = 1ULL << (b & 63);
+			if (levelBits[b >> 6] & mask)
+				collided[b >> 6] |= mask;
+			levelBits[b >> 6] |= mask;
+		}
+		// only the keys that had their bit to themselves stay on this level
+		next.clear();
+		for (uint64_t k: remaining) {
+			uint32_t b = levelBit(k, level, numBits);
+			if (collided[b >> 6] & (1ULL << (b & 63)))
+				next.push_back(k);
+		}
+		for (uint32_t w=0; w<numWords; w++)
+			levelBits[w] &= ~collided[w];
+		remaining.swap(next);
+	}
+	if (!remaining.empty()) {
+		TLogError("Word hash: %d of %d keys left after %d levels (duplicates?)", (int)remaining.size(), (int)keys.size(), level);
+		clear();
+		return false;
+	}
+	header.numKeys = numKeys = (uint32_t)keys.size();
+	header.numLevels = level;
+	header.levelStart[level] = (uint32_t)ownBits.size();
+
+	ownRanks.resize(ownBits.size());
+	uint32_t rank = 0;
+	for (size_t w=0; w<ownBits.size(); w++) {
+		ownRanks[w] = rank;
+		rank += __builtin_popcountll(ownBits[w]);
+	}
+	bits = &ownBits[0];
+	ranks = &ownRanks[0];
+
+	ownSlotIds.resize(numKeys);
+	ownFingerprints.resize(numKeys);
+	for (uint32_t id=0; id<numKeys; id++) {
+		int slot = slotOf(keys[id]);
+		ownSlotIds[slot] = id;
+		ownFingerprints[slot] = fingerprint(keys[id]);
+	}
+	slotIds = &ownSlotIds[0];
+	fingerprints = &ownFingerprints[0];
+
+	TLogDebug("Word hash: %d keys, %d levels, %.2f bits/key", (int)numKeys, level, (ownBits.size() * 64.0) / numKeys);
+	return true;
+}
+
+/// the slot of the first level where the hash's bit is set - -1 if there's none
+int WordHash::slotOf(uint64_t hash) const {
+	for (uint32_t level=0; level<header.numLevels; level++) {
+		const uint32_t start = header.levelStart[level];
+		const uint32_t numBits = (header.levelStart[level+1] - start) * 64;
+		const uint32_t b = levelBit(hash, level, numBits);
+		const uint32_t w = start + (b >> 6);
+		const uint64_t mask = 1ULL << (b & 63);
+		if (bits[w] & mask)
+			return (int)(ranks[w] + __builtin_popcountll(bits[w] & (mask - 1)));
+	}
+	return -1;
+}
+
+int WordHash::findHash(uint64_t hash) const {
+	int slot = slotOf(hash);
+	if (slot < 0 || fingerprints[slot] != fingerprint(hash))
+		return -1;
+	return (int)slotIds[slot];
+}
+
+#pragma mark - serialisation
+
+/// Header, bits, ranks, slot ids, fingerprints - padded to a multiple of 8
+size_t WordHash::serialisedSize() const {
+	const size_t numWords = header.levelStart[header.numLevels];
+	size_t size = sizeof(Header) + numWords*(sizeof(uint64_t) + sizeof(uint32_t)) + numKeys*(sizeof(uint32_t) + sizeof(uint32_t));
+	return (size + 7) & ~(size_t)7;
+}
+
+size_t WordHash::write(TFileWriter& fw) const {
+	const int numWords = (int)header.levelStart[header.numLevels];
+	size_t written = fw.write(&header, sizeof(Header));
+	written += fw.write(bits, numWords*sizeof(uint64_t));
+	written += fw.write(ranks, numWords*sizeof(uint32_t));
+	written += fw.write(slotIds, numKeys*sizeof(uint32_t));
+	written += fw.write(fingerprints, numKeys*sizeof(uint32_t));
+	static const uint8_t zeros[8] = {};
+	written += fw.write(zeros, (int)(serialisedSize() - written));
+	return written;
+}
+
+bool WordHash::map(const void* data, size_t size) {
+	clear();
+	if (size < sizeof(Header) || ((uintptr_t)data & 7))
+		return false;
+	const Header& h = *(const Header*)data;
+	if (h.numLevels == 0 || h.numLevels > kMaxLevels || h.numKeys == 0)
+		return false;
+	header = h;
+	numKeys = h.numKeys;
+	if (serialisedSize() > size) {
+		clear();
+		return false;
+	}
+	const size_t numWords = h.levelStart[h.numLevels];
+	const uint8_t* p = (const uint8_t*)data + sizeof(Header);
+	bits = (const uint64_t*)p;
+	p += numWords*sizeof(uint64_t);
+	ranks = (const uint32_t*)p;
+	p += numWords*sizeof(uint32_t);
+	slotIds = (const uint32_t*)p;
+	p += numKeys*sizeof(uint32_t);
+	fingerprints = (const uint32_t*)p;
+	return true;
+}
@@ -0,0 +1,79 @@
+#ifndef _WordHash_h
+#define _WordHash_h
+
+#include "TCommon.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class TFileWriter;
+
+/**
+ Minimal perfect hash from words to their (dense, 0..n-1) ids, so that anything keyed on a word -
+ priors, the user dictionary, bigrams, caches - can be a flat array indexed by id instead of a map
+ of strings.
+
+ BBHash-style: a cascade of bit arrays, each 2x as long as the number of keys still to place. A key
+ sets its bit in the first level where it doesn't collide with another key, and its slot is the rank
+ of that bit over all levels. That's ~3.5 bits per word plus the rank table; a lookup is a couple of
+ hashes, a popcount and two loads.
+
+ The hash alone can't tell that a string isn't one of the words, so each slot also keeps a 32-bit
+ fingerprint of its word - an unknown string gets through with probability 1 in 4 billion, so that
+ a word the user made up can be told from the lexicon's without walking the trie.
+
+ Like Lexicon, it either owns its arrays (build()) or points into a mapped file (map()).
+ */
+class WordHash {
+public:
+	static const int kMaxLevels = 32;
+
+	WordHash() {}
+
+	/// the hash that keys are built from, and looked up by - case folded, like the lexicon
+	static uint64_t hashWord(const char* word, int len);
+
+	/// keys[id] = hashWord() of word 'id' - returns false if they couldn't all be placed (e.g. duplicates)
+	bool build(const std::vector<uint64_t>& keys);
+	void clear();
+
+	bool empty() const { return numKeys == 0; }
+	int size() const { return (int)numKeys; }
+
+	/// the id of 'word', or -1 if it isn't one of the keys (bar the odd fingerprint collision)
+	int find(const char* word, int len) const { return findHash(hashWord(word, len)); }
+	int findHash(uint64_t hash) const;
+
+	/// bytes that write() writes / map() expects - a multiple of 8
+	size_t serialisedSize() const;
+	size_t write(TFileWriter& fw) const;
+	/// points into 'data' (8-byte aligned, at least 'size' bytes, and kept alive by the caller)
+	bool map(const void* data, size_t size);
+
+private:
+	struct Header {
+		uint32_t numKeys;
+		uint32_t numLevels;
+		uint32_t levelStart[kMaxLevels+1]; //< level i is words [levelStart[i], levelStart[i+1]) of 'bits'
+		uint32_t pad;
+	};
+	Header header = Header();
+	uint32_t numKeys = 0;
+	const uint64_t* bits = nullptr;
+	const uint32_t* ranks = nullptr;     //< set bits before each word of 'bits'
+	const uint32_t* slotIds = nullptr;
+	const uint32_t* fingerprints = nullptr;
+	std::vector<uint64_t> ownBits;
+	std::vector<uint32_t> ownRanks;
+	std::vector<uint32_t> ownSlotIds;
+	std::vector<uint32_t> ownFingerprints;
+
+	/// the bit for 'hash' within level 'level', which is 'numBits' long
+	static inline uint32_t levelBit(uint64_t hash, int level, uint32_t numBits);
+	static inline uint32_t fingerprint(uint64_t hash);
+	int slotOf(uint64_t hash) const;
+
+	DISALLOW_COPY_AND_ASSIGN(WordHash);
+};
+
+#endif
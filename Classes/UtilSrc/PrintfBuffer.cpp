@@ -1,5 +1,6 @@
 #include "PrintfBuffer.h"
 #include "TLogging.h"
+#include <string.h>
 
 #pragma mark - PrintfBuf
 
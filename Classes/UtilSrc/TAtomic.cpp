@@ -20,7 +20,7 @@ int TCompareAndSwapPtr(void *oldValue, void *newValue, void* volatile* theValue)
 int TCompareAndSwapPtrBarrier(void *oldValue, void *newValue, void* volatile* theValue) {
 	return OSAtomicCompareAndSwapPtrBarrier(oldValue, newValue, theValue);
 }
-#elif defined(ANDROID)
+#elif defined(ANDROID) || defined(WEBRTC_LINUX)
 int32_t TAtomicIncrement(int32_t* i) { return __sync_fetch_and_add(i, 1) + 1; }
 int32_t TAtomicDecrement(int32_t* i) { return __sync_fetch_and_sub(i, 1) - 1; }
 
@@ -35,10 +35,8 @@ int TCompareAndSwapPtr(void *oldValue, void *newValue, void* volatile* theValue)
 	return __sync_bool_compare_and_swap(theValue, oldValue, newValue);
 }
 int TCompareAndSwapPtrBarrier(void *oldValue, void *newValue, void* volatile* theValue) {
-	int ret;
-	__sync_synchronize(ret = __sync_bool_compare_and_swap(theValue, oldValue, newValue));
-
-	return ret;
+	// __sync_bool_compare_and_swap is already a full barrier
+	return __sync_bool_compare_and_swap(theValue, oldValue, newValue);
 }
 
 
@@ -2,7 +2,8 @@
 //#include "StrUtils.h"
 #include "TLogging.h"
 #include <string>
-#ifndef ANDROID
+#include <time.h>
+#if !defined(ANDROID) && !defined(WEBRTC_LINUX)
 #include <xlocale.h>
 #endif
 
@@ -72,7 +73,7 @@ TDateTime TDateTime::fromString(const std::string& _str) {
 	
 	TDateTime result;
 	struct tm t;
-#ifdef ANDROID
+#if defined(ANDROID) || defined(WEBRTC_LINUX)
 	char* res = strptime(&str[0], "%Y-%m-%d %H:%M:%S", &t);
 #else
 	char* res = strptime_l(&str[0], "%Y-%m-%d %H:%M:%S", &t, NULL);
@@ -251,6 +251,13 @@ void TFileWriter::open(const char* filename, const char* flags) {
 	checkForError();
 }
 
+void TFileWriter::close() {
+	if (fp) {
+		fclose(fp);
+		fp = NULL;
+	}
+}
+
 size_t TFileWriter::write(const void* data, int size) {
 	auto result = fwrite(data, 1, size, fp);
 	checkForError();
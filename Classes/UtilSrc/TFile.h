@@ -106,6 +106,9 @@ public:
 	size_t read(void* data, int size);
     map<string, Vocab> readVocab();
 	
+	/// fgets() wrapper for the line-based data files - returns false at the end of the file
+	bool readLine(char* line, int maxLen) { return fp && fgets(line, maxLen, fp) != NULL; }
+	
 	
 	int readLittleEndianInt16();
 	int readLittleEndianInt32();
@@ -133,7 +136,9 @@ public:
 	// if have this, then should disable copy-constructor!! (or define some move semantics ...)
 	~TFileWriter();
 	
+	bool isOpen() const { return fp != NULL; }
 	void open(const char* filename, const char* flags="wb");
+	void close();
 	
 	size_t write(const void* data, int size);
 	
@@ -392,7 +392,7 @@ public:
 		
 		runCount++;
 		
-		TThreadI::start(TThread::kLowPriority, false);
+		TThreadI::start(TThreadI::kLowPriority, false);
 	}
 	
 	~LoggingThread() {
@@ -461,7 +461,11 @@ void TLogging_flush() {
 		inst->linesLogged++;
 	}
 #endif
+#if LOG_TO_FILE
 	TLogging_flushFile(getLogfile());
+#else
+	TLogging_flushFile(stdout);
+#endif
 }
 
 
@@ -3,6 +3,7 @@
 
 #include "TCommon.h"
 #include "TTypes.h" // need for int64_t usage .....
+#include <stdarg.h> // va_list
 
 //
 // Logging to File
@@ -12,6 +13,8 @@
 //
 #if RELEASE_BUILD
 #	define LOG_TO_FILE 0
+#elif defined(WEBRTC_LINUX) // headless builds (tools, benchmarks) just log to the console
+#	define LOG_TO_FILE 0
 #elif defined(_DEBUG)
 #	define LOG_TO_FILE 1
 #else
@@ -0,0 +1,40 @@
+#include "TMappedFile.h"
+#include "TLogging.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool TMappedFile::open(const char* filename) {
+	close();
+	int fd = ::open(filename, O_RDONLY);
+	if(fd < 0) {
+		TLogError("Failed to open '%s': %s", filename, strerror(errno));
+		return false;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size <= 0) {
+		TLogError("Can't map '%s' - empty or unreadable", filename);
+		::close(fd);
+		return false;
+	}
+	void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // the mapping keeps its own reference
+	if(p == MAP_FAILED) {
+		TLogError("Failed to map '%s': %s", filename, strerror(errno));
+		return false;
+	}
+	base = p;
+	length = (size_t)st.st_size;
+	return true;
+}
+
+void TMappedFile::close() {
+	if(base) {
+		munmap(base, length);
+		base = nullptr;
+		length = 0;
+	}
+}
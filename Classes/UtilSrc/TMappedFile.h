@@ -0,0 +1,32 @@
+#ifndef _TMappedFile_h
+#define _TMappedFile_h
+
+#include "TCommon.h"
+#include <stddef.h>
+#include <string>
+
+/**
+ A whole file mapped read-only into memory - for binary data that is used in place rather than
+ read (so it costs no heap, and the pages are clean, i.e. the OS can drop and re-read them).
+ */
+class TMappedFile {
+	void* base = nullptr;
+	size_t length = 0;
+
+public:
+	TMappedFile() {}
+	~TMappedFile() { close(); }
+
+	/// returns false (logging why) if the file couldn't be opened/mapped, or is empty
+	bool open(const char* filename);
+	bool open(const std::string& filename) { return open(filename.c_str()); }
+	void close();
+
+	bool isOpen() const { return base != nullptr; }
+	const void* data() const { return base; }
+	size_t size() const { return length; }
+
+	DISALLOW_COPY_AND_ASSIGN(TMappedFile);
+};
+
+#endif
@@ -5,6 +5,9 @@
 #ifdef __APPLE__ // defined(_MAC) || defined(IOS)
 #	include <mach/mach.h>
 #	include "pthread.h"
+#elif defined(WEBRTC_LINUX)
+#	include <unistd.h>
+#	include <sys/syscall.h>
 #endif
 
 using namespace std;
@@ -3,6 +3,7 @@
 
 #include "TCommon.h"
 #include "TCondition.h"
+#include "FunctionalWrapper.h"
 
 #include "pthread.h"
 
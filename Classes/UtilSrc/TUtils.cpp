@@ -1,7 +1,8 @@
 #include "TUtils.h"
 #include "TFile.h"
 #include <time.h>
-#ifndef ANDROID
+#include <stdarg.h>
+#if !defined(ANDROID) && !defined(WEBRTC_LINUX)
 #include <sys/sysctl.h>
 #endif
 #include <string>
@@ -64,6 +65,7 @@ std::string TUtils::toLower(const std::string& s) {
 }
 
 string TUtils::stateFilesSubDir = "";
+string TUtils::resourceDir = "";
 
 string TUtils::format(const string& s, ...) {
         return TUtils::format(s.c_str());
@@ -92,6 +94,13 @@ bool TUtils::ensureStateFileSubdirExists(const std::string& dir, bool loggingEna
 	}
 }
 
+void TUtils::setResourceDir(std::string dir) {
+	if(dir.size() && dir[dir.size()-1] != '/') {
+		dir += '/';
+	}
+	resourceDir = dir;
+}
+
 void TUtils::setStateFilesSubDir(std::string filename) {
 	stateFilesSubDir = filename;
 	ensureStateFileSubdirExists("");
@@ -175,3 +184,88 @@ string TUtils::formatWithCommas(int n) {
         return p;
 }
 
+
+#if defined(WEBRTC_LINUX)
+#pragma mark - Linux
+
+//
+// headless builds (tools, benchmarks) - these are implemented in TUtils.mm on Apple platforms,
+// here resources are just looked up in resourceDir, and state files live in the working dir
+//
+#include <unistd.h>
+#include <sys/utsname.h>
+
+long TUtils::usedMemory() {
+	long pages = 0, residentPages = 0;
+	if (FILE* fp = fopen("/proc/self/statm", "r")) {
+		if(fscanf(fp, "%ld %ld", &pages, &residentPages) != 2) {
+			residentPages = 0;
+		}
+		fclose(fp);
+	}
+	return residentPages * sysconf(_SC_PAGESIZE);
+}
+
+long TUtils::freeMemory() {
+	return sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGESIZE);
+}
+
+const char* TUtils::pathForResource(const char *name) {
+	// same lifetime caveats as the NSString-backed version: valid until the next call on this thread
+	static __thread char path[1024];
+	snprintf(path, sizeof(path), "%s%s", resourceDir.c_str(), name);
+	return path;
+}
+
+string TUtils::getResourceFilePath(string resourceName, string resourceType) {
+	if(resourceType.size()) {
+		return resourceDir + resourceName + "." + resourceType;
+	}
+	return resourceDir + resourceName;
+}
+
+string TUtils::getStateFilenameWithPath(string filename) {
+	if(stateFilesSubDir.size()) {
+		return stateFilesSubDir + "/" + filename;
+	}
+	return filename;
+}
+
+string TUtils::getSystemVersion() {
+	struct utsname u;
+	if(uname(&u) != 0) {
+		return "unknown";
+	}
+	return string(u.sysname) + " " + u.release;
+}
+
+string TUtils::getModel() {
+	struct utsname u;
+	if(uname(&u) != 0) {
+		return "unknown";
+	}
+	return u.machine;
+}
+
+string TUtils::getDeviceName() {
+	char name[256];
+	if(gethostname(name, sizeof(name)) != 0) {
+		return "unknown";
+	}
+	name[sizeof(name)-1] = 0;
+	return name;
+}
+
+string TUtils::getAppVersionAndBuild() { return getAppVersion(); }
+string TUtils::getAppVersion() { return "headless"; }
+string TUtils::getAppBuild() { return "headless"; }
+
+bool TUtils::connectedToWifi() {
+	return true;
+}
+
+void TUtils::executeWithinAutoreleasePool(std::function<void()> fn) {
+	fn();
+}
+
+#endif // #if defined(WEBRTC_LINUX)
@@ -8,6 +8,7 @@
 class TUtils {
 public:
 	static std::string stateFilesSubDir;
+	static std::string resourceDir; //< only used where there is no app bundle (i.e. headless linux builds)
 	static char* readFile(const char *name);
     
 	static long usedMemory();
@@ -22,6 +23,7 @@ public:
     static std::string format(const std::string& s, ...);
     static std::string format(const char* s, ...);
 	
+	static void setResourceDir(std::string dir);
 	static void setStateFilesSubDir(std::string filename);
 	static std::string getStateFilesSubDir(void);
     
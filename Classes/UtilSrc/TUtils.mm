@@ -172,6 +172,8 @@ string TUtils::getResourceFilePath(string resourceName, string resourceType) {
 #endif
 	{
 		NSString* resourceFile = [[NSBundle mainBundle] pathForResource:[NSString stringWithUTF8String:resourceName.c_str()] ofType:[NSString stringWithUTF8String:resourceType.c_str()]];
+		if (!resourceFile)
+			return string("");
 		return string([resourceFile fileSystemRepresentation]);
 	}
 }
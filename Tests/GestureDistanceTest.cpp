@@ -0,0 +1,136 @@
+/**
+ GestureDistance: the vector kernel this was compiled for gives the scalar reference's sums bit for
+ bit - it adds the same floats in the same order, and the vector square roots are exact - and
+ abandons a block after the same number of points. Both are also checked against a plain double
+ precision sum.
+ */
+#include "UnitTest.h"
+#include "TCommon.h"
+#include "GestureDistance.h"
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+// armv7 NEON has no vector square root, only an estimate (see gestureSqrt())
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(__aarch64__)
+static const bool kExactSqrt = false;
+#else
+static const bool kExactSqrt = true;
+#endif
+
+static uint32_t seed = 1;
+
+static float randomFloat(float range) {
+	seed = seed * 1664525 + 1013904223;
+	return range * (seed >> 8) / (float)(1 << 24);
+}
+
+struct Block {
+	vector<float> bx, by, tx, ty;
+	int numPoints;
+
+	explicit Block(int n) : bx(n*kGestureLanes), by(n*kGestureLanes), tx(n), ty(n), numPoints(n) {
+		for (int i=0; i<n; i++) {
+			tx[i] = randomFloat(320);
+			ty[i] = randomFloat(216);
+			for (int lane=0; lane<kGestureLanes; lane++) {
+				// lane 0 near the trace, the rest further and further off
+				bx[i*kGestureLanes + lane] = tx[i] + randomFloat(8 + 40*lane) - (4 + 20*lane);
+				by[i*kGestureLanes + lane] = ty[i] + randomFloat(8 + 40*lane) - (4 + 20*lane);
+			}
+		}
+	}
+
+	double reference(int lane) const {
+		double sum = 0;
+		for (int i=0; i<numPoints; i++) {
+			double dx = bx[i*kGestureLanes + lane] - tx[i];
+			double dy = by[i*kGestureLanes + lane] - ty[i];
+			sum += sqrt(dx*dx + dy*dy);
+		}
+		return sum;
+	}
+};
+
+/// runs both kernels on 'block' with 'limit', and compares them
+static void compare(const Block& block, const float* limit) {
+	float scalar[kGestureLanes], simd[kGestureLanes];
+	memset(simd, 0xff, sizeof(simd));
+	const int n = block.numPoints;
+	const int scalarPoints = gestureDistanceScalar(&block.bx[0], &block.by[0], &block.tx[0], &block.ty[0], n, limit, scalar);
+	const int vectorPoints = gestureDistance(&block.bx[0], &block.by[0], &block.tx[0], &block.ty[0], n, limit, simd);
+	CHECK(scalarPoints >= TMin(n, kGestureAbandonStep) && scalarPoints <= n);
+	if (kExactSqrt) {
+		CHECK_EQ(vectorPoints, scalarPoints);
+		CHECK(memcmp(scalar, simd, sizeof(scalar)) == 0);
+	}
+	else {
+		for (int lane=0; lane<kGestureLanes; lane++)
+			CHECK(fabsf(simd[lane] - scalar[lane]) <= 1e-3f * TMax(scalar[lane], 1.0f));
+	}
+	if (scalarPoints == n) {
+		for (int lane=0; lane<kGestureLanes; lane++)
+			CHECK(fabs(scalar[lane] - block.reference(lane)) <= 1e-4 * TMax(block.reference(lane), 1.0));
+	}
+}
+
+static void testFullSums() {
+	float noLimit[kGestureLanes];
+	for (int lane=0; lane<kGestureLanes; lane++)
+		noLimit[lane] = INFINITY;
+	// short ones, ones around the abandon step, and the usual resampled length
+	static const int lengths[] = { 1, 2, 7, 8, 9, 15, 16, 17, 32, 33, 64 };
+	for (int n: lengths) {
+		for (int rep=0; rep<20; rep++)
+			compare(Block(n), noLimit);
+	}
+}
+
+static void testAbandon() {
+	for (int rep=0; rep<200; rep++) {
+		Block block(32);
+		// a limit near each lane's total, so some blocks are abandoned part way and some aren't
+		float limit[kGestureLanes];
+		for (int lane=0; lane<kGestureLanes; lane++)
+			limit[lane] = (float)block.reference(lane) * (0.2f + randomFloat(1.0f));
+		compare(block, limit);
+	}
+
+	// over every limit after the first step - both stop there
+	Block block(32);
+	float limit[kGestureLanes];
+	for (int lane=0; lane<kGestureLanes; lane++)
+		limit[lane] = -1;
+	float sums[kGestureLanes];
+	CHECK_EQ(gestureDistanceScalar(&block.bx[0], &block.by[0], &block.tx[0], &block.ty[0], 32, limit, sums), kGestureAbandonStep);
+	CHECK_EQ(gestureDistance(&block.bx[0], &block.by[0], &block.tx[0], &block.ty[0], 32, limit, sums), kGestureAbandonStep);
+	compare(block, limit);
+}
+
+static void testIdentical() {
+	Block block(32);
+	for (int i=0; i<32; i++) {
+		for (int lane=0; lane<kGestureLanes; lane++) {
+			block.bx[i*kGestureLanes + lane] = block.tx[i];
+			block.by[i*kGestureLanes + lane] = block.ty[i];
+		}
+	}
+	float noLimit[kGestureLanes], sums[kGestureLanes];
+	for (int lane=0; lane<kGestureLanes; lane++)
+		noLimit[lane] = INFINITY;
+	CHECK_EQ(gestureDistance(&block.bx[0], &block.by[0], &block.tx[0], &block.ty[0], 32, noLimit, sums), 32);
+	for (int lane=0; lane<kGestureLanes; lane++)
+		CHECK(sums[lane] == 0);
+}
+
+int main() {
+	printf("kernel: %s\n", gestureDistanceKernel());
+
+	RUN_TEST(testFullSums);
+	RUN_TEST(testAbandon);
+	RUN_TEST(testIdentical);
+
+	return testResult();
+}
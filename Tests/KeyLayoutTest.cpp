@@ -0,0 +1,125 @@
+/**
+ KeyLayout: the grid index finds the same keys as checking every key - keyAt() the one containing
+ the point, nearestKey() the closest - including for layouts big enough to need wide cell offsets.
+ And nothing is found until build().
+ */
+#include "UnitTest.h"
+#include "KeyLayout.h"
+#include <math.h>
+
+using namespace std;
+
+/// the first key containing the point, checking them all
+static const SwipeKey* keyAtByScan(const KeyLayout& layout, float px, float py) {
+	for (int i=0; i<layout.size(); i++) {
+		if (layout[i].contains(px, py))
+			return &layout[i];
+	}
+	return nullptr;
+}
+
+/// the closest distance to any key, checking them all
+static float nearestByScan(const KeyLayout& layout, float px, float py) {
+	float best = INFINITY;
+	for (int i=0; i<layout.size(); i++) {
+		const SwipeKey& k = layout[i];
+		float dx = TMax(TMax(k.x - px, px - (k.x + k.w)), 0.0f);
+		float dy = TMax(TMax(k.y - py, py - (k.y + k.h)), 0.0f);
+		best = TMin(best, sqrtf(dx*dx + dy*dy));
+	}
+	return best;
+}
+
+/// keyAt() and nearestKey() against the scans, over a grid of points a bit bigger than the layout
+static int countMismatches(const KeyLayout& layout, float width, float height) {
+	int wrong = 0;
+	for (float py = -20; py < height + 20; py += 1.7f) {
+		for (float px = -20; px < width + 20; px += 1.3f) {
+			wrong += layout.keyAt(px, py) != keyAtByScan(layout, px, py);
+			float distance;
+			const SwipeKey* nearest = layout.nearestKey(px, py, &distance);
+			// ties can go to either key, but not at a different distance
+			wrong += !nearest || fabsf(distance - nearestByScan(layout, px, py)) > 1e-4f;
+		}
+	}
+	return wrong;
+}
+
+static void testQwerty() {
+	KeyLayout layout;
+	layout.setQwerty(320, 216);
+	CHECK_EQ(layout.size(), 26);
+	CHECK(fabsf(layout.getKeyWidth() - 32) < 1e-4f);
+	CHECK_EQ(countMismatches(layout, 320, 216), 0);
+
+	const SwipeKey* q = layout.findKey('q');
+	CHECK(q != nullptr);
+	if (q) {
+		CHECK(layout.keyAt(q->centreX(), q->centreY()) == q);
+		CHECK(layout.findKey('Q') == q);
+	}
+	CHECK(layout.findKey('1') == nullptr);
+	CHECK(layout.findKey(-1) == nullptr);
+}
+
+static void testNotBuilt() {
+	KeyLayout layout;
+	CHECK(layout.keyAt(10, 10) == nullptr);
+	float distance = 0;
+	CHECK(layout.nearestKey(10, 10, &distance) == nullptr);
+	CHECK(isinf(distance));
+
+	layout.addKey(0, 0, 0, 40, 40);
+	layout.addKey(1, 40, 0, 40, 40);
+	CHECK(layout.keyAt(10, 10) == nullptr);
+	layout.build();
+	CHECK(layout.keyAt(10, 10) == &layout[0]);
+	CHECK(layout.keyAt(50, 10) == &layout[1]);
+	CHECK(fabsf(layout.getKeyWidth() - 40) < 1e-4f);
+
+	// out of date again until the next build()
+	layout.addKey(2, 80, 0, 40, 40);
+	CHECK(layout.keyAt(10, 10) == nullptr);
+	layout.build();
+	CHECK(layout.keyAt(90, 10) == &layout[2]);
+
+	layout.clear();
+	layout.build();
+	CHECK(layout.empty());
+	CHECK(layout.keyAt(10, 10) == nullptr);
+}
+
+/// keys of very different sizes, overlapping, with gaps - every cell lists many of them
+static void testCrowded() {
+	KeyLayout layout;
+	for (int i=0; i<250; i++) {
+		const float x = (float)((i * 37) % 300);
+		const float y = (float)((i * 91) % 200);
+		const float size = (i % 10 == 0) ? 120.0f : 2.0f + i % 7;
+		layout.addKey(i, x, y, size, size * 0.8f);
+	}
+	layout.build();
+	CHECK_EQ(layout.size(), 250);
+	CHECK_EQ(countMismatches(layout, 420, 300), 0);
+}
+
+/// many keys over a fine grid - more cell entries than 16-bit offsets can hold
+static void testManyCellEntries() {
+	KeyLayout layout;
+	// a row of tiny keys sets the cell size, a block of big ones overlapping everywhere fills the cells
+	for (int i=0; i<40; i++)
+		layout.addKey(i, i * 2.0f, 0, 2, 2);
+	for (int i=40; i<256; i++)
+		layout.addKey(i, (float)(i % 8), 2 + (float)(i % 5), 120, 120);
+	layout.build();
+	CHECK_EQ(countMismatches(layout, 130, 130), 0);
+}
+
+int main() {
+	RUN_TEST(testQwerty);
+	RUN_TEST(testNotBuilt);
+	RUN_TEST(testCrowded);
+	RUN_TEST(testManyCellEntries);
+
+	return testResult();
+}
@@ -0,0 +1,188 @@
+/**
+ SwipeTrace: gestures and layouts written by SwipeTraceWriter come back from SwipeTraceReader as
+ they went in (to the 1/kTraceCoordScale point and the ms), through next() and read() alike, and
+ across writers appending to the same file - and a record cut short is just the end of the corpus.
+ */
+#include "UnitTest.h"
+#include "KeyLayout.h"
+#include "SwipeTrace.h"
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+static string testDir;
+
+struct Gesture {
+	vector<SwipePoint> points;
+	string word;
+	const KeyLayout* layout;
+};
+
+/// a wiggly gesture of 'count' points, on the coordinate grid so it round trips exactly
+static Gesture makeGesture(int count, const char* word, const KeyLayout* layout, int seed) {
+	Gesture g;
+	g.word = word;
+	g.layout = layout;
+	const TDateTime start(1000000 + seed, 0);
+	int ms = 0;
+	for (int i=0; i<count; i++) {
+		SwipePoint pt;
+		pt.pPoint.x = ((i * 37 + seed * 11) % 1280) / (float)kTraceCoordScale;
+		pt.pPoint.y = ((i * 53 + seed * 7) % 864) / (float)kTraceCoordScale - 10;
+		ms += (i * 7 + seed) % 23;
+		pt.pTime = start + TDateTime(ms / 1000, (ms % 1000) * 1000);
+		// runs of keys, and no key
+		pt.key = (i / 3 + seed) % 5 == 0 ? -1 : 'a' + (i / 3 + seed) % 26;
+		g.points.push_back(pt);
+	}
+	return g;
+}
+
+static void checkSame(const Gesture& expected, const SwipeTrace& trace) {
+	CHECK(trace.word == expected.word);
+	CHECK_EQ(trace.points.size(), expected.points.size());
+	if (trace.points.size() != expected.points.size())
+		return;
+	CHECK((trace.layout == nullptr) == (expected.layout == nullptr));
+	if (trace.layout && expected.layout)
+		CHECK(*trace.layout == *expected.layout);
+	int wrong = 0;
+	for (size_t i=0; i<trace.points.size(); i++) {
+		const SwipePoint& a = trace.points[i];
+		const SwipePoint& b = expected.points[i];
+		wrong += a.pPoint.x != b.pPoint.x || a.pPoint.y != b.pPoint.y || a.key != b.key;
+		wrong += (a.pTime - trace.points[0].pTime).asMs() != (b.pTime - expected.points[0].pTime).asMs();
+	}
+	CHECK_EQ(wrong, 0);
+}
+
+static void write(SwipeTraceWriter& writer, const Gesture& g) {
+	if (g.layout)
+		writer.setKeyLayout(*g.layout);
+	CHECK(writer.write(&g.points[0], (int)g.points.size(), g.word.c_str()));
+}
+
+static void testRoundTrip() {
+	const string path = testDir + "/roundtrip.qtr";
+	KeyLayout qwerty, small;
+	qwerty.setQwerty(320, 216);
+	small.setQwerty(160, 100);
+
+	vector<Gesture> gestures;
+	gestures.push_back(makeGesture(1, "a", &qwerty, 1));
+	gestures.push_back(makeGesture(40, "hello", &qwerty, 2));
+	gestures.push_back(makeGesture(300, "supercalifragilistic", &qwerty, 3));
+	gestures.push_back(makeGesture(25, "", &small, 4));
+	gestures.push_back(makeGesture(60, "back", &qwerty, 5));
+	{
+		SwipeTraceWriter writer;
+		CHECK(writer.open(path));
+		for (auto& g: gestures)
+			write(writer, g);
+		CHECK_EQ(writer.gestureCount(), (int)gestures.size());
+	}
+	// another session appending - its gestures are still on 'qwerty'
+	{
+		SwipeTraceWriter writer;
+		CHECK(writer.open(path));
+		gestures.push_back(makeGesture(33, "again", &qwerty, 6));
+		write(writer, gestures.back());
+	}
+
+	SwipeTraceReader reader;
+	CHECK(reader.open(path));
+	SwipeTrace trace;
+	size_t n = 0;
+	for (; reader.next(trace); n++) {
+		CHECK(n < gestures.size());
+		if (n < gestures.size())
+			checkSame(gestures[n], trace);
+	}
+	CHECK_EQ(n, gestures.size());
+	CHECK_EQ(reader.position(), reader.size());
+
+	reader.rewind();
+	CHECK(reader.next(trace));
+	checkSame(gestures[0], trace);
+
+	// by number, in any order
+	CHECK_EQ(reader.buildIndex(), (int)gestures.size());
+	for (int i=(int)gestures.size()-1; i>=0; i--) {
+		CHECK(reader.read(i, trace));
+		checkSame(gestures[i], trace);
+	}
+	CHECK(!reader.read((int)gestures.size(), trace));
+	CHECK(!reader.read(-1, trace));
+	// next() carries on where it was
+	CHECK(reader.next(trace));
+	checkSame(gestures[1], trace);
+}
+
+static void testNoLayout() {
+	const string path = testDir + "/nolayout.qtr";
+	Gesture g = makeGesture(20, "plain", nullptr, 9);
+	{
+		SwipeTraceWriter writer;
+		CHECK(writer.open(path));
+		write(writer, g);
+	}
+	SwipeTraceReader reader;
+	CHECK(reader.open(path));
+	SwipeTrace trace;
+	CHECK(reader.next(trace));
+	checkSame(g, trace);
+	CHECK(!reader.next(trace));
+}
+
+/// the app died writing the last gesture
+static void testTornRecord() {
+	const string path = testDir + "/torn.qtr";
+	KeyLayout qwerty;
+	qwerty.setQwerty(320, 216);
+	Gesture first = makeGesture(30, "first", &qwerty, 1);
+	{
+		SwipeTraceWriter writer;
+		CHECK(writer.open(path));
+		write(writer, first);
+		write(writer, makeGesture(30, "second", &qwerty, 2));
+	}
+	FILE* f = fopen(path.c_str(), "rb");
+	vector<char> data(4096);
+	data.resize(fread(&data[0], 1, data.size(), f));
+	fclose(f);
+	f = fopen(path.c_str(), "wb");
+	fwrite(&data[0], 1, data.size() - 5, f);
+	fclose(f);
+
+	SwipeTraceReader reader;
+	CHECK(reader.open(path));
+	SwipeTrace trace;
+	CHECK(reader.next(trace));
+	checkSame(first, trace);
+	CHECK(!reader.next(trace));
+	CHECK_EQ(reader.buildIndex(), 1);
+}
+
+static void testNotACorpus() {
+	const string path = testDir + "/other.txt";
+	FILE* f = fopen(path.c_str(), "w");
+	fputs("hello world\n", f);
+	fclose(f);
+	SwipeTraceReader reader;
+	CHECK(!reader.open(path));
+	SwipeTraceWriter writer;
+	CHECK(!writer.open(path));
+}
+
+int main() {
+	testDir = makeTestDir("swipe_trace_test");
+
+	RUN_TEST(testRoundTrip);
+	RUN_TEST(testNoLayout);
+	RUN_TEST(testTornRecord);
+	RUN_TEST(testNotACorpus);
+
+	removeTestDir(testDir);
+	return testResult();
+}
@@ -0,0 +1,84 @@
+#ifndef _UnitTest_h
+#define _UnitTest_h
+
+/**
+ The little the unit tests need, without a framework: a CHECK that reports where it failed and
+ carries on, and a main() that runs the tests and fails if any CHECK did - which is all ctest looks
+ at. Each test file is its own executable (see CMakeLists.txt):
+
+	static void testSomething() {
+		CHECK(1 + 1 == 2);
+		CHECK_EQ(sizeof(int), 4);
+	}
+
+	int main() {
+		RUN_TEST(testSomething);
+		return testResult();
+	}
+
+ Scratch files go in a directory of their own (makeTestDir()), removed again by removeTestDir().
+ */
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+static int gTestFailures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			gTestFailures++; \
+		} \
+	} while (0)
+
+/// for integers - prints both sides when they differ
+#define CHECK_EQ(a, b) \
+	do { \
+		const long long _a = (long long)(a), _b = (long long)(b); \
+		if (_a != _b) { \
+			fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+			gTestFailures++; \
+		} \
+	} while (0)
+
+#define RUN_TEST(fn) \
+	do { \
+		const int _before = gTestFailures; \
+		fn(); \
+		printf("%s %s\n", gTestFailures == _before ? "ok  " : "FAIL", #fn); \
+	} while (0)
+
+static inline int testResult() {
+	if (gTestFailures)
+		fprintf(stderr, "%d check(s) failed\n", gTestFailures);
+	return gTestFailures ? 1 : 0;
+}
+
+/// a new, empty directory under $TMPDIR (or /tmp)
+static inline std::string makeTestDir(const char* name) {
+	const char* tmp = getenv("TMPDIR");
+	std::string path = std::string(tmp && *tmp ? tmp : "/tmp") + "/" + name + ".XXXXXX";
+	if (!mkdtemp(&path[0])) {
+		fprintf(stderr, "Can't make a directory '%s'\n", path.c_str());
+		exit(1);
+	}
+	return path;
+}
+
+/// deletes everything in 'path', then the directory
+static inline void removeTestDir(const std::string& path) {
+	if (DIR* dir = opendir(path.c_str())) {
+		while (struct dirent* entry = readdir(dir)) {
+			const std::string name = entry->d_name;
+			if (name != "." && name != ".." && unlink((path + "/" + name).c_str()) != 0)
+				removeTestDir(path + "/" + name);
+		}
+		closedir(dir);
+	}
+	rmdir(path.c_str());
+}
+
+#endif
@@ -0,0 +1,287 @@
+/**
+ UserDictionary: counts survive closing and reopening, and a crash while writing the log or a
+ snapshot loses at most the record it was writing - nothing is dropped or counted twice.
+ */
+#include "UnitTest.h"
+#include "Lexicon.h"
+#include "UserDictionary.h"
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+static string testDir;
+static Lexicon lexicon;
+
+static void writeFile(const string& path, const char* text) {
+	FILE* f = fopen(path.c_str(), "wb");
+	fputs(text, f);
+	fclose(f);
+}
+
+static bool readBytes(const string& path, vector<char>& out) {
+	FILE* f = fopen(path.c_str(), "rb");
+	if (!f)
+		return false;
+	out.clear();
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		out.insert(out.end(), buf, buf + n);
+	fclose(f);
+	return true;
+}
+
+static void writeBytes(const string& path, const vector<char>& data) {
+	FILE* f = fopen(path.c_str(), "wb");
+	fwrite(data.data(), 1, data.size(), f);
+	fclose(f);
+}
+
+static bool fileExists(const string& path) {
+	return access(path.c_str(), F_OK) == 0;
+}
+
+static int countOf(const UserDictionary& user, const char* word) {
+	return user.count(word, (int)strlen(word));
+}
+
+static void learn(UserDictionary& user, const char* word, int times = 1) {
+	for (int i=0; i<times; i++)
+		CHECK(user.learn(word, (int)strlen(word)));
+}
+
+/// a directory of its own for each test
+static string freshDir(const char* name) {
+	const string dir = testDir + "/" + name;
+	CHECK_EQ(mkdir(dir.c_str(), 0700), 0);
+	return dir;
+}
+
+static void testLearnAndReopen() {
+	const string dir = freshDir("reopen");
+	{
+		UserDictionary user(lexicon);
+		CHECK(user.open(dir));
+		learn(user, "fox", 2);
+		learn(user, "Zorp");
+		CHECK_EQ(countOf(user, "fox"), 2);
+		CHECK_EQ(countOf(user, "zorp"), 1);
+		CHECK_EQ(user.size(), 2);
+		CHECK_EQ(user.newWordCount(), 1);
+		CHECK(!user.learn("no-way", 6));
+	}
+	UserDictionary user(lexicon);
+	CHECK(user.open(dir));
+	CHECK_EQ(countOf(user, "fox"), 2);
+	CHECK_EQ(countOf(user, "ZORP"), 1);
+	CHECK_EQ(countOf(user, "brown"), 0);
+	CHECK_EQ(user.newWordCount(), 1);
+
+	// the new word is in the overlay, under an id after the lexicon's
+	LexCursor at = user.root();
+	for (const char* c = "zorp"; *c; c++)
+		CHECK(user.child(at, *c));
+	CHECK(user.isWord(at));
+	CHECK(at.wordId >= (uint32_t)lexicon.wordCount());
+	char word[Lexicon::kMaxWordLen + 1] = {};
+	CHECK_EQ(user.word(at.wordId, word), 4);
+	CHECK(strcmp(word, "zorp") == 0);
+}
+
+static void testForget() {
+	const string dir = freshDir("forget");
+	{
+		UserDictionary user(lexicon);
+		CHECK(user.open(dir));
+		learn(user, "zorp");
+		learn(user, "blip", 3);
+		learn(user, "quick");
+		CHECK(user.forget("zorp", 4));
+		CHECK(user.forget("quick", 5));
+		CHECK(!user.forget("brown", 5));
+		CHECK_EQ(countOf(user, "zorp"), 0);
+		CHECK_EQ(countOf(user, "quick"), 0);
+		CHECK_EQ(countOf(user, "blip"), 3);
+		CHECK_EQ(user.newWordCount(), 1);
+		LexCursor at = user.root();
+		CHECK(!user.child(at, 'z'));
+	}
+	UserDictionary user(lexicon);
+	CHECK(user.open(dir));
+	CHECK_EQ(countOf(user, "zorp"), 0);
+	CHECK_EQ(countOf(user, "quick"), 0);
+	CHECK_EQ(countOf(user, "blip"), 3);
+	CHECK_EQ(user.size(), 1);
+}
+
+/// the app died part way through appending a record
+static void testTornLogRecord() {
+	const string dir = freshDir("torn");
+	const string log = dir + "/user.1.log";
+	{
+		UserDictionary user(lexicon);
+		CHECK(user.open(dir));
+		learn(user, "zorp");
+		learn(user, "blip");
+	}
+	vector<char> data;
+	CHECK(readBytes(log, data));
+	CHECK(data.size() > 3);
+	data.resize(data.size() - 2);
+	writeBytes(log, data);
+
+	{
+		UserDictionary user(lexicon);
+		CHECK(user.open(dir));
+		CHECK_EQ(countOf(user, "zorp"), 1);
+		CHECK_EQ(countOf(user, "blip"), 0);
+		// has to be read back after the torn record
+		learn(user, "blip");
+		learn(user, "fox");
+	}
+	UserDictionary user(lexicon);
+	CHECK(user.open(dir));
+	CHECK_EQ(countOf(user, "zorp"), 1);
+	CHECK_EQ(countOf(user, "blip"), 1);
+	CHECK_EQ(countOf(user, "fox"), 1);
+	CHECK_EQ(user.size(), 3);
+}
+
+/// the app died after creating a log, before its header was written
+static void testEmptyLog() {
+	const string dir = freshDir("empty");
+	writeFile(dir + "/user.1.log", "");
+	{
+		UserDictionary user(lexicon);
+		CHECK(user.open(dir));
+		CHECK_EQ(user.size(), 0);
+		learn(user, "zorp");
+	}
+	UserDictionary user(lexicon);
+	CHECK(user.open(dir));
+	CHECK_EQ(countOf(user, "zorp"), 1);
+}
+
+static void testCompaction() {
+	const string dir = freshDir("compact");
+	{
+		UserDictionary user(lexicon);
+		user.getConfig().compactAfter = 4;
+		CHECK(user.open(dir));
+		// a couple of compactions on the way
+		learn(user, "fox", 5);
+		learn(user, "zorp", 3);
+		learn(user, "blip");
+		user.waitForCompaction();
+		CHECK(user.compact());
+		user.waitForCompaction();
+		CHECK(fileExists(dir + "/user.dict"));
+		CHECK(!fileExists(dir + "/user.1.log"));
+		learn(user, "blip");
+	}
+	UserDictionary user(lexicon);
+	CHECK(user.open(dir));
+	CHECK_EQ(countOf(user, "fox"), 5);
+	CHECK_EQ(countOf(user, "zorp"), 3);
+	CHECK_EQ(countOf(user, "blip"), 2);
+	CHECK_EQ(user.newWordCount(), 2);
+}
+
+/// the app died while the snapshot was being written - before it was renamed into place
+static void testCrashBeforeSnapshotRename() {
+	const string dir = freshDir("beforerename");
+	{
+		UserDictionary user(lexicon);
+		CHECK(user.open(dir));
+		learn(user, "fox", 2);
+		learn(user, "zorp");
+	}
+	writeFile(dir + "/user.dict.tmp", "QUSR half a snapsh");
+	{
+		UserDictionary user(lexicon);
+		CHECK(user.open(dir));
+		CHECK_EQ(countOf(user, "fox"), 2);
+		CHECK_EQ(countOf(user, "zorp"), 1);
+		// and the next compaction still gets written
+		CHECK(user.compact());
+		user.waitForCompaction();
+		CHECK(!fileExists(dir + "/user.dict.tmp"));
+	}
+	UserDictionary user(lexicon);
+	CHECK(user.open(dir));
+	CHECK_EQ(countOf(user, "fox"), 2);
+	CHECK_EQ(countOf(user, "zorp"), 1);
+}
+
+/// the app died after the snapshot was renamed into place, before the logs in it were deleted
+static void testCrashBeforeLogsDeleted() {
+	const string dir = freshDir("afterrename");
+	const string log = dir + "/user.1.log";
+	vector<char> data;
+	{
+		UserDictionary user(lexicon);
+		CHECK(user.open(dir));
+		learn(user, "fox", 2);
+		learn(user, "zorp");
+		CHECK(readBytes(log, data));
+		CHECK(user.compact());
+		user.waitForCompaction();
+		CHECK(!fileExists(log));
+		learn(user, "zorp");
+	}
+	writeBytes(log, data);
+
+	UserDictionary user(lexicon);
+	CHECK(user.open(dir));
+	CHECK_EQ(countOf(user, "fox"), 2);
+	CHECK_EQ(countOf(user, "zorp"), 2);
+}
+
+/// the ids change with the lexicon, the counts don't
+static void testNewLexicon() {
+	const string dir = freshDir("relex");
+	Lexicon lex;
+	CHECK(lex.load(testDir + "/words.txt"));
+	UserDictionary user(lex);
+	CHECK(user.open(dir));
+	learn(user, "zorp", 2);
+	learn(user, "fox");
+	CHECK_EQ(user.newWordCount(), 1);
+
+	user.detach();
+	CHECK(lex.load(testDir + "/more_words.txt"));
+	user.rebuild();
+	CHECK_EQ(countOf(user, "zorp"), 2);
+	CHECK_EQ(countOf(user, "fox"), 1);
+	CHECK_EQ(user.size(), 2);
+	CHECK_EQ(user.newWordCount(), 0);
+	// now a lexicon word, boosted by what the user typed
+	const int id = lex.lookup("zorp", 4);
+	CHECK(id >= 0);
+	CHECK(user.logPrior(id) > lex.logPrior(id));
+}
+
+int main() {
+	testDir = makeTestDir("user_dictionary_test");
+	writeFile(testDir + "/words.txt", "the 1000000\nquick 500\nbrown 300\nfox 200\n");
+	writeFile(testDir + "/more_words.txt", "the 1000000\nquick 500\nbrown 300\nfox 200\nzorp 1\n");
+	if (!lexicon.load(testDir + "/words.txt")) {
+		fprintf(stderr, "Can't load the test lexicon\n");
+		return 1;
+	}
+
+	RUN_TEST(testLearnAndReopen);
+	RUN_TEST(testForget);
+	RUN_TEST(testTornLogRecord);
+	RUN_TEST(testEmptyLog);
+	RUN_TEST(testCompaction);
+	RUN_TEST(testCrashBeforeSnapshotRename);
+	RUN_TEST(testCrashBeforeLogsDeleted);
+	RUN_TEST(testNewLexicon);
+
+	removeTestDir(testDir);
+	return testResult();
+}
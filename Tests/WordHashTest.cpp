@@ -0,0 +1,203 @@
+/**
+ WordHash: every key gets back its own id, strings that aren't keys get -1 - because their slot's
+ fingerprint doesn't match - and a written and mapped hash answers the same as the one built.
+ Also Lexicon::lookup() against the trie, before and after compiling.
+ */
+#include "UnitTest.h"
+#include "Lexicon.h"
+#include "TFile.h"
+#include "WordHash.h"
+#include <ctype.h>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+static const int kNumWords = 20000;
+
+static string testDir;
+static vector<string> words;
+
+/// distinct lowercase words of 3-9 letters
+static void makeWords() {
+	uint32_t seed = 12345;
+	for (int i=0; i<kNumWords; i++) {
+		char word[16];
+		int len = 3 + i % 7;
+		for (int j=0; j<len; j++) {
+			seed = seed * 1664525 + 1013904223;
+			word[j] = 'a' + (seed >> 16) % 26;
+		}
+		// the id keeps them distinct
+		len += snprintf(word + len, sizeof(word) - len, "%d", i);
+		words.push_back(string(word, len));
+	}
+}
+
+static bool buildHash(WordHash& hash) {
+	vector<uint64_t> keys;
+	for (auto& w: words)
+		keys.push_back(WordHash::hashWord(w.c_str(), (int)w.size()));
+	return hash.build(keys);
+}
+
+/// the number of strings like the words that aren't - should be none
+static int countFalseHits(const WordHash& hash) {
+	int hits = 0;
+	for (int i=0; i<kNumWords; i++) {
+		// words[i] with another word's number on the end
+		string w = words[i];
+		while (!w.empty() && isdigit((unsigned char)w.back()))
+			w.pop_back();
+		char number[16];
+		w.append(number, snprintf(number, sizeof(number), "%d", kNumWords + i));
+		hits += hash.find(w.c_str(), (int)w.size()) >= 0;
+		hits += hash.find(words[i].c_str(), (int)words[i].size() - 1) >= 0;
+	}
+	return hits;
+}
+
+static void testFind() {
+	WordHash hash;
+	CHECK(buildHash(hash));
+	CHECK_EQ(hash.size(), kNumWords);
+	int wrong = 0;
+	for (int i=0; i<kNumWords; i++)
+		wrong += hash.find(words[i].c_str(), (int)words[i].size()) != i;
+	CHECK_EQ(wrong, 0);
+
+	// case folded, like the lexicon
+	string upper = words[7];
+	for (auto& c: upper)
+		c = (char)toupper((unsigned char)c);
+	CHECK_EQ(hash.find(upper.c_str(), (int)upper.size()), 7);
+}
+
+static void testMisses() {
+	WordHash hash;
+	CHECK(buildHash(hash));
+	CHECK_EQ(countFalseHits(hash), 0);
+	CHECK_EQ(hash.find("", 0), -1);
+}
+
+static void testBadKeys() {
+	WordHash hash;
+	CHECK(!hash.build(vector<uint64_t>()));
+	CHECK(hash.empty());
+	// duplicates can't each have a slot
+	vector<uint64_t> keys(3, WordHash::hashWord("same", 4));
+	CHECK(!hash.build(keys));
+	CHECK(hash.empty());
+	CHECK_EQ(hash.find("same", 4), -1);
+}
+
+/// written out, read back as one 8-byte aligned block
+static bool writeAndRead(const WordHash& hash, vector<uint64_t>& data) {
+	const string path = testDir + "/hash.bin";
+	{
+		TFileWriter fw(path);
+		if (!fw.isOpen() || hash.write(fw) != hash.serialisedSize())
+			return false;
+	}
+	data.assign(hash.serialisedSize() / 8, 0);
+	FILE* f = fopen(path.c_str(), "rb");
+	if (!f)
+		return false;
+	const bool ok = fread(&data[0], 1, hash.serialisedSize(), f) == hash.serialisedSize();
+	fclose(f);
+	return ok;
+}
+
+static void testMapped() {
+	WordHash built;
+	CHECK(buildHash(built));
+	CHECK_EQ(built.serialisedSize() % 8, 0);
+	vector<uint64_t> data;
+	CHECK(writeAndRead(built, data));
+
+	WordHash mapped;
+	CHECK(mapped.map(&data[0], data.size() * 8));
+	CHECK_EQ(mapped.size(), kNumWords);
+	int wrong = 0;
+	for (int i=0; i<kNumWords; i++)
+		wrong += mapped.find(words[i].c_str(), (int)words[i].size()) != i;
+	CHECK_EQ(wrong, 0);
+	CHECK_EQ(countFalseHits(mapped), 0);
+
+	// too short, or not aligned
+	WordHash bad;
+	CHECK(!bad.map(&data[0], data.size() * 8 - 8));
+	CHECK(!bad.map((const char*)&data[0] + 4, data.size() * 8 - 8));
+}
+
+/// with every fingerprint wrong even the keys are rejected - so that's what turns the misses away
+static void testFingerprintReject() {
+	WordHash built;
+	CHECK(buildHash(built));
+	vector<uint64_t> data;
+	CHECK(writeAndRead(built, data));
+
+	// the fingerprints are last, as 32-bit words, then maybe 4 bytes of padding - flipping the last
+	// numKeys+1 words gets them all (and the padding, or the last slot id)
+	uint32_t* words32 = (uint32_t*)&data[0];
+	const size_t numWords32 = data.size() * 2;
+	for (size_t i = numWords32 - kNumWords - 1; i < numWords32; i++)
+		words32[i] ^= 0x80000000;
+
+	WordHash mapped;
+	CHECK(mapped.map(&data[0], data.size() * 8));
+	int hits = 0;
+	for (int i=0; i<kNumWords; i++)
+		hits += mapped.find(words[i].c_str(), (int)words[i].size()) >= 0;
+	CHECK_EQ(hits, 0);
+}
+
+static void testLexiconLookup() {
+	const string list = testDir + "/words.txt";
+	FILE* f = fopen(list.c_str(), "w");
+	for (int i=0; i<kNumWords; i++) {
+		// letters only
+		string w = words[i];
+		for (auto& c: w)
+			if (isdigit((unsigned char)c))
+				c = (char)('a' + (c - '0'));
+		fprintf(f, "%s %d\n", w.c_str(), 1 + i);
+	}
+	fclose(f);
+
+	Lexicon lexicon;
+	CHECK(lexicon.load(list));
+	CHECK(lexicon.wordCount() > 0);
+	const string compiled = testDir + "/words.lex";
+	CHECK(lexicon.save(compiled));
+	Lexicon mapped;
+	CHECK(mapped.load(compiled));
+	CHECK(mapped.isMapped());
+	CHECK_EQ(mapped.wordCount(), lexicon.wordCount());
+
+	int wrong = 0;
+	for (int id=0; id<lexicon.wordCount(); id++) {
+		const string w = lexicon.word(id);
+		wrong += lexicon.lookup(w.c_str(), (int)w.size()) != id;
+		wrong += lexicon.find(w) != id;
+		wrong += mapped.lookup(w.c_str(), (int)w.size()) != id;
+		wrong += mapped.word(id) != w;
+	}
+	CHECK_EQ(wrong, 0);
+	CHECK_EQ(mapped.lookup("notaword", 8), -1);
+}
+
+int main() {
+	testDir = makeTestDir("word_hash_test");
+	makeWords();
+
+	RUN_TEST(testFind);
+	RUN_TEST(testMisses);
+	RUN_TEST(testBadKeys);
+	RUN_TEST(testMapped);
+	RUN_TEST(testFingerprintReject);
+	RUN_TEST(testLexiconLookup);
+
+	removeTestDir(testDir);
+	return testResult();
+}
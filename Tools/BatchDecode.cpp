@@ -0,0 +1,172 @@
+/**
+ Decodes a whole trace corpus (see SwipeTrace.h) on every core at once (see SwipeBatchDecoder), and
+ reports the accuracy against the recorded words and the throughput:
+
+	batch_decode traces.qtr [-data Data] [-threads 0] [-nolayout] [-scaling] [-cache 0] [-o results.tsv] [-log]
+
+ -threads 0 (the default) is one per core. -scaling decodes it again with 1, 2, 4 ... threads up to
+ that, to show how the throughput scales. -o writes a line per gesture: its number, the recorded
+ word, the decoded words best first, and the decode time in us. -cache n gives each worker's
+ decoder a result cache of n gestures (see SwipeResultCache) - off by default, as with it the
+ results change from run to run with more than one thread.
+
+ The decoder's debug logging goes to /dev/null unless -log is given, so that stdout is just the report.
+ */
+#include "TCommon.h"
+#include "SwipeBatchDecoder.h"
+#include "SwipeTrace.h"
+#include "TDateTime.h"
+#include "TFile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+/// the real stdout - the logging doesn't go there
+static FILE* report = stdout;
+
+static double msSince(const TDateTime& start) {
+	timeval tv = (TDateTime::now() - start).asTV();
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static int usage(const char* name) {
+	fprintf(stderr, "usage: %s <traces.qtr> [-data dir] [-threads n] [-nolayout] [-scaling] [-cache n] [-o results.tsv] [-log]\n", name);
+	return 1;
+}
+
+/// decodes the corpus on 'numThreads' and prints a line about it - returns the gestures per second, 0 if it failed
+static double run(SwipeBatchDecoder& batch, int numThreads, const SwipeBatchDecoder::Setup& setup, const SwipeTraceReader& corpus,
+				  vector<SwipeBatchResult>& results) {
+	TDateTime loadStart = TDateTime::now();
+	if (!batch.start(numThreads, setup))
+		return 0;
+	const double loadMs = msSince(loadStart);
+
+	TDateTime start = TDateTime::now();
+	batch.decode(corpus, results);
+	const double ms = msSince(start);
+	const double perSecond = results.size() * 1000.0 / TMax(ms, 0.001);
+	fprintf(report, "%2d threads: %d gestures in %.0fms, %.0f/s (setup %.0fms)\n", batch.getNumThreads(), (int)results.size(),
+			ms, perSecond, loadMs);
+	return perSecond;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2)
+		return usage(argv[0]);
+	string dataDir = "Data";
+	int numThreads = 0, cacheSize = 0;
+	bool useLayout = true, scaling = false, log = false;
+	const char* outPath = nullptr;
+	for (int i=2; i<argc; i++) {
+		if (!strcmp(argv[i], "-nolayout"))
+			useLayout = false;
+		else if (!strcmp(argv[i], "-scaling"))
+			scaling = true;
+		else if (!strcmp(argv[i], "-log"))
+			log = true;
+		else if (i+1 >= argc)
+			return usage(argv[0]);
+		else if (!strcmp(argv[i], "-data"))
+			dataDir = argv[++i];
+		else if (!strcmp(argv[i], "-threads"))
+			numThreads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-cache"))
+			cacheSize = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-o"))
+			outPath = argv[++i];
+		else
+			return usage(argv[0]);
+	}
+	if (numThreads <= 0)
+		numThreads = TMax((int)std::thread::hardware_concurrency(), 1);
+	if (!log) {
+		report = fdopen(dup(fileno(stdout)), "w");
+		freopen("/dev/null", "w", stdout);
+	}
+
+	SwipeTraceReader corpus;
+	if (!corpus.open(argv[1]) || corpus.buildIndex() == 0) {
+		fprintf(stderr, "no gestures in '%s'\n", argv[1]);
+		return 1;
+	}
+	SwipeBatchDecoder::Setup setup = [&dataDir](SwipeDecoder& decoder) {
+		if (!decoder.loadCharLM(dataDir + "/count_2l.txt", dataDir + "/count_3l.txt") || !decoder.loadLexicon(dataDir + "/count_big.lex"))
+			return false;
+		decoder.loadEdits(dataDir + "/count_1edit.txt");
+		if (TFileReader::fileExists(dataDir + "/count_2w.big"))
+			decoder.loadBigrams(dataDir + "/count_2w.big");
+		return true;
+	};
+
+	SwipeBatchDecoder batch;
+	batch.setUseKeyLayouts(useLayout);
+	batch.setResultCacheSize(cacheSize);
+	vector<SwipeBatchResult> results;
+	if (scaling) {
+		double single = 0;
+		for (int n=1; n<numThreads; n*=2) {
+			const double perSecond = run(batch, n, setup, corpus, results);
+			if (perSecond <= 0) {
+				fprintf(stderr, "failed to load the models from '%s'\n", dataDir.c_str());
+				return 1;
+			}
+			if (n == 1)
+				single = perSecond;
+			else
+				fprintf(report, "    speedup %.2fx, %.0f%% of linear\n", perSecond / single, 100 * perSecond / (single * n));
+		}
+		if (numThreads > 1) {
+			const double perSecond = run(batch, numThreads, setup, corpus, results);
+			if (perSecond > 0)
+				fprintf(report, "    speedup %.2fx, %.0f%% of linear\n", perSecond / single, 100 * perSecond / (single * numThreads));
+		}
+	}
+	if (!scaling || numThreads == 1) {
+		if (run(batch, numThreads, setup, corpus, results) <= 0) {
+			fprintf(stderr, "failed to load the models from '%s'\n", dataDir.c_str());
+			return 1;
+		}
+	}
+	batch.stop();
+
+	FILE* out = outPath ? fopen(outPath, "w") : nullptr;
+	if (outPath && !out) {
+		fprintf(stderr, "can't write '%s'\n", outPath);
+		return 1;
+	}
+	SwipeTrace trace;
+	int top1 = 0, top3 = 0, decoded = 0;
+	int64_t totalUs = 0;
+	for (int i=0; i<(int)results.size(); i++) {
+		const SwipeBatchResult& r = results[i];
+		corpus.read(i, trace);
+		decoded += (r.count > 0);
+		totalUs += r.decodeUs;
+		for (int c=0; c<TMin(r.count, 3); c++) {
+			if (trace.word == r.results[c].word) {
+				top1 += (c == 0);
+				top3++;
+				break;
+			}
+		}
+		if (out) {
+			fprintf(out, "%d\t%s\t", i, trace.word.c_str());
+			for (int c=0; c<r.count; c++)
+				fprintf(out, c ? ",%s" : "%s", r.results[c].word);
+			fprintf(out, "\t%lld\n", (long long)r.decodeUs);
+		}
+	}
+	if (out)
+		fclose(out);
+
+	const double n = TMax((double)results.size(), 1.0);
+	fprintf(report, "%s: %d gestures, %d decoded, top1 %.4f, top3 %.4f, mean decode %.0fus\n", argv[1], (int)results.size(), decoded,
+			top1 / n, top3 / n, totalUs / n);
+	return 0;
+}
@@ -0,0 +1,72 @@
+/**
+ Compiles word bigram counts ("word1 word2<whitespace>count" lines, as in count_2w.txt) against a
+ lexicon into the binary form WordBigrams::load() maps, then maps it back to check it.
+
+	bigram_compiler Data/count_big.lex count_2w.txt count_2w.big
+
+ The ids in the output are the lexicon's, so it has to be rebuilt whenever the lexicon is.
+ */
+#include "TCommon.h"
+#include "Lexicon.h"
+#include "TDateTime.h"
+#include "TFile.h"
+#include "WordBigrams.h"
+#include <stdio.h>
+
+static double msSince(const TDateTime& start) {
+	timeval tv = (TDateTime::now() - start).asTV();
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+int main(int argc, char** argv) {
+	if (argc != 4) {
+		fprintf(stderr, "usage: %s <lexicon> <bigrams.txt> <out.big>\n", argv[0]);
+		return 1;
+	}
+
+	Lexicon lexicon;
+	if (!lexicon.load(argv[1])) {
+		fprintf(stderr, "failed to load '%s'\n", argv[1]);
+		return 1;
+	}
+	TDateTime start = TDateTime::now();
+	WordBigrams source;
+	if (!source.build(argv[2], lexicon)) {
+		fprintf(stderr, "failed to load '%s'\n", argv[2]);
+		return 1;
+	}
+	double buildMs = msSince(start);
+	if (!source.save(argv[3])) {
+		fprintf(stderr, "failed to write '%s'\n", argv[3]);
+		return 1;
+	}
+
+	start = TDateTime::now();
+	WordBigrams compiled;
+	if (!compiled.load(argv[3], lexicon) || !compiled.isMapped()) {
+		fprintf(stderr, "failed to map '%s' back\n", argv[3]);
+		return 1;
+	}
+	double mapMs = msSince(start);
+
+	// every bigram has to come back the same, and be found by lookup
+	int mismatches = 0;
+	for (int w=0; w<lexicon.wordCount(); w++) {
+		if (source.successorCount(w) != compiled.successorCount(w)) {
+			mismatches++;
+			continue;
+		}
+		source.forEachSuccessor(w, [&](int next, LogProb lp) {
+			if (compiled.logProb(w, next) != lp)
+				mismatches++;
+		});
+	}
+	if (mismatches) {
+		fprintf(stderr, "'%s' doesn't match the counts (%d mismatches)\n", argv[3], mismatches);
+		return 1;
+	}
+
+	printf("%s: %d bigrams, %d KB (built in %.0fms, maps in %.1fms)\n", argv[3], compiled.bigramCount(),
+		   (int)(TFileReader::fileSize(argv[3]) / 1024), buildMs, mapMs);
+	return 0;
+}
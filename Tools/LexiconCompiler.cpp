@@ -0,0 +1,82 @@
+/**
+ Compiles a word list (count_big.txt) into the binary lexicon that Lexicon::load() maps in place,
+ then maps the result back and checks that every word comes out with the same id and prior, both
+ through the trie and through the word hash. Reports the load time, the size of both forms, and how
+ often the hash's fingerprints let a non-word through.
+
+	lexicon_compiler <words.txt> <out.lex>
+ */
+#include "TCommon.h"
+#include "Lexicon.h"
+#include "TDateTime.h"
+#include "TFile.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static double msSince(const TDateTime& start) {
+	timeval tv = (TDateTime::now() - start).asTV();
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+int main(int argc, char** argv) {
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s <words.txt> <out.lex>\n", argv[0]);
+		return 1;
+	}
+
+	Lexicon source;
+	TDateTime start = TDateTime::now();
+	if (!source.load(argv[1])) {
+		fprintf(stderr, "failed to load '%s'\n", argv[1]);
+		return 1;
+	}
+	double parseMs = msSince(start);
+	if (source.isMapped()) {
+		fprintf(stderr, "'%s' is already compiled\n", argv[1]);
+		return 1;
+	}
+	if (!source.save(argv[2])) {
+		fprintf(stderr, "failed to write '%s'\n", argv[2]);
+		return 1;
+	}
+
+	Lexicon compiled;
+	start = TDateTime::now();
+	if (!compiled.load(argv[2]) || !compiled.isMapped()) {
+		fprintf(stderr, "failed to map '%s' back\n", argv[2]);
+		return 1;
+	}
+	double mapMs = msSince(start);
+
+	int mismatches = 0;
+	if (compiled.wordCount() != source.wordCount())
+		mismatches++;
+	source.forEachWord([&](uint32_t wordId, const char* word, int len) {
+		if (compiled.find(word) != (int)wordId || compiled.lookup(word, len) != (int)wordId ||
+			compiled.logPrior(wordId) != source.logPrior(wordId))
+			mismatches++;
+	});
+	if (mismatches) {
+		fprintf(stderr, "'%s' doesn't match the word list (%d mismatches)\n", argv[2], mismatches);
+		return 1;
+	}
+
+	// near misses of every word (one letter changed) that aren't words themselves
+	int nonWords = 0, falsePositives = 0;
+	compiled.forEachWord([&](uint32_t wordId, const char* word, int len) {
+		char changed[Lexicon::kMaxWordLen+1];
+		memcpy(changed, word, len+1);
+		changed[wordId % len] = (char)('a' + (changed[wordId % len] - 'a' + 1 + wordId % 25) % 26);
+		if (compiled.find(changed) >= 0)
+			return;
+		nonWords++;
+		falsePositives += (compiled.lookup(changed, len) >= 0);
+	});
+	printf("word hash: %d/%d non-words accepted\n", falsePositives, nonWords);
+
+	printf("%s: %d words, %d nodes, %dKB (from %dKB of text: parsed + built in %.1fms, mapped in %.3fms)\n",
+		   argv[2], compiled.wordCount(), compiled.nodeCount(), TFileReader::fileSize(argv[2]) / 1024,
+		   TFileReader::fileSize(argv[1]) / 1024, parseMs, mapMs);
+	return 0;
+}
@@ -0,0 +1,152 @@
+/**
+ Writes a trace corpus (see SwipeTrace.h) of synthetic swipes of lexicon words, for benchmarking
+ and measuring the decoder without a device - see SwipeTraceGenerator for how they're made. Words
+ are drawn by their prior, so the corpus has the mix of common and rare words typing does, or
+ uniformly with -uniform.
+
+	trace_generator Data/count_big.lex traces.qtr [-n 10000] [-seed 1] [-size 320x216]
+		[-profile segment|constant|whole] [-speed 20] [-dwell 30] [-aim 0.2] [-jitter 0.04]
+		[-rate 60] [-minlen 2] [-uniform]
+
+ The layout is QWERTY (KeyLayout::setQwerty()) at the given size, and is recorded in the corpus.
+ Appends if the corpus already exists.
+ */
+#include "TCommon.h"
+#include "KeyLayout.h"
+#include "Lexicon.h"
+#include "SwipeTrace.h"
+#include "SwipeTraceGenerator.h"
+#include "TDateTime.h"
+#include "TFile.h"
+#include <algorithm>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+static double msSince(const TDateTime& start) {
+	timeval tv = (TDateTime::now() - start).asTV();
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static int usage(const char* name) {
+	fprintf(stderr, "usage: %s <lexicon> <out.qtr> [-n count] [-seed n] [-size WxH] [-profile segment|constant|whole]\n"
+			"\t[-speed keys/s] [-dwell ms] [-aim keys] [-jitter keys] [-rate Hz] [-minlen n] [-uniform]\n", name);
+	return 1;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3)
+		return usage(argv[0]);
+
+	int count = 10000;
+	uint32_t seed = 1;
+	float width = 320, height = 216;
+	int minLen = 2;
+	bool uniform = false;
+	SwipeSynthConfig config;
+	for (int i=3; i<argc; i++) {
+		const char* opt = argv[i];
+		if (!strcmp(opt, "-uniform")) {
+			uniform = true;
+			continue;
+		}
+		if (i+1 >= argc)
+			return usage(argv[0]);
+		const char* value = argv[++i];
+		if (!strcmp(opt, "-n"))
+			count = atoi(value);
+		else if (!strcmp(opt, "-seed"))
+			seed = (uint32_t)atoi(value);
+		else if (!strcmp(opt, "-size")) {
+			if (sscanf(value, "%fx%f", &width, &height) != 2)
+				return usage(argv[0]);
+		}
+		else if (!strcmp(opt, "-profile")) {
+			if (!strcmp(value, "segment"))
+				config.profile = kSpeedPerSegment;
+			else if (!strcmp(value, "constant"))
+				config.profile = kSpeedConstant;
+			else if (!strcmp(value, "whole"))
+				config.profile = kSpeedWhole;
+			else
+				return usage(argv[0]);
+		}
+		else if (!strcmp(opt, "-speed"))
+			config.speed = (float)atof(value);
+		else if (!strcmp(opt, "-dwell"))
+			config.dwellMs = (float)atof(value);
+		else if (!strcmp(opt, "-aim"))
+			config.aimSigma = (float)atof(value);
+		else if (!strcmp(opt, "-jitter"))
+			config.jitter = (float)atof(value);
+		else if (!strcmp(opt, "-rate"))
+			config.sampleMs = 1000.0f / TMax((float)atof(value), 1.0f);
+		else if (!strcmp(opt, "-minlen"))
+			minLen = atoi(value);
+		else
+			return usage(argv[0]);
+	}
+
+	Lexicon lexicon;
+	if (!lexicon.load(argv[1])) {
+		fprintf(stderr, "failed to load '%s'\n", argv[1]);
+		return 1;
+	}
+	KeyLayout layout;
+	layout.setQwerty(width, height);
+
+	// the words that can be swiped on the layout, with the cumulative weight to draw them by
+	vector<uint32_t> words;
+	vector<double> cumulative;
+	double total = 0;
+	lexicon.forEachWord([&](uint32_t wordId, const char* word, int len) {
+		if (len < minLen)
+			return;
+		for (int i=0; i<len; i++) {
+			if (!layout.findKey(word[i]))
+				return;
+		}
+		total += uniform ? 1.0 : exp(logScoreToFloat(lexicon.logPrior(wordId)));
+		words.push_back(wordId);
+		cumulative.push_back(total);
+	});
+	if (words.empty()) {
+		fprintf(stderr, "no words in '%s' can be swiped\n", argv[1]);
+		return 1;
+	}
+
+	SwipeTraceWriter writer;
+	if (!writer.open(argv[2])) {
+		fprintf(stderr, "failed to write '%s'\n", argv[2]);
+		return 1;
+	}
+	writer.setKeyLayout(layout);
+
+	TDateTime start = TDateTime::now();
+	SwipeTraceGenerator generator(layout, seed);
+	generator.getConfig() = config;
+	mt19937 rng(seed);
+	uniform_real_distribution<double> pick(0, total);
+	vector<SwipePoint> points;
+	char word[Lexicon::kMaxWordLen + 1];
+	long numPoints = 0;
+	for (int i=0; i<count; i++) {
+		const size_t w = lower_bound(cumulative.begin(), cumulative.end(), pick(rng)) - cumulative.begin();
+		const int len = lexicon.word(words[TMin(w, words.size()-1)], word);
+		if (!generator.generate(word, len, points) || !writer.write(&points[0], (int)points.size(), word)) {
+			fprintf(stderr, "failed to write '%s'\n", argv[2]);
+			return 1;
+		}
+		numPoints += (long)points.size();
+	}
+	writer.close();
+
+	printf("%s: %d gestures of %d words, %ld points, %d KB (%.0fms)\n", argv[2], count, (int)words.size(), numPoints,
+		   (int)(TFileReader::fileSize(argv[2]) / 1024), msSince(start));
+	return 0;
+}